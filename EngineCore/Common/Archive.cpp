@@ -3,6 +3,7 @@
 #include "Utils/Helpers2.h"
 #include "Utils/Backlog.h"
 #include "Utils/ECS.h"
+#include "Utils/JobSystem.h"
 
 #include "Common/Engine_Internal.h"
 
@@ -15,6 +16,10 @@
 // - Thumbnail data [optional] (offset = sizeof(Header), size = header.properties.bits.thumbnail_data_size)
 //		- JPEG compressed image if header.properties.bits.thumbnail_data_size > 0
 // - Data [optionally compressed] (offset = sizeof(Header) + header.properties.bits.thumbnail_data_size, size = remaining)
+//		- if header.properties.bits.chunked, the compressed data is:
+//			- uint64_t chunk count, uint64_t uncompressed size
+//			- uint64_t frame offsets[chunk count + 1] (relative to the first frame)
+//			- zstd frames, each one is Archive::COMPRESSION_CHUNK_SIZE uncompressed bytes (except the last one)
 
 namespace vz
 {
@@ -64,12 +69,172 @@ namespace vz
 namespace vz
 {
 	// this should always be only INCREMENTED and only if a new serialization is implemeted somewhere!
-	static constexpr uint64_t __archiveVersion = 0;
+	//	1: cached CPU BVH of GeometryComponent::Primitive
+	//	2: bulk arrays (Archive::WriteBulk) in GeometryComponent::Primitive and VolumeComponent
+	//	3: chunked compression
+	static constexpr uint64_t __archiveVersion = 3;
 	// this is the version number of which below the archive is not compatible with the current version
 	static constexpr uint64_t __archiveVersionBarrier = 0;
 
 	// version history is logged in ArchiveVersionHistory.txt file!
 
+	// Decompresses a single zstd frame (archives written before chunked compression)
+	//	final_data gets data_offset bytes of room for the header and thumbnail
+	static bool decompressSingle(const uint8_t* src, size_t src_size, size_t data_offset, std::vector<uint8_t>& final_data)
+	{
+		std::vector<uint8_t> decompressed_part;
+		if (!vz::helper2::Decompress(src, src_size, decompressed_part))
+			return false;
+		final_data.resize(data_offset + decompressed_part.size());
+		std::memcpy(final_data.data() + data_offset, decompressed_part.data(), decompressed_part.size());
+		return true;
+	}
+
+	// Seek table in front of the frames of chunked compression
+	struct SeekTable
+	{
+		uint64_t chunk_count = 0;
+		uint64_t data_size = 0; // uncompressed
+		std::vector<uint64_t> frame_offsets; // chunk_count + 1 entries, relative to frames
+		const uint8_t* frames = nullptr;
+	};
+	static bool readSeekTable(const uint8_t* src, size_t src_size, SeekTable& table)
+	{
+		if (src_size < sizeof(uint64_t) * 3)
+			return false;
+		std::memcpy(&table.chunk_count, src, sizeof(uint64_t)); // the table is not necessarily aligned after the thumbnail
+		std::memcpy(&table.data_size, src + sizeof(uint64_t), sizeof(uint64_t));
+		if (table.chunk_count != (table.data_size + Archive::COMPRESSION_CHUNK_SIZE - 1) / Archive::COMPRESSION_CHUNK_SIZE)
+			return false;
+		const size_t seek_table_size = (size_t)(2 + table.chunk_count + 1) * sizeof(uint64_t);
+		if (src_size < seek_table_size)
+			return false;
+		table.frame_offsets.resize(table.chunk_count + 1);
+		std::memcpy(table.frame_offsets.data(), src + sizeof(uint64_t) * 2, table.frame_offsets.size() * sizeof(uint64_t));
+		table.frames = src + seek_table_size;
+		const size_t frames_size = src_size - seek_table_size;
+		for (uint64_t i = 0; i < table.chunk_count; ++i)
+		{
+			if (table.frame_offsets[i] > table.frame_offsets[i + 1] || table.frame_offsets[i + 1] > frames_size)
+				return false;
+		}
+		return true;
+	}
+
+	// Decompresses the independent frames of chunked compression in parallel, directly to their final place
+	//	final_data gets data_offset bytes of room for the header and thumbnail
+	static bool decompressChunked(const uint8_t* src, size_t src_size, size_t data_offset, std::vector<uint8_t>& final_data)
+	{
+		SeekTable table;
+		if (!readSeekTable(src, src_size, table))
+			return false;
+
+		final_data.resize(data_offset + (size_t)table.data_size);
+		std::atomic<bool> success{ true };
+		jobsystem::context ctx;
+		jobsystem::Dispatch(ctx, (uint32_t)table.chunk_count, 1, [&](jobsystem::JobArgs args) {
+			const size_t chunk_offset = (size_t)args.jobIndex * Archive::COMPRESSION_CHUNK_SIZE;
+			const size_t chunk_size = std::min(Archive::COMPRESSION_CHUNK_SIZE, (size_t)table.data_size - chunk_offset);
+			const uint64_t frame_begin = table.frame_offsets[args.jobIndex];
+			const uint64_t frame_end = table.frame_offsets[args.jobIndex + 1];
+			if (!vz::helper2::Decompress(table.frames + frame_begin, (size_t)(frame_end - frame_begin), final_data.data() + data_offset + chunk_offset, chunk_size))
+			{
+				success.store(false, std::memory_order_relaxed);
+			}
+			});
+		jobsystem::Wait(ctx);
+		return success.load();
+	}
+
+	// Chunked compressed file data, the chunks are decompressed to their final place when they are first accessed
+	//	The uncompressed size is only reserved as address space, memory is committed chunk by chunk
+	struct Archive::ChunkedData
+	{
+		enum : uint8_t
+		{
+			CHUNK_COMPRESSED,
+			CHUNK_DECODING,
+			CHUNK_DECODED,
+		};
+
+		std::shared_ptr<const void> source; // keeps the compressed frames alive
+		SeekTable table;
+		size_t data_offset = 0; // the header and thumbnail are not compressed, they are placed before the chunks
+		std::shared_ptr<void> memory; // data_offset + table.data_size bytes of address space
+		std::unique_ptr<std::atomic<uint8_t>[]> states; // per chunk
+
+		uint8_t* GetChunk(size_t chunk) const
+		{
+			return (uint8_t*)memory.get() + data_offset + chunk * COMPRESSION_CHUNK_SIZE;
+		}
+		size_t GetChunkSize(size_t chunk) const
+		{
+			return std::min(COMPRESSION_CHUNK_SIZE, (size_t)table.data_size - chunk * COMPRESSION_CHUNK_SIZE);
+		}
+		bool DecodeChunk(size_t chunk, uint8_t* dest) const
+		{
+			const uint64_t frame_begin = table.frame_offsets[chunk];
+			const uint64_t frame_end = table.frame_offsets[chunk + 1];
+			return vz::helper2::Decompress(table.frames + frame_begin, (size_t)(frame_end - frame_begin), dest, GetChunkSize(chunk));
+		}
+		// Chunks [first, last] overlapping the archive data range, returns false if the range has no compressed part
+		bool GetChunkRange(size_t offset, size_t size, size_t& first, size_t& last) const
+		{
+			const size_t begin = std::max(offset, data_offset);
+			const size_t end = std::min(offset + size, data_offset + (size_t)table.data_size);
+			if (begin >= end)
+				return false;
+			first = (begin - data_offset) / COMPRESSION_CHUNK_SIZE;
+			last = (end - 1 - data_offset) / COMPRESSION_CHUNK_SIZE;
+			return true;
+		}
+		// Decompresses the chunks [first, last] that were not decompressed yet, in parallel if there are more of them
+		//	chunks that are being decompressed by an other thread are waited for
+		bool Decode(size_t first, size_t last)
+		{
+			std::vector<uint32_t> claimed;
+			for (size_t chunk = first; chunk <= last; ++chunk)
+			{
+				uint8_t expected = CHUNK_COMPRESSED;
+				if (states[chunk].compare_exchange_strong(expected, CHUNK_DECODING, std::memory_order_acquire))
+				{
+					claimed.push_back((uint32_t)chunk);
+				}
+			}
+
+			std::atomic<bool> success{ true };
+			auto decode = [&](size_t chunk) {
+				uint8_t* dest = GetChunk(chunk);
+				if (!helper::MemoryCommit(dest, GetChunkSize(chunk)) || !DecodeChunk(chunk, dest))
+				{
+					success.store(false, std::memory_order_relaxed);
+				}
+				states[chunk].store(CHUNK_DECODED, std::memory_order_release);
+			};
+			if (claimed.size() == 1)
+			{
+				decode(claimed[0]);
+			}
+			else if (claimed.size() > 1)
+			{
+				jobsystem::context ctx;
+				jobsystem::Dispatch(ctx, (uint32_t)claimed.size(), 1, [&](jobsystem::JobArgs args) {
+					decode(claimed[args.jobIndex]);
+					});
+				jobsystem::Wait(ctx);
+			}
+
+			for (size_t chunk = first; chunk <= last; ++chunk)
+			{
+				while (states[chunk].load(std::memory_order_acquire) != CHUNK_DECODED)
+				{
+					std::this_thread::yield();
+				}
+			}
+			return success.load();
+		}
+	};
+
 	Archive::Archive()
 	{
 		CreateEmpty();
@@ -82,7 +247,15 @@ namespace vz
 			directory = vz::helper::GetDirectoryFromPath(fileName);
 			if (readMode)
 			{
-				if (vz::helper::FileRead(fileName, DATA))
+				size_t mapped_size = 0;
+				mapped_file = vz::helper::FileMap(fileName, mapped_size);
+				if (mapped_file != nullptr)
+				{
+					data_ptr = (const uint8_t*)mapped_file.get();
+					data_ptr_size = mapped_size;
+					SetReadModeAndResetPos(true);
+				}
+				else if (vz::helper::FileRead(fileName, DATA))
 				{
 					data_ptr = DATA.data();
 					data_ptr_size = DATA.size();
@@ -103,8 +276,29 @@ namespace vz
 		SetReadModeAndResetPos(true);
 	}
 
+	bool Archive::ReadFile(const std::string& fileName)
+	{
+		size_t mapped_size = 0;
+		std::shared_ptr<const void> mapped = vz::helper::FileMap(fileName, mapped_size);
+		if (mapped == nullptr)
+		{
+			return false;
+		}
+		DATA.clear();
+		chunked_data.reset();
+		mapped_file = std::move(mapped);
+		data_ptr = (const uint8_t*)mapped_file.get();
+		data_ptr_size = mapped_size;
+		data_already_decompressed = false;
+		SetFileName(fileName);
+		SetReadModeAndResetPos(true);
+		return IsOpen();
+	}
+
 	void Archive::ReadData(const uint8_t* data, size_t size)
 	{
+		mapped_file.reset();
+		chunked_data.reset();
 		data_ptr = data;
 		data_ptr_size = size;
 		data_already_decompressed = false;
@@ -156,30 +350,86 @@ namespace vz
 				size_t data_offset = 0;
 				data_offset += sizeof(Header);
 				data_offset += header.properties.bits.thumbnail_data_size;
-				if (data_ptr_size > data_offset)
+				const bool owns_source = mapped_file != nullptr || (!DATA.empty() && data_ptr == DATA.data());
+				if (data_ptr_size > data_offset && header.properties.bits.chunked && owns_source)
+				{
+					// Chunks are decompressed when they are read, only the address space is reserved here
+					//	external data (ReadData()) is not kept alive by the archive, so that is decompressed below
+					auto chunked = std::make_shared<ChunkedData>();
+					chunked->data_offset = data_offset;
+					if (!readSeekTable(data_ptr + data_offset, data_ptr_size - data_offset, chunked->table) ||
+						(chunked->memory = helper::MemoryReserve(data_offset + (size_t)chunked->table.data_size)) == nullptr ||
+						!helper::MemoryCommit(chunked->memory.get(), data_offset))
+					{
+						backlog::post("Archive decompression failed!", backlog::LogLevel::Error);
+						Close();
+						return;
+					}
+					chunked->states.reset(new std::atomic<uint8_t>[chunked->table.chunk_count]());
+					uint8_t* memory = (uint8_t*)chunked->memory.get();
+					std::memcpy(memory, &header, sizeof(Header));
+					if (header.properties.bits.thumbnail_data_size > 0)
+					{
+						std::memcpy(memory + sizeof(Header), get_thumbnail_data(), header.properties.bits.thumbnail_data_size);
+					}
+					if (mapped_file != nullptr)
+					{
+						chunked->source = std::move(mapped_file);
+					}
+					else
+					{
+						auto file_data = std::make_shared<std::vector<uint8_t>>(std::move(DATA)); // the frames don't move with the vector
+						chunked->source = std::shared_ptr<const void>(file_data, file_data->data());
+						DATA.clear();
+					}
+					data_ptr = memory;
+					data_ptr_size = data_offset + (size_t)chunked->table.data_size;
+					chunked_data = std::move(chunked);
+					decoded_begin = 0;
+					decoded_end = data_offset;
+					data_already_decompressed = true;
+				}
+				else if (data_ptr_size > data_offset)
 				{
 					size_t data_size = data_ptr_size - data_offset;
-					std::vector<uint8_t> decompressed_part;
-					vz::helper2::Decompress(data_ptr + data_offset, data_size, decompressed_part);
-					std::vector<uint8_t> final_data(data_offset + decompressed_part.size());
+					std::vector<uint8_t> final_data;
+					bool success = header.properties.bits.chunked ?
+						decompressChunked(data_ptr + data_offset, data_size, data_offset, final_data) :
+						decompressSingle(data_ptr + data_offset, data_size, data_offset, final_data);
+					if (!success)
+					{
+						backlog::post("Archive decompression failed!", backlog::LogLevel::Error);
+						Close();
+						return;
+					}
 					size_t _offset = 0;
 					std::memcpy(final_data.data() + _offset, &header, sizeof(Header));
 					_offset += sizeof(Header);
 					if (header.properties.bits.thumbnail_data_size > 0)
 					{
 						std::memcpy(final_data.data() + _offset, get_thumbnail_data(), header.properties.bits.thumbnail_data_size);
-						_offset += header.properties.bits.thumbnail_data_size;
 					}
-					std::memcpy(final_data.data() + _offset, decompressed_part.data(), decompressed_part.size());
 					std::swap(DATA, final_data); // archive DATA is replaced by decompressed final_data
 					data_ptr = DATA.data();
 					data_ptr_size = DATA.size();
+					mapped_file.reset(); // the compressed source is no longer needed
 					data_already_decompressed = true; // indicate that next call to SetReadModeAndResetPos() doesn't need to decompress data
 				}
 			}
 		}
 		else
 		{
+			// serializers always write the current format
+			header.version = __archiveVersion;
+			if (DATA.empty() || data_ptr != DATA.data())
+			{
+				// the data was memory mapped (read only), writing starts with a new buffer
+				mapped_file.reset();
+				chunked_data.reset();
+				DATA.resize(128);
+				data_ptr = DATA.data();
+				data_ptr_size = DATA.size();
+			}
 			(*this) << header.version;
 			(*this) << header.properties.raw;
 			for (size_t i = 0; i < header.properties.bits.thumbnail_data_size; ++i)
@@ -197,6 +447,83 @@ namespace vz
 		}
 		DATA.clear();
 		data_ptr = nullptr;
+		mapped_file.reset();
+		chunked_data.reset();
+	}
+
+	void Archive::DecodeRange(size_t offset, size_t size)
+	{
+		size_t first, last;
+		if (!chunked_data->GetChunkRange(offset, size, first, last))
+		{
+			// header and thumbnail
+			decoded_begin = 0;
+			decoded_end = chunked_data->data_offset;
+			return;
+		}
+		if (!chunked_data->Decode(first, last))
+		{
+			backlog::post("Archive decompression failed!", backlog::LogLevel::Error);
+		}
+		decoded_begin = first == 0 ? 0 : chunked_data->data_offset + first * COMPRESSION_CHUNK_SIZE;
+		decoded_end = chunked_data->data_offset + std::min((last + 1) * COMPRESSION_CHUNK_SIZE, (size_t)chunked_data->table.data_size);
+	}
+
+	void Archive::DecodeTo(size_t offset, size_t size, void* dest)
+	{
+		uint8_t* dst = (uint8_t*)dest;
+		if (offset < chunked_data->data_offset)
+		{
+			const size_t header_size = std::min(size, chunked_data->data_offset - offset);
+			std::memcpy(dst, data_ptr + offset, header_size);
+		}
+		size_t first, last;
+		if (!chunked_data->GetChunkRange(offset, size, first, last))
+			return;
+
+		std::atomic<bool> success{ true };
+		jobsystem::context ctx;
+		jobsystem::Dispatch(ctx, uint32_t(last - first + 1), 1, [&](jobsystem::JobArgs args) {
+			const size_t chunk = first + args.jobIndex;
+			const size_t chunk_begin = chunked_data->data_offset + chunk * COMPRESSION_CHUNK_SIZE;
+			const size_t chunk_size = chunked_data->GetChunkSize(chunk);
+			const size_t copy_begin = std::max(chunk_begin, offset);
+			const size_t copy_end = std::min(chunk_begin + chunk_size, offset + size);
+			uint8_t* chunk_dest = dst + (copy_begin - offset);
+			if (copy_begin == chunk_begin && copy_end == chunk_begin + chunk_size &&
+				chunked_data->states[chunk].load(std::memory_order_acquire) == ChunkedData::CHUNK_COMPRESSED)
+			{
+				// whole chunk that was not read before, it doesn't need to be kept in the archive memory
+				if (!chunked_data->DecodeChunk(chunk, chunk_dest))
+				{
+					success.store(false, std::memory_order_relaxed);
+				}
+				return;
+			}
+			if (!chunked_data->Decode(chunk, chunk))
+			{
+				success.store(false, std::memory_order_relaxed);
+			}
+			std::memcpy(chunk_dest, chunked_data->GetChunk(chunk) + (copy_begin - chunk_begin), copy_end - copy_begin);
+			});
+		jobsystem::Wait(ctx);
+		if (!success.load())
+		{
+			backlog::post("Archive decompression failed!", backlog::LogLevel::Error);
+		}
+	}
+
+	const uint8_t* Archive::GetData(size_t offset, size_t size) const
+	{
+		size_t first, last;
+		if (chunked_data != nullptr && chunked_data->GetChunkRange(offset, size, first, last))
+		{
+			if (!chunked_data->Decode(first, last))
+			{
+				backlog::post("Archive decompression failed!", backlog::LogLevel::Error);
+			}
+		}
+		return data_ptr + offset;
 	}
 
 	bool Archive::SaveFile(const std::string& fileName)
@@ -204,7 +531,8 @@ namespace vz
 		if (IsCompressionEnabled())
 		{
 			std::vector<uint8_t> final_data;
-			WriteCompressedData(final_data);
+			if (!WriteCompressedData(final_data))
+				return false;
 			return vz::helper::FileWrite(fileName, final_data.data(), final_data.size());
 		}
 		return vz::helper::FileWrite(fileName, data_ptr, pos);
@@ -215,7 +543,8 @@ namespace vz
 		if (IsCompressionEnabled())
 		{
 			std::vector<uint8_t> final_data;
-			WriteCompressedData(final_data);
+			if (!WriteCompressedData(final_data))
+				return false;
 			return vz::helper::Bin2H(final_data.data(), final_data.size(), fileName, dataName.c_str());
 		}
 		return vz::helper::Bin2H(data_ptr, pos, fileName, dataName.c_str());
@@ -226,7 +555,8 @@ namespace vz
 		if (IsCompressionEnabled())
 		{
 			std::vector<uint8_t> final_data;
-			WriteCompressedData(final_data);
+			if (!WriteCompressedData(final_data))
+				return false;
 			return helper::Bin2CPP(final_data.data(), final_data.size(), fileName, dataName.c_str());
 		}
 		return helper::Bin2CPP(data_ptr, pos, fileName, dataName.c_str());
@@ -332,29 +662,59 @@ namespace vz
 		return archive.CreateThumbnailTexture();
 	}
 
-	void Archive::WriteData(std::vector<uint8_t>& dest) const
+	bool Archive::WriteData(std::vector<uint8_t>& dest) const
 	{
 		if (IsCompressionEnabled())
 		{
-			WriteCompressedData(dest);
-		}
-		else
-		{
-			dest.resize(pos);
-			std::memcpy(dest.data(), data_ptr, pos);
+			return WriteCompressedData(dest);
 		}
+		dest.resize(pos);
+		std::memcpy(dest.data(), data_ptr, pos);
+		return true;
 	}
-	void Archive::WriteCompressedData(std::vector<uint8_t>& final_data) const
+	bool Archive::WriteCompressedData(std::vector<uint8_t>& final_data) const
 	{
 		Header _header = header;
 		_header.properties.bits.compressed = 1; // force write compressed header
+		_header.properties.bits.chunked = 1;
 		size_t data_offset = 0;
 		data_offset += sizeof(Header);
 		data_offset += _header.properties.bits.thumbnail_data_size;
 		size_t data_size = pos - data_offset;
-		std::vector<uint8_t> compressed_part;
-		vz::helper2::Compress(data_ptr + data_offset, data_size, compressed_part, 9);
-		final_data.resize(data_offset + compressed_part.size());
+
+		// Compress the chunks in parallel:
+		const size_t chunk_count = (data_size + COMPRESSION_CHUNK_SIZE - 1) / COMPRESSION_CHUNK_SIZE;
+		std::vector<std::vector<uint8_t>> frames(chunk_count);
+		std::atomic<bool> success{ true };
+		jobsystem::context ctx;
+		jobsystem::Dispatch(ctx, (uint32_t)chunk_count, 1, [&](jobsystem::JobArgs args) {
+			const size_t chunk_offset = (size_t)args.jobIndex * COMPRESSION_CHUNK_SIZE;
+			const size_t chunk_size = std::min(COMPRESSION_CHUNK_SIZE, data_size - chunk_offset);
+			if (!vz::helper2::Compress(data_ptr + data_offset + chunk_offset, chunk_size, frames[args.jobIndex], 9))
+			{
+				success.store(false, std::memory_order_relaxed);
+			}
+			});
+		jobsystem::Wait(ctx);
+		if (!success.load())
+		{
+			backlog::post("Archive compression failed!", backlog::LogLevel::Error);
+			final_data.clear();
+			return false;
+		}
+
+		std::vector<uint64_t> seek_table(2 + chunk_count + 1);
+		seek_table[0] = chunk_count;
+		seek_table[1] = data_size;
+		uint64_t* frame_offsets = seek_table.data() + 2;
+		frame_offsets[0] = 0;
+		for (size_t i = 0; i < chunk_count; ++i)
+		{
+			frame_offsets[i + 1] = frame_offsets[i] + frames[i].size();
+		}
+		const size_t seek_table_size = seek_table.size() * sizeof(uint64_t);
+
+		final_data.resize(data_offset + seek_table_size + frame_offsets[chunk_count]);
 		size_t _offset = 0;
 		std::memcpy(final_data.data() + _offset, &_header, sizeof(Header));
 		_offset += sizeof(Header);
@@ -363,6 +723,12 @@ namespace vz
 			std::memcpy(final_data.data() + _offset, get_thumbnail_data(), _header.properties.bits.thumbnail_data_size);
 			_offset += _header.properties.bits.thumbnail_data_size;
 		}
-		std::memcpy(final_data.data() + _offset, compressed_part.data(), compressed_part.size());
+		std::memcpy(final_data.data() + _offset, seek_table.data(), seek_table_size);
+		_offset += seek_table_size;
+		for (size_t i = 0; i < chunk_count; ++i)
+		{
+			std::memcpy(final_data.data() + _offset + frame_offsets[i], frames[i].data(), frames[i].size());
+		}
+		return true;
 	}
 }
@@ -4,6 +4,9 @@
 #include "GBackend/GBackend.h"
 
 #include <string>
+#include <memory>
+#include <cstring>
+#include <type_traits>
 
 using Entity = uint64_t;
 
@@ -36,7 +39,8 @@ namespace vz
 				{
 					uint64_t thumbnail_data_size : 32;
 					uint64_t compressed : 1;
-					uint64_t reserved : 31;
+					uint64_t chunked : 1; // compressed data is a seek table and independent frames (see COMPRESSION_CHUNK_SIZE)
+					uint64_t reserved : 30;
 				} bits;
 				uint64_t raw = 0;
 			} properties;
@@ -50,8 +54,18 @@ namespace vz
 		std::vector<uint8_t> DATA; // data suitable for read/write operations
 		const uint8_t* data_ptr = nullptr; // this can either be a memory mapped pointer (read only), or the DATA's pointer
 		size_t data_ptr_size = 0;
+		std::shared_ptr<const void> mapped_file; // keeps the memory mapped file alive while data_ptr points into it
 		bool data_already_decompressed = false;
 
+		// Chunked compressed data of a file is decoded on first access, data_ptr then points to reserved address space
+		//	and only the chunks that are read are committed and decompressed (see DecodeRange())
+		struct ChunkedData;
+		std::shared_ptr<ChunkedData> chunked_data;
+		size_t decoded_begin = 0; // data range that is known to be decoded, to skip DecodeRange() on sequential reads
+		size_t decoded_end = 0;
+		void DecodeRange(size_t offset, size_t size);
+		void DecodeTo(size_t offset, size_t size, void* dest);
+
 		std::string fileName; // save to this file on closing if not empty
 		std::string directory; // the directory part from the fileName
 
@@ -61,7 +75,7 @@ namespace vz
 		const uint8_t* thumbnail_data_ptr_write = nullptr; // temp ptr to write archive data
 		constexpr const uint8_t* get_thumbnail_data() const { return data_ptr + sizeof(Header); }
 
-		void WriteCompressedData(std::vector<uint8_t>& final_data) const;
+		bool WriteCompressedData(std::vector<uint8_t>& final_data) const;
 
 		void CreateEmpty(); // creates new archive in write mode
 
@@ -74,7 +88,7 @@ namespace vz
 		Archive(const Archive&) = default;
 		Archive(Archive&&) = default;
 		// Create archive from a file.
-		//	If readMode == true, the whole file will be loaded into the archive in read mode
+		//	If readMode == true, the file will be memory mapped in read mode (pages are loaded on demand, compressed chunks are decompressed when they are first read)
 		//	If readMode == false, the file will be written when the archive is destroyed or Close() is called
 		Archive(const std::string& fileName, bool readMode = true);
 		// Creates a memory mapped archive in read mode
@@ -90,10 +104,16 @@ namespace vz
 		void SetArchiveName(const std::string& name) { name_ = name; }
 		void SetArchiveEntity(const Entity entity) { entity_ = entity; }
 		void ReadData(const uint8_t* data, size_t size);
+		// Memory maps a file and switches to read mode, the pages are loaded on demand
+		bool ReadFile(const std::string& fileName);
 		void SetFileName(const std::string& fileName);
 
-		void WriteData(std::vector<uint8_t>& dest) const;
+		// Returns false if the data could not be compressed
+		bool WriteData(std::vector<uint8_t>& dest) const;
 		const uint8_t* GetData() const { return data_ptr; }
+		// Returns the data at offset, decompressing it first if needed
+		//	GetData() alone doesn't decompress, use this for direct access of a compressed archive's data
+		const uint8_t* GetData(size_t offset, size_t size) const;
 		const size_t GetSize() const { return data_ptr_size; }
 		size_t GetPos() const { return pos; }
 		constexpr uint64_t GetVersion() const { return header.version; }
@@ -122,13 +142,15 @@ namespace vz
 		//	The file's name will include the directory as well
 		const std::string& GetSourceFileName() const;
 
+		// Uncompressed size of the independently compressed chunks, they are compressed and decompressed in parallel
+		static constexpr size_t COMPRESSION_CHUNK_SIZE = 4ull << 20;
+
 		// Set whether the archive should be compressed upon saving
 		//	Note that in memory, the archive is uncompressed
-		//	Note that compressed archive will not work with streaming!
 		constexpr void SetCompressionEnabled(bool value) { header.properties.bits.compressed = value; }
 		// Returns true if the archive data is originating from compressed data
 		//	Note that even if the archive was opened from compressed data source, the archive is always uncompressed in memory
-		//	Note that compressed archive will not work with streaming!
+		//	Note that a compressed file is decompressed chunk by chunk as it is read, so Jump() only decompresses the chunks it reads
 		constexpr bool IsCompressionEnabled() const { return header.properties.bits.compressed; }
 
 		// If Archive contains thumbnail image data, then creates a Texture from it:
@@ -170,10 +192,46 @@ namespace vz
 		inline void MapVector(const uint8_t*& data, size_t& size)
 		{
 			(*this) >> size;
+			_decode(pos, size);
 			data = data_ptr + pos;
 			pos += size;
 		}
 
+		// Bulk arrays of trivially copyable elements:
+		//	element count, then the raw elements starting at an offset aligned to BULK_ALIGNMENT from the data's beginning
+		//	These are not interchangeable with operator<< / operator>> of std::vector, which serialize per element
+		static constexpr size_t BULK_ALIGNMENT = 16;
+		template<typename T>
+		inline void WriteBulk(const std::vector<T>& data)
+		{
+			static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= BULK_ALIGNMENT);
+			_write(uint64_t(data.size()));
+			_write_padding(BULK_ALIGNMENT);
+			_write_raw(data.data(), data.size() * sizeof(T));
+		}
+		// Copies the bulk array with a single memcpy
+		//	With a memory mapped file, the copy reads the file pages directly
+		//	With compressed data, the chunks are decompressed straight to the array if they were not read yet
+		template<typename T>
+		inline void ReadBulk(std::vector<T>& data)
+		{
+			static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= BULK_ALIGNMENT);
+			uint64_t count;
+			_read(count);
+			pos = (pos + BULK_ALIGNMENT - 1) & ~(BULK_ALIGNMENT - 1);
+			data.resize((size_t)count);
+			if (chunked_data != nullptr)
+			{
+				DecodeTo(pos, data.size() * sizeof(T), data.data());
+			}
+			else if (!data.empty())
+			{
+				std::memcpy(data.data(), data_ptr + pos, data.size() * sizeof(T));
+			}
+			pos += data.size() * sizeof(T);
+			assert(pos <= data_ptr_size);
+		}
+
 		// It could be templated but we have to be extremely careful of different datasizes on different platforms
 		// because serialized data should be interchangeable!
 		// So providing exact copy operations for exact types enforces platform agnosticism
@@ -319,9 +377,13 @@ namespace vz
 			// Here we will use the << operator so that non-specified types will have compile error!
 			//	Note: version and thumbnail data is skipped, only data is appended
 			const size_t start = sizeof(uint64_t) * 2; // version and thumbnail size
-			for (size_t i = start; i < other.pos; ++i)
+			if (other.pos > start)
 			{
-				(*this) << other.data_ptr[i];
+				const uint8_t* other_data = other.GetData(start, other.pos - start);
+				for (size_t i = 0; i < other.pos - start; ++i)
+				{
+					(*this) << other_data[i];
+				}
 			}
 			return *this;
 		}
@@ -514,6 +576,42 @@ namespace vz
 			pos = _right;
 		}
 
+		// Write a raw block of memory
+		inline void _write_raw(const void* data, size_t size)
+		{
+			assert(!readMode);
+			assert(!DATA.empty());
+			const size_t _right = pos + size;
+			if (_right > DATA.size())
+			{
+				DATA.resize(_right * 2);
+				data_ptr = DATA.data();
+				data_ptr_size = DATA.size();
+			}
+			if (size > 0)
+			{
+				std::memcpy(DATA.data() + pos, data, size);
+			}
+			pos = _right;
+		}
+
+		// Write zeros until the position is aligned
+		inline void _write_padding(size_t alignment)
+		{
+			static const uint8_t zeros[BULK_ALIGNMENT] = {};
+			const size_t aligned = (pos + alignment - 1) & ~(alignment - 1);
+			_write_raw(zeros, aligned - pos);
+		}
+
+		// Make sure that the data range is decompressed before reading it
+		inline void _decode(size_t offset, size_t size)
+		{
+			if (chunked_data != nullptr && (offset < decoded_begin || offset + size > decoded_end))
+			{
+				DecodeRange(offset, size);
+			}
+		}
+
 		// Read data using memory operations
 		template<typename T>
 		inline void _read(T& data)
@@ -521,6 +619,7 @@ namespace vz
 			assert(readMode);
 			assert(data_ptr != nullptr);
 			assert(pos < data_ptr_size);
+			_decode(pos, sizeof(data));
 			data = *(const T*)(data_ptr + pos);
 			pos += (size_t)(sizeof(data));
 		}
@@ -51,5 +51,6 @@ namespace vzm
 	void ResetPendingSubmitCommand();
 	void CountPendingSubmitCommand();
 	size_t GetCountPendingSubmitCommand();
+	void SubmitEngineFrame();
 	int GetEngineStableCount();
 }
\ No newline at end of file
@@ -2147,7 +2147,7 @@ namespace vz::resourcemanager
 							}
 							const vz::Archive& ar = temp_compressed_archives[resource->container_filename];
 							resource->filedata.resize(resource->container_filesize);
-							std::memcpy(resource->filedata.data(), ar.GetData() + resource->container_fileoffset, resource->container_filesize);
+							std::memcpy(resource->filedata.data(), ar.GetData(resource->container_fileoffset, resource->container_filesize), resource->container_filesize);
 						}
 						else
 						{
@@ -1,6 +1,8 @@
 #include "GComponents.h"
 #include "Utils/Backlog.h"
 
+#include <algorithm>
+
 namespace vz
 {
 	AnimationComponent::Channel::PathDataType AnimationComponent::Channel::GetPathDataType() const
@@ -72,6 +74,67 @@ namespace vz
 		return duration;
 	}
 
+	// Finds the keyframes around the time, keyframe times are ascending (see AnimationDataComponent::GetDuration())
+	//	keyLeft: the last keyframe at or before the time (the first one of equal times), 0 if there is none
+	//	keyRight: the first keyframe at or after the time, 0 if there is none
+	//	cursor: the first keyframe after the time, cached per channel so forward playback is amortized O(1),
+	//		seeking falls back to binary search
+	static void findKeyframes(const std::vector<float>& times, const float time, int& cursor,
+		int& keyLeft, float& timeLeft, int& keyRight, float& timeRight)
+	{
+		const int count = (int)times.size();
+		constexpr int MAX_CURSOR_STEPS = 4;
+
+		int after = std::clamp(cursor, 0, count);
+		if (after > 0 && times[after - 1] > time)
+		{
+			after = -1; // moved backwards
+		}
+		else
+		{
+			int steps = 0;
+			while (after < count && times[after] <= time && steps++ < MAX_CURSOR_STEPS)
+			{
+				after++;
+			}
+			if (after < count && times[after] <= time)
+			{
+				after = -1; // jumped forward
+			}
+		}
+		if (after < 0)
+		{
+			after = int(std::upper_bound(times.begin(), times.end(), time) - times.begin());
+		}
+		cursor = after;
+
+		if (after == 0)
+		{
+			keyLeft = 0;
+			timeLeft = std::numeric_limits<float>::min();
+		}
+		else
+		{
+			keyLeft = after - 1;
+			while (keyLeft > 0 && times[keyLeft - 1] == times[keyLeft])
+			{
+				keyLeft--;
+			}
+			timeLeft = times[keyLeft];
+		}
+
+		keyRight = (after > 0 && times[after - 1] == time) ? keyLeft : after;
+		if (keyRight < count)
+		{
+			timeRight = times[keyRight];
+		}
+		else
+		{
+			keyRight = 0;
+			timeRight = std::numeric_limits<float>::max();
+		}
+	}
+
 	void AnimationComponent::Update(const float dt)
 	{
 		if (!IsPlaying() || dt == 0)
@@ -97,34 +160,13 @@ namespace vz
 
 			const Channel::PathDataType path_data_type = channel.GetPathDataType();
 
-			float timeFirst = std::numeric_limits<float>::max();
-			float timeLast = std::numeric_limits<float>::min();
-			int keyLeft = 0;	float timeLeft = std::numeric_limits<float>::min();
-			int keyRight = 0;	float timeRight = std::numeric_limits<float>::max();
+			const float timeFirst = keyframe_times.front();
+			const float timeLast = keyframe_times.back();
+			int keyLeft, keyRight;
+			float timeLeft, timeRight;
 
 			// search for usable keyframes:
-			for (int k = 0; k < (int)keyframe_times.size(); ++k)
-			{
-				const float time = keyframe_times[k];
-				if (time < timeFirst)
-				{
-					timeFirst = time;
-				}
-				if (time > timeLast)
-				{
-					timeLast = time;
-				}
-				if (time <= playTimer_ && time > timeLeft)
-				{
-					timeLeft = time;
-					keyLeft = k;
-				}
-				if (time >= playTimer_ && time < timeRight)
-				{
-					timeRight = time;
-					keyRight = k;
-				}
-			}
+			findKeyframes(keyframe_times, playTimer_, channel.keyCursor, keyLeft, timeLeft, keyRight, timeRight);
 			if (path_data_type != Channel::PathDataType::Event)
 			{
 				if (playTimer_ < timeFirst)
@@ -162,8 +204,16 @@ namespace vz
 			//ScriptComponent* target_script = nullptr;
 			MaterialComponent* target_material = nullptr;
 
-			NameComponent* target_name = compfactory::GetNameComponentByVUID(channel.targetNameVUID);
-			Entity target_entity = target_name->GetEntity();
+			if (channel.targetEntityVUID != channel.targetNameVUID)
+			{
+				// resolved once per target, the entity lookups below are O(1)
+				NameComponent* target_name = compfactory::GetNameComponentByVUID(channel.targetNameVUID);
+				if (target_name == nullptr)
+					INVALID_RETURN;
+				channel.targetEntity = target_name->GetEntity();
+				channel.targetEntityVUID = channel.targetNameVUID;
+			}
+			Entity target_entity = channel.targetEntity;
 
 			if (
 				channel.path == Channel::Path::TRANSLATION ||
@@ -86,6 +86,17 @@ namespace vz
 }
 namespace vz
 {
+	static std::atomic<uint64_t> hierarchyParentRevision{ 0 };
+
+	void HierarchyComponent::notifyParentChanged()
+	{
+		hierarchyParentRevision.fetch_add(1, std::memory_order_relaxed);
+	}
+	uint64_t HierarchyComponent::GetParentRevision()
+	{
+		return hierarchyParentRevision.load(std::memory_order_relaxed);
+	}
+
 	void HierarchyComponent::updateChildren() 
 	{
 		childrenCache_.clear(); 
@@ -112,6 +123,7 @@ namespace vz
 			old_parent_hierarchy->RemoveChild(vuid_);
 		}
 		timeStampSetter_ = TimerNow;
+		notifyParentChanged();
 		if (vuidParent == 0u)
 		{
 			vuidParentHierarchy_ = 0u;
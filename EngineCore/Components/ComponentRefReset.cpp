@@ -9,6 +9,7 @@ namespace vz
 		if (vuidParentHierarchy_ == vuidRef)
 		{
 			vuidParentHierarchy_ = INVALID_VUID;
+			notifyParentChanged();
 			is_modified = true;
 		}
 		auto it = children_.find(vuidRef);
@@ -5,6 +5,7 @@
 #include "Utils/ECS.h"
 #include "Utils/Helpers.h"
 #include "Utils/Helpers2.h"
+#include "Utils/Backlog.h"
 
 namespace vz
 {
@@ -68,6 +69,20 @@ namespace vz
 		return path_string;
 	}
 
+	// large arrays are raw bulk copies since archive version 2 (element-wise before)
+	template<typename T>
+	inline void readBulkArray(vz::Archive& archive, std::vector<T>& data)
+	{
+		if (archive.GetVersion() >= 2)
+		{
+			archive.ReadBulk(data);
+		}
+		else
+		{
+			archive >> data;
+		}
+	}
+
 	EntitySerializer entitySerializer;
 	bool Archive::StoreSerializedResources(const std::string& sourceDir)
 	{
@@ -168,6 +183,7 @@ namespace vz
 			{
 				children_.insert(it);
 			}
+			notifyParentChanged();
 			timeStampSetter_ = TimerNow;
 		}
 		else
@@ -452,13 +468,13 @@ namespace vz
 	{
 		if (archive.IsReadMode())
 		{
-			archive >> vertexPositions_;
-			archive >> vertexNormals_;
-			archive >> vertexTangents_;
-			archive >> vertexUVset0_;
-			archive >> vertexUVset1_;
-			archive >> vertexColors_;
-			archive >> indexPrimitives_;
+			readBulkArray(archive, vertexPositions_);
+			readBulkArray(archive, vertexNormals_);
+			readBulkArray(archive, vertexTangents_);
+			readBulkArray(archive, vertexUVset0_);
+			readBulkArray(archive, vertexUVset1_);
+			readBulkArray(archive, vertexColors_);
+			readBulkArray(archive, indexPrimitives_);
 			uint32_t data32t;
 			archive >> data32t;
 			ptype_ = static_cast<PrimitiveType>(data32t);
@@ -467,11 +483,11 @@ namespace vz
 			morphTargets_.resize(data32t);
 			for (uint32_t i = 0; i < data32t; ++i)
 			{
-				archive >> morphTargets_[i].vertexPositions;
-				archive >> morphTargets_[i].vertexNormals;
+				readBulkArray(archive, morphTargets_[i].vertexPositions);
+				readBulkArray(archive, morphTargets_[i].vertexNormals);
 				archive >> morphTargets_[i].weight;
-				archive >> morphTargets_[i].sparseIndicesPositions;
-				archive >> morphTargets_[i].sparseIndicesNormals;
+				readBulkArray(archive, morphTargets_[i].sparseIndicesPositions);
+				readBulkArray(archive, morphTargets_[i].sparseIndicesNormals);
 			}
 
 			archive >> data32t;
@@ -479,7 +495,7 @@ namespace vz
 			for (uint32_t i = 0; i < data32t; ++i)
 			{
 				std::vector<uint8_t>& custom_buffer = customBuffers_[i];
-				archive >> custom_buffer;
+				readBulkArray(archive, custom_buffer);
 			}
 
 			size_t subset_count;
@@ -490,32 +506,61 @@ namespace vz
 				archive >> subsets_[i].indexOffset;
 				archive >> subsets_[i].indexCount;
 			}
+
+			if (archive.GetVersion() >= 1)
+			{
+				// cached CPU BVH, used only if it was built from the same positions and indices
+				bool has_bvh;
+				archive >> has_bvh;
+				if (has_bvh)
+				{
+					uint64_t content_hash;
+					uint32_t node_count, leaf_count;
+					archive >> content_hash;
+					archive >> node_count;
+					archive >> leaf_count;
+					readBulkArray(archive, bvh_.allocation);
+
+					bool valid = content_hash == computeBVHContentHash() && bvh_.Restore(node_count, leaf_count);
+					if (valid)
+					{
+						computeBVHLeafAABBs();
+						valid = bvhLeafAabbs_.size() == leaf_count;
+					}
+					if (!valid)
+					{
+						bvh_ = geometrics::BVH();
+						bvhLeafAabbs_.clear();
+						backlog::post("Cached CPUBVH doesn't match the primitive, it will be rebuilt", backlog::LogLevel::Warn);
+					}
+				}
+			}
 		}
 		else
 		{
-			archive << vertexPositions_;
-			archive << vertexNormals_;
-			archive << vertexTangents_;
-			archive << vertexUVset0_;
-			archive << vertexUVset1_;
-			archive << vertexColors_;
-			archive << indexPrimitives_;
+			archive.WriteBulk(vertexPositions_);
+			archive.WriteBulk(vertexNormals_);
+			archive.WriteBulk(vertexTangents_);
+			archive.WriteBulk(vertexUVset0_);
+			archive.WriteBulk(vertexUVset1_);
+			archive.WriteBulk(vertexColors_);
+			archive.WriteBulk(indexPrimitives_);
 			archive << SCU32(ptype_);
 
 			archive << (uint32_t)morphTargets_.size();
 			for (size_t i = 0; i < morphTargets_.size(); ++i)
 			{
-				archive << morphTargets_[i].vertexPositions;
-				archive << morphTargets_[i].vertexNormals;
+				archive.WriteBulk(morphTargets_[i].vertexPositions);
+				archive.WriteBulk(morphTargets_[i].vertexNormals);
 				archive << morphTargets_[i].weight;
-				archive << morphTargets_[i].sparseIndicesPositions;
-				archive << morphTargets_[i].sparseIndicesNormals;
+				archive.WriteBulk(morphTargets_[i].sparseIndicesPositions);
+				archive.WriteBulk(morphTargets_[i].sparseIndicesNormals);
 			}
 
 			archive << (uint32_t)customBuffers_.size();
 			for (auto& it : customBuffers_)
 			{
-				archive << it;
+				archive.WriteBulk(it);
 			}
 
 			archive << subsets_.size();
@@ -524,6 +569,15 @@ namespace vz
 				archive << subsets_[i].indexOffset;
 				archive << subsets_[i].indexCount;
 			}
+
+			archive << bvh_.IsValid();
+			if (bvh_.IsValid())
+			{
+				archive << computeBVHContentHash();
+				archive << bvh_.node_count;
+				archive << bvh_.leaf_count;
+				archive.WriteBulk(bvh_.allocation);
+			}
 		}
 	}
 
@@ -541,13 +595,38 @@ namespace vz
 
 			uint32_t u32_data;
 			archive >> u32_data; // num of parts
+			parts_.resize(u32_data);
 			for (size_t i = 0, n = u32_data; i < n; ++i)
 			{
 				parts_[i].Serialize(archive, version);
+				parts_[i].recentBelongingGeometry_ = entity_;
 			}
 
+			isBVHRestored_ = false;
 			update();
 			isDirty_ = true;
+
+			// the BVH doesn't need to be rebuilt if every part came with a valid cached BVH
+			bool has_cached_bvh = !parts_.empty();
+			for (const Primitive& prim : parts_)
+			{
+				switch (prim.GetPrimitiveType())
+				{
+				case PrimitiveType::TRIANGLES:
+				case PrimitiveType::LINES:
+					has_cached_bvh &= prim.HasValidBVH();
+					break;
+				default:
+					break;
+				}
+			}
+			if (has_cached_bvh)
+			{
+				// isDirty_ makes the first UpdateRenderData() call update() again, which must keep this BVH
+				hasBVH_ = true;
+				isBVHRestored_ = true;
+				timeStampBVHUpdate_ = TimerNow;
+			}
 			timeStampSetter_ = TimerNow;
 		}
 		else
@@ -558,7 +637,7 @@ namespace vz
 			archive << isGPUBVHEnabled_;
 			archive << partLODs_;
 
-			archive << parts_.size();
+			archive << (uint32_t)parts_.size();
 			for (size_t i = 0, n = parts_.size(); i < n; ++i)
 			{
 				parts_[i].Serialize(archive, version);
@@ -627,7 +706,7 @@ namespace vz
 			archive >> histogram_.numBins;
 			archive >> histogram_.range;
 			archive >> histogram_.range_rcp;
-			archive >> histogram_.histogram;
+			readBulkArray(archive, histogram_.histogram);
 			timeStampSetter_ = TimerNow;
 		}
 		else
@@ -648,7 +727,7 @@ namespace vz
 			archive << histogram_.numBins;
 			archive << histogram_.range;
 			archive << histogram_.range_rcp;
-			archive << histogram_.histogram;
+			archive.WriteBulk(histogram_.histogram);
 		}
 	}
 
@@ -523,6 +523,7 @@ namespace vz
 		// Non-serialized attributes
 		std::vector<VUID> childrenCache_;
 		inline void updateChildren();
+		static void notifyParentChanged();
 
 	public:
 		HierarchyComponent(const Entity entity, const VUID vuid = 0) : ComponentBase(ComponentType::HIERARCHY, entity, vuid) {}
@@ -536,6 +537,8 @@ namespace vz
 		inline void AddChild(const VUID vuidChild);
 		inline void RemoveChild(const VUID vuidChild);
 		inline const std::vector<VUID>& GetChildren() { if (children_.size() != childrenCache_.size()) updateChildren(); return childrenCache_; }
+		// increased whenever the parent of any hierarchy changes (used to rebuild flattened scene hierarchies)
+		static uint64_t GetParentRevision();
 		
 		bool ResetRefComponents(const VUID vuidRef) override;
 		void Serialize(vz::Archive& archive, const uint64_t version) override;
@@ -687,6 +690,9 @@ namespace vz
 
 			// Non-serialized attributes:
 			mutable int next_event = 0;
+			mutable int keyCursor = 0;	// first keyframe after the previous update's time (forward playback only steps it)
+			mutable VUID targetEntityVUID = INVALID_VUID;	// targetNameVUID that targetEntity was resolved from
+			mutable Entity targetEntity = INVALID_ENTITY;
 		};
 		struct Sampler
 		{
@@ -1144,6 +1150,10 @@ namespace vz
 			//	true: BVH will be built immediately if it doesn't exist yet
 			//	false: BVH will be deleted immediately if it exists
 			void updateBVH(const bool value);
+			// fills bvhLeafAabbs_ from the triangles or lines (layerMask is the primitive index)
+			void computeBVHLeafAABBs();
+			// hash of the positions and indices, a serialized BVH is only valid for the same content
+			uint64_t computeBVHContentHash() const;
 
 		public:
 			mutable bool autoUpdateRenderData = true;
@@ -1241,6 +1251,7 @@ namespace vz
 		bool isDirty_ = true;	// BVH, AABB, ...
 		bool hasRenderData_ = false;
 		bool hasBVH_ = false;
+		bool isBVHRestored_ = false; // set by Serialize() when every part came with a valid cached BVH, consumed by the next update()
 		geometrics::AABB aabb_; // not serialized (automatically updated)
 		std::shared_ptr<WaitForBool> waiter_ = std::make_shared<WaitForBool>();
 
@@ -1316,12 +1327,20 @@ namespace vz
 			range = maxValue - minValue;
 			range_rcp = 1.f / range;
 		}
-		inline void CountValue(const float v)
+		inline bool FindBin(const float v, size_t& index) const
 		{
 			float normal_v = (v - minValue) * range_rcp;
-			if (normal_v < 0 || normal_v > 1) return;
-			size_t index = (size_t)(normal_v * numBins_1);
-			histogram[index]++;
+			if (normal_v < 0 || normal_v > 1) return false;
+			index = (size_t)(normal_v * numBins_1);
+			return true;
+		}
+		inline void CountValue(const float v)
+		{
+			size_t index;
+			if (FindBin(v, index))
+			{
+				histogram[index]++;
+			}
 		}
 	};
 	constexpr size_t TEXTURE_MAX_RESOLUTION = 4096;
@@ -2,6 +2,7 @@
 #include "Common/Engine_Internal.h"
 #include "Utils/Backlog.h"
 #include "Utils/Timer.h"
+#include "Utils/JobSystem.h"
 
 #include "ThirdParty/mikktspace.h"
 #include "ThirdParty/meshoptimizer/meshoptimizer.h"
@@ -24,6 +25,7 @@ namespace vz
 			prim.recentBelongingGeometry_ = entity_;
 		}
 		isDirty_ = true;
+		isBVHRestored_ = false;
 		timeStampSetter_ = TimerNow;
 	}
 	void GeometryComponent::CopyPrimitivesFrom(const std::vector<Primitive>& primitives)
@@ -37,6 +39,7 @@ namespace vz
 			prim.recentBelongingGeometry_ = entity_;
 		}
 		isDirty_ = true;
+		isBVHRestored_ = false;
 		timeStampSetter_ = TimerNow;
 	}
 
@@ -66,6 +69,7 @@ namespace vz
 		prim.MoveFrom(std::move(primitive));
 		prim.recentBelongingGeometry_ = entity_;
 		isDirty_ = true;
+		isBVHRestored_ = false;
 		timeStampSetter_ = TimerNow;
 	}
 	void GeometryComponent::CopyPrimitiveFrom(const Primitive& primitive, const size_t slot)
@@ -77,6 +81,7 @@ namespace vz
 		Primitive& prim = parts_[slot];
 		prim.recentBelongingGeometry_ = entity_;
 		isDirty_ = true;
+		isBVHRestored_ = false;
 		timeStampSetter_ = TimerNow;
 	}
 	void GeometryComponent::AddMovePrimitiveFrom(Primitive&& primitive)
@@ -86,6 +91,7 @@ namespace vz
 		parts_.push_back(std::move(primitive));
 		parts_.back().recentBelongingGeometry_ = entity_;
 		isDirty_ = true;
+		isBVHRestored_ = false;
 		timeStampSetter_ = TimerNow;
 	}
 	void GeometryComponent::AddCopyPrimitiveFrom(const Primitive& primitive)
@@ -93,6 +99,7 @@ namespace vz
 		parts_.push_back(primitive);
 		parts_.back().recentBelongingGeometry_ = entity_;
 		isDirty_ = true;
+		isBVHRestored_ = false;
 		timeStampSetter_ = TimerNow;
 	}
 
@@ -104,6 +111,7 @@ namespace vz
 		DeleteRenderData();
 
 		isDirty_ = true;
+		isBVHRestored_ = false;
 		hasBVH_ = false;
 		aabb_ = geometrics::AABB();
 	}
@@ -123,12 +131,14 @@ namespace vz
 			return nullptr;
 		}
 		waiter_->waitForFree();
+		isBVHRestored_ = false;
 		return &parts_[slot];
 	}
 
 	std::vector<Primitive>& GeometryComponent::GetMutablePrimitives()
 	{
 		waiter_->waitForFree();
+		isBVHRestored_ = false;
 		return parts_;
 	}
 }
@@ -161,8 +171,16 @@ namespace vz
 		// TODO: UPDATE 'partLODs_'
 		partLODs_ = subset_count;
 
-		timeStampPrimitiveUpdate_ = TimerNow;
-		hasBVH_ = false;
+		if (isBVHRestored_)
+		{
+			// the parts and their BVHs were restored together by Serialize(), the restored BVH stays valid
+			isBVHRestored_ = false;
+		}
+		else
+		{
+			timeStampPrimitiveUpdate_ = TimerNow;
+			hasBVH_ = false;
+		}
 		isDirty_ = false;
 	}
 }
@@ -460,6 +478,72 @@ namespace vz
 		return true;                         // all faces passed
 	}
 
+	void Primitive::computeBVHLeafAABBs()
+	{
+		bvhLeafAabbs_.clear();
+		const uint32_t index_count = (uint32_t)indexPrimitives_.size();
+		switch (ptype_)
+		{
+		case PrimitiveType::TRIANGLES:
+		{
+			const uint32_t triangle_count = index_count / 3;
+			bvhLeafAabbs_.reserve(triangle_count);
+			for (uint32_t triangle_index = 0; triangle_index < triangle_count; ++triangle_index)
+			{
+				const uint32_t i0 = indexPrimitives_[triangle_index * 3 + 0];
+				const uint32_t i1 = indexPrimitives_[triangle_index * 3 + 1];
+				const uint32_t i2 = indexPrimitives_[triangle_index * 3 + 2];
+				const XMFLOAT3& p0 = vertexPositions_[i0];
+				const XMFLOAT3& p1 = vertexPositions_[i1];
+				const XMFLOAT3& p2 = vertexPositions_[i2];
+				geometrics::AABB aabb = geometrics::AABB(math::Min(p0, math::Min(p1, p2)), math::Max(p0, math::Max(p1, p2)));
+				aabb.layerMask = triangle_index;
+				//aabb.userdata = part_index;
+				bvhLeafAabbs_.push_back(aabb);
+			}
+		}
+		break;
+		case PrimitiveType::LINES:
+		{
+			const uint32_t line_count = index_count / 2;
+			bvhLeafAabbs_.reserve(line_count);
+			for (uint32_t line_index = 0; line_index < line_count; ++line_index)
+			{
+				const uint32_t i0 = indexPrimitives_[line_index * 2 + 0];
+				const uint32_t i1 = indexPrimitives_[line_index * 2 + 1];
+				const XMFLOAT3& p0 = vertexPositions_[i0];
+				const XMFLOAT3& p1 = vertexPositions_[i1];
+				geometrics::AABB aabb = geometrics::AABB(math::Min(p0, p1), math::Max(p0, p1));
+				aabb.layerMask = line_index;
+				//aabb.userdata = part_index;
+				bvhLeafAabbs_.push_back(aabb);
+			}
+		}
+		break;
+		default:
+			break;
+		}
+	}
+
+	uint64_t Primitive::computeBVHContentHash() const
+	{
+		// 64-bit FNV-1a over 32-bit words, the data is always a whole number of words
+		auto hashWords = [](uint64_t hash, const uint32_t* words, size_t count) {
+			for (size_t i = 0; i < count; ++i)
+			{
+				hash ^= words[i];
+				hash *= 0x100000001b3ull;
+			}
+			return hash;
+			};
+		uint64_t hash = 0xcbf29ce484222325ull;
+		hash = hashWords(hash, (const uint32_t*)vertexPositions_.data(), vertexPositions_.size() * 3);
+		hash = hashWords(hash, indexPrimitives_.data(), indexPrimitives_.size());
+		const uint32_t ptype = (uint32_t)ptype_;
+		hash = hashWords(hash, &ptype, 1);
+		return hash;
+	}
+
 	void Primitive::updateBVH(const bool enabled)
 	{
 		//vzlog_assert(ptype_ == PrimitiveType::TRIANGLES, "BVH is allowed only for triangle mesh (no stripe)");
@@ -481,21 +565,9 @@ namespace vz
 				Timer timer;
 
 				const uint32_t triangle_count = index_count / 3;
-				for (uint32_t triangle_index = 0; triangle_index < triangle_count; ++triangle_index)
-				{
-					const uint32_t i0 = indexPrimitives_[triangle_index * 3 + 0];
-					const uint32_t i1 = indexPrimitives_[triangle_index * 3 + 1];
-					const uint32_t i2 = indexPrimitives_[triangle_index * 3 + 2];
-					const XMFLOAT3& p0 = vertexPositions_[i0];
-					const XMFLOAT3& p1 = vertexPositions_[i1];
-					const XMFLOAT3& p2 = vertexPositions_[i2];
-					geometrics::AABB aabb = geometrics::AABB(math::Min(p0, math::Min(p1, p2)), math::Max(p0, math::Max(p1, p2)));
-					aabb.layerMask = triangle_index;
-					//aabb.userdata = part_index;
-					bvhLeafAabbs_.push_back(aabb);
-				}
+				computeBVHLeafAABBs();
 				bvh_.maxLeafPrimitives = 2;
-				bvh_.Build(bvhLeafAabbs_.data(), (uint32_t)bvhLeafAabbs_.size());
+				bvh_.BuildParallel(bvhLeafAabbs_.data(), (uint32_t)bvhLeafAabbs_.size());
 
 				if (triangle_count < 100)
 				{
@@ -509,7 +581,7 @@ namespace vz
 				else
 					isConvex = false;
 
-				backlog::postThreadSafe("CPUBVH updated (" + std::to_string((int)std::round(timer.elapsed())) + " ms)" + " # of tris: " + std::to_string(triangle_count));
+				backlog::postThreadSafe("CPUBVH updated (" + std::to_string((int)std::round(timer.elapsed())) + " ms)" + " # of tris: " + std::to_string(triangle_count) + ", SAH cost: " + std::to_string(bvh_.GetSAHCost()));
 			} 
 			break;
 			case PrimitiveType::LINES:
@@ -517,21 +589,11 @@ namespace vz
 				Timer timer;
 
 				const uint32_t line_count = index_count / 2;
-				for (uint32_t line_index = 0; line_index < line_count; ++line_index)
-				{
-					const uint32_t i0 = indexPrimitives_[line_index * 2 + 0];
-					const uint32_t i1 = indexPrimitives_[line_index * 2 + 1];
-					const XMFLOAT3& p0 = vertexPositions_[i0];
-					const XMFLOAT3& p1 = vertexPositions_[i1];
-					geometrics::AABB aabb = geometrics::AABB(math::Min(p0, p1), math::Max(p0, p1));
-					aabb.layerMask = line_index;
-					//aabb.userdata = part_index;
-					bvhLeafAabbs_.push_back(aabb);
-				}
+				computeBVHLeafAABBs();
 				bvh_.maxLeafPrimitives = 2;
-				bvh_.Build(bvhLeafAabbs_.data(), (uint32_t)bvhLeafAabbs_.size());
+				bvh_.BuildParallel(bvhLeafAabbs_.data(), (uint32_t)bvhLeafAabbs_.size());
 
-				backlog::postThreadSafe("CPUBVH updated (" + std::to_string((int)std::round(timer.elapsed())) + " ms)" + " # of tris: " + std::to_string(line_count));
+				backlog::postThreadSafe("CPUBVH updated (" + std::to_string((int)std::round(timer.elapsed())) + " ms)" + " # of tris: " + std::to_string(line_count) + ", SAH cost: " + std::to_string(bvh_.GetSAHCost()));
 			}
 			default:
 				backlog::postThreadSafe("Invalid Primitive Type for CPUBVH!", backlog::LogLevel::Warn);
@@ -590,12 +652,10 @@ namespace vz
 	{
 		// Start recalculating normals:
 
-		if (computeMode != NormalComputeMethod::COMPUTE_NORMALS_SMOOTH_FAST)
+		if (computeMode == NormalComputeMethod::COMPUTE_NORMALS_HARD)
 		{
 			// Compute hard surface normals:
 
-			// Right now they are always computed even before smooth setting
-
 			std::vector<uint32_t> newIndexBuffer;
 			std::vector<XMFLOAT3> newPositionsBuffer;
 			std::vector<XMFLOAT3> newNormalsBuffer;
@@ -676,152 +736,245 @@ namespace vz
 		case NormalComputeMethod::COMPUTE_NORMALS_SMOOTH:
 		{
 			// Compute smooth surface normals:
+			//	vertices at the same position get the average of all adjacent face normals,
+			//	then vertices with the same position and UVs are welded into one
+			//	(sorting and counting instead of comparing every vertex with every face, so this is O(N log N))
+
+			const uint32_t vertex_count = (uint32_t)vertexPositions_.size();
+			const uint32_t corner_count = (uint32_t)(indexPrimitives_.size() / 3 * 3);
+			const uint32_t face_count = corner_count / 3;
+			if (face_count == 0)
+				break;
 
-			// 1.) Zero normals, they will be averaged later
-			for (size_t i = 0; i < vertexNormals_.size(); i++)
+			jobsystem::context ctx;
+
+			// 1.) Face normals:
+			std::vector<XMFLOAT3> face_normals(face_count);
+			jobsystem::Dispatch(ctx, face_count, 1024, [&](jobsystem::JobArgs args) {
+				const uint32_t i0 = indexPrimitives_[args.jobIndex * 3 + 0];
+				const uint32_t i1 = indexPrimitives_[args.jobIndex * 3 + 1];
+				const uint32_t i2 = indexPrimitives_[args.jobIndex * 3 + 2];
+				XMVECTOR P0 = XMLoadFloat3(&vertexPositions_[i0]);
+				XMVECTOR U = XMLoadFloat3(&vertexPositions_[i1]) - P0;
+				XMVECTOR V = XMLoadFloat3(&vertexPositions_[i2]) - P0;
+				XMStoreFloat3(&face_normals[args.jobIndex], XMVector3Normalize(XMVector3Cross(U, V)));
+				});
+
+			// 2.) Find identical positions: sort the position bits so equal positions become neighbours (+0 and -0 are the same)
+			auto floatBits = [](float f) {
+				if (f == 0)
+					f = 0;
+				uint32_t bits;
+				std::memcpy(&bits, &f, sizeof(bits));
+				return bits;
+				};
+			struct PositionKey
 			{
-				vertexNormals_[i] = XMFLOAT3(0, 0, 0);
+				uint32_t x, y, z;
+				uint32_t vertex;
+			};
+			std::vector<PositionKey> position_keys(vertex_count);
+			for (uint32_t i = 0; i < vertex_count; ++i)
+			{
+				const XMFLOAT3& p = vertexPositions_[i];
+				position_keys[i] = { floatBits(p.x), floatBits(p.y), floatBits(p.z), i };
 			}
-
-			std::vector<size_t> vtx_counter(vertexPositions_.size(), 0);
-			// 2.) Find identical vertices by POSITION, accumulate face normals
-			for (size_t i = 0; i < vertexPositions_.size(); i++)
+			std::sort(position_keys.begin(), position_keys.end(), [](const PositionKey& a, const PositionKey& b) {
+				return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+				});
+			std::vector<uint32_t> position_ids(vertex_count);
+			uint32_t position_count = 0;
+			for (uint32_t i = 0; i < vertex_count; ++i)
 			{
-				XMFLOAT3& v_search_pos = vertexPositions_[i];
-
-				for (size_t ind = 0; ind < indexPrimitives_.size() / 3; ++ind)
+				const PositionKey& key = position_keys[i];
+				if (i == 0 || key.x != position_keys[i - 1].x || key.y != position_keys[i - 1].y || key.z != position_keys[i - 1].z)
 				{
-					uint32_t i0 = indexPrimitives_[ind * 3 + 0];
-					uint32_t i1 = indexPrimitives_[ind * 3 + 1];
-					uint32_t i2 = indexPrimitives_[ind * 3 + 2];
-
-					XMFLOAT3& v0 = vertexPositions_[i0];
-					XMFLOAT3& v1 = vertexPositions_[i1];
-					XMFLOAT3& v2 = vertexPositions_[i2];
-
-
-					bool match_pos0 =
-						math::float_equal(v_search_pos.x, v0.x) &&
-						math::float_equal(v_search_pos.y, v0.y) &&
-						math::float_equal(v_search_pos.z, v0.z);
-
-					bool match_pos1 =
-						math::float_equal(v_search_pos.x, v1.x) &&
-						math::float_equal(v_search_pos.y, v1.y) &&
-						math::float_equal(v_search_pos.z, v1.z);
-
-					bool match_pos2 =
-						math::float_equal(v_search_pos.x, v2.x) &&
-						math::float_equal(v_search_pos.y, v2.y) &&
-						math::float_equal(v_search_pos.z, v2.z);
-
-					if (match_pos0 || match_pos1 || match_pos2)
-					{
-						XMVECTOR U = XMLoadFloat3(&v1) - XMLoadFloat3(&v0);
-						XMVECTOR V = XMLoadFloat3(&v2) - XMLoadFloat3(&v0);
-
-						XMVECTOR N = XMVector3Cross(U, V);
-						N = XMVector3Normalize(N);
-
-						XMFLOAT3 normal;
-						XMStoreFloat3(&normal, N);
-
-						vertexNormals_[i].x += normal.x;
-						vertexNormals_[i].y += normal.y;
-						vertexNormals_[i].z += normal.z;
-						vtx_counter[i]++;
-					}
-
+					position_count++;
 				}
+				position_ids[key.vertex] = position_count - 1;
 			}
+			position_keys = {};
 
-			// 3.) Find duplicated vertices by POSITION and UV0 and UV1 and remove them:
-			uint32_t first_subset = 0;
-			uint32_t last_subset = 0;
-
-			for (uint32_t i = 0; i < indexPrimitives_.size() - 1; i++)
+			// 3.) Faces adjacent to each position (counting sort), then average their normals in parallel:
+			std::vector<uint32_t> adjacency_offsets(position_count + 1, 0);
+			for (uint32_t corner = 0; corner < corner_count; ++corner)
 			{
-				uint32_t ind0 = indexPrimitives_[i];
-				const XMFLOAT3& p0 = vertexPositions_[ind0];
-				const XMFLOAT2& u00 = vertexUVset0_.empty() ? XMFLOAT2(0, 0) : vertexUVset0_[ind0];
-				const XMFLOAT2& u10 = vertexUVset1_.empty() ? XMFLOAT2(0, 0) : vertexUVset1_[ind0];
-
-				for (uint32_t j = 1; j < indexPrimitives_.size(); j++)
+				adjacency_offsets[position_ids[indexPrimitives_[corner]] + 1]++;
+			}
+			for (uint32_t i = 0; i < position_count; ++i)
+			{
+				adjacency_offsets[i + 1] += adjacency_offsets[i];
+			}
+			std::vector<uint32_t> adjacency(corner_count);
+			{
+				std::vector<uint32_t> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+				for (uint32_t corner = 0; corner < corner_count; ++corner)
 				{
-					uint32_t ind1 = indexPrimitives_[j];
-
-					if (ind1 == ind0)
-					{
+					adjacency[cursor[position_ids[indexPrimitives_[corner]]]++] = corner / 3;
+				}
+			}
+			jobsystem::Wait(ctx); // face normals
+
+			std::vector<XMFLOAT3> position_normals(position_count);
+			jobsystem::Dispatch(ctx, position_count, 1024, [&](jobsystem::JobArgs args) {
+				const uint32_t begin = adjacency_offsets[args.jobIndex];
+				const uint32_t end = adjacency_offsets[args.jobIndex + 1];
+				XMVECTOR N = XMVectorZero();
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					N += XMLoadFloat3(&face_normals[adjacency[i]]);
+				}
+				if (end > begin)
+				{
+					N /= (float)(end - begin);
+				}
+				XMStoreFloat3(&position_normals[args.jobIndex], N);
+				});
+
+			// 4.) Weld the referenced vertices that have the same position and UVs:
+			//	new vertices keep the order of their first source vertex, so nothing moves when nothing is welded
+			//	custom buffers have no known per-vertex layout, so a primitive with them is not welded
+			std::vector<uint32_t> remap;
+			std::vector<uint32_t> welded_vertices; // source vertex of each new vertex
+			if (customBuffers_.empty())
+			{
+				std::vector<uint8_t> referenced(vertex_count, 0);
+				for (uint32_t corner = 0; corner < corner_count; ++corner)
+				{
+					referenced[indexPrimitives_[corner]] = 1;
+				}
+				struct VertexKey
+				{
+					uint32_t position;
+					uint32_t uv0x, uv0y, uv1x, uv1y;
+					uint32_t vertex;
+				};
+				std::vector<VertexKey> vertex_keys;
+				vertex_keys.reserve(vertex_count);
+				for (uint32_t i = 0; i < vertex_count; ++i)
+				{
+					if (referenced[i] == 0)
 						continue;
+					const XMFLOAT2 uv0 = vertexUVset0_.empty() ? XMFLOAT2(0, 0) : vertexUVset0_[i];
+					const XMFLOAT2 uv1 = vertexUVset1_.empty() ? XMFLOAT2(0, 0) : vertexUVset1_[i];
+					vertex_keys.push_back({ position_ids[i], floatBits(uv0.x), floatBits(uv0.y), floatBits(uv1.x), floatBits(uv1.y), i });
+				}
+				auto sameVertex = [](const VertexKey& a, const VertexKey& b) {
+					return a.position == b.position && a.uv0x == b.uv0x && a.uv0y == b.uv0y && a.uv1x == b.uv1x && a.uv1y == b.uv1y;
+					};
+				std::sort(vertex_keys.begin(), vertex_keys.end(), [](const VertexKey& a, const VertexKey& b) {
+					if (a.position != b.position) return a.position < b.position;
+					if (a.uv0x != b.uv0x) return a.uv0x < b.uv0x;
+					if (a.uv0y != b.uv0y) return a.uv0y < b.uv0y;
+					if (a.uv1x != b.uv1x) return a.uv1x < b.uv1x;
+					if (a.uv1y != b.uv1y) return a.uv1y < b.uv1y;
+					return a.vertex < b.vertex; // the first vertex of a group is its smallest one
+					});
+				std::vector<uint32_t> leaders(vertex_count); // unreferenced vertices stay on their own
+				for (uint32_t i = 0; i < vertex_count; ++i)
+				{
+					leaders[i] = i;
+				}
+				for (size_t i = 0, group = 0; i < vertex_keys.size(); ++i)
+				{
+					if (!sameVertex(vertex_keys[i], vertex_keys[group]))
+					{
+						group = i;
 					}
+					leaders[vertex_keys[i].vertex] = vertex_keys[group].vertex;
+				}
+				vertex_keys = {};
 
-					const XMFLOAT3& p1 = vertexPositions_[ind1];
-					const XMFLOAT2& u01 = vertexUVset0_.empty() ? XMFLOAT2(0, 0) : vertexUVset0_[ind1];
-					const XMFLOAT2& u11 = vertexUVset1_.empty() ? XMFLOAT2(0, 0) : vertexUVset1_[ind1];
-
-					const bool duplicated_pos =
-						math::float_equal(p0.x, p1.x) &&
-						math::float_equal(p0.y, p1.y) &&
-						math::float_equal(p0.z, p1.z);
-
-					const bool duplicated_uv0 =
-						math::float_equal(u00.x, u01.x) &&
-						math::float_equal(u00.y, u01.y);
-
-					const bool duplicated_uv1 =
-						math::float_equal(u10.x, u11.x) &&
-						math::float_equal(u10.y, u11.y);
-
-					if (duplicated_pos && duplicated_uv0 && duplicated_uv1)
+				remap.resize(vertex_count);
+				welded_vertices.reserve(vertex_count);
+				for (uint32_t i = 0; i < vertex_count; ++i)
+				{
+					if (leaders[i] == i)
 					{
-						// Erase vertices[ind1] because it is a duplicate:
-						if (ind1 < vertexPositions_.size())
-						{
-							vertexPositions_.erase(vertexPositions_.begin() + ind1);
-						}
-						if (ind1 < vertexNormals_.size())
-						{
-							vertexNormals_.erase(vertexNormals_.begin() + ind1);
-						}
-						if (ind1 < vertexUVset0_.size())
-						{
-							vertexUVset0_.erase(vertexUVset0_.begin() + ind1);
-						}
-						if (ind1 < vertexUVset1_.size())
-						{
-							vertexUVset1_.erase(vertexUVset1_.begin() + ind1);
-						}
-						if (ind1 < vtx_counter.size())
-						{
-							vtx_counter.erase(vtx_counter.begin() + ind1);
-						}
-
-						// The vertices[ind1] was removed, so each index after that needs to be updated:
-						for (auto& index : indexPrimitives_)
-						{
-							if (index > ind1 && index > 0)
-							{
-								index--;
-							}
-							else if (index == ind1)
-							{
-								index = ind0;
-							}
-						}
-
+						remap[i] = (uint32_t)welded_vertices.size();
+						welded_vertices.push_back(i);
+					}
+					else
+					{
+						remap[i] = remap[leaders[i]]; // leaders[i] < i, so it is already numbered
 					}
 				}
 			}
+			jobsystem::Wait(ctx); // position normals
 
-			// Normalize //
-			for (size_t i = 0; i < vertexNormals_.size(); i++)
+			if (welded_vertices.empty() || welded_vertices.size() == vertex_count)
 			{
-				float num_rcp = 1.f / (float)vtx_counter[i];
-				XMFLOAT3& n = vertexNormals_[i];
-				n.x *= num_rcp;
-				n.y *= num_rcp;
-				n.z *= num_rcp;
+				// Nothing to weld, the vertices stay where they are:
+				vertexNormals_.resize(vertex_count);
+				jobsystem::Dispatch(ctx, vertex_count, 4096, [&](jobsystem::JobArgs args) {
+					vertexNormals_[args.jobIndex] = position_normals[position_ids[args.jobIndex]];
+					});
+				jobsystem::Wait(ctx);
+				break;
 			}
+
+			// Every per-vertex array, including the morph targets, is gathered through the weld (tangents are cleared below):
+			const uint32_t welded_count = (uint32_t)welded_vertices.size();
+			auto gatherWelded = [&](auto& attribute) {
+				if (attribute.size() != vertex_count)
+					return;
+				std::remove_reference_t<decltype(attribute)> welded(welded_count);
+				for (uint32_t i = 0; i < welded_count; ++i)
+				{
+					welded[i] = attribute[welded_vertices[i]];
+				}
+				attribute = std::move(welded);
+				};
+			auto remapSparse = [&](std::vector<XMFLOAT3>& values, std::vector<uint32_t>& sparse_indices) {
+				// a welded vertex takes the morph of the vertex it was merged into, so its own entry is dropped
+				size_t count = 0;
+				for (size_t i = 0; i < sparse_indices.size() && i < values.size(); ++i)
+				{
+					const uint32_t vertex = sparse_indices[i];
+					if (vertex >= vertex_count || welded_vertices[remap[vertex]] != vertex)
+						continue;
+					sparse_indices[count] = remap[vertex];
+					values[count] = values[i];
+					count++;
+				}
+				sparse_indices.resize(count);
+				values.resize(count);
+				};
+
+			std::vector<XMFLOAT3> newNormalsBuffer(welded_count);
+			jobsystem::Dispatch(ctx, welded_count, 4096, [&](jobsystem::JobArgs args) {
+				newNormalsBuffer[args.jobIndex] = position_normals[position_ids[welded_vertices[args.jobIndex]]];
+				});
+			jobsystem::Dispatch(ctx, corner_count, 4096, [&](jobsystem::JobArgs args) {
+				indexPrimitives_[args.jobIndex] = remap[indexPrimitives_[args.jobIndex]];
+				});
+			gatherWelded(vertexPositions_);
+			gatherWelded(vertexUVset0_);
+			gatherWelded(vertexUVset1_);
+			gatherWelded(vertexColors_);
+			for (MorphTarget& morph : morphTargets_)
+			{
+				if (morph.sparseIndicesPositions.empty())
+				{
+					gatherWelded(morph.vertexPositions);
+				}
+				else
+				{
+					remapSparse(morph.vertexPositions, morph.sparseIndicesPositions);
+				}
+				if (morph.sparseIndicesNormals.empty())
+				{
+					gatherWelded(morph.vertexNormals);
+				}
+				else
+				{
+					remapSparse(morph.vertexNormals, morph.sparseIndicesNormals);
+				}
+			}
+			jobsystem::Wait(ctx);
+
+			indexPrimitives_.resize(corner_count);
+			vertexNormals_ = std::move(newNormalsBuffer);
 		}
 		break;
 
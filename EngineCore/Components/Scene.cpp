@@ -8,9 +8,12 @@
 #include "Utils/Platform.h"
 #include "Utils/Geometrics.h"
 #include "Utils/Profiler.h"
+#include "Utils/Allocator.h"
 #include "GBackend/GModuleLoader.h"
 
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <atomic>
 #include <chrono>
 #include <random>
@@ -82,6 +85,23 @@ namespace vz
 		std::atomic<uint32_t> geometryAllocator{ 0 }; // for Geometry::Primitive
 		std::atomic<uint32_t> instanceResLookupAllocator{ 0 };
 
+		// Flattened transform hierarchy, parents are always placed before their children:
+		//	rebuilt only when the scene entities or the parent links of the hierarchies change
+		struct FlatTransform
+		{
+			XMFLOAT4X4 local;
+			XMFLOAT4X4 world;
+			TransformComponent* transform = nullptr; // pointer for one frame only!
+			uint32_t parent = ~0u; // index into flatTransforms, ~0u for roots
+			bool isExternalParent = false; // the parent is not a member of this scene
+		};
+		std::vector<FlatTransform> flatTransforms;
+		std::vector<uint32_t> flatTransformLookup; // transforms_ index -> flatTransforms index
+		std::vector<uint32_t> flatTransformLevels; // flatTransforms offsets of each depth level (levels + 1 entries)
+		uint64_t flatHierarchyRevision = 0;
+		TimeStamp flatHierarchyTime = TimerMin;
+		bool isFlatHierarchyDirty = true;
+
 		// Separate stream of world matrices:
 		std::vector<XMFLOAT4X4> matrixRenderables;
 		std::vector<XMFLOAT4X4> matrixRenderablesPrev;
@@ -122,17 +142,27 @@ namespace vz
 		geometrics::BVH colliderBvhNext;
 		jobsystem::context colliderBvhWorkload;
 
+		// Top-level BVH over renderable world bounds for picking, its leaf indices are renderable indices:
+		std::vector<geometrics::AABB> aabbRenderablesPicking; // bounds of all renderables, including the ones that are not rendered
+		uint64_t renderablesRevision = 0; // incremented whenever renderables_ changes (add, remove, clear)
+		uint64_t renderableBvhRevision = ~0ull; // renderablesRevision of the last full rebuild
+		geometrics::BVH renderableBvh;
+
 		// Animation processing optimizer:
 		struct AnimationQueue
 		{
 			// The animations within one queue must be processed on the same thread in order
 			std::vector<AnimationComponent*> animations; // pointers for one frame only!
-			std::unordered_set<Entity> entities;
 		};
 		std::vector<AnimationQueue> animationQueues; // different animation queues can be processed in different threads in any order
 		size_t animationQueueCount = 0; // to avoid resizing animation queues downwards because the internals for them needs to be reallocated in that case
 		jobsystem::context animationDependencyScanWorkload;
 
+		// Scene update systems, executed as a dependency graph:
+		jobsystem::TaskGraph updateGraph;
+		std::vector<jobsystem::TaskGraph::PathNode> criticalPath;
+		char criticalPathLabel[96] = {}; // profiler range name of a critical path entry, reused every frame
+
 		// Method Details:
 		const std::vector<GRenderableComponent*>& GetRenderableComponents() const override { return renderableComponents; }
 		const std::vector<GRenderableComponent*>& GetRenderableMeshComponents() const override { return renderableMeshComponents; }
@@ -149,15 +179,103 @@ namespace vz
 		const uint32_t GetGeometryPrimitivesAllocatorSize() const override { return geometryAllocator.load(); }
 		const uint32_t GetRenderableResLookupAllocatorSize() const override { return instanceResLookupAllocator.load(); }
 
-		void RunTransformUpdateSystem(jobsystem::context& ctx)
+		void updateFlatHierarchy()
+		{
+			uint64_t revision = HierarchyComponent::GetParentRevision();
+			if (!isFlatHierarchyDirty && revision == flatHierarchyRevision
+				&& TimeDurationCount(timeStampSetter_, flatHierarchyTime) <= 0
+				&& flatTransformLookup.size() == transforms_.size())
+			{
+				return;
+			}
+			isFlatHierarchyDirty = false;
+			flatHierarchyRevision = revision;
+			flatHierarchyTime = timeStampSetter_;
+
+			const uint32_t INVALID_INDEX = ~0u;
+			const uint32_t EXTERNAL_INDEX = ~1u;
+			const uint32_t num_transforms = (uint32_t)transforms_.size();
+
+			// parent index into transforms_
+			allocator::frame_vector<uint32_t> parents(num_transforms, INVALID_INDEX);
+			for (uint32_t i = 0; i < num_transforms; ++i)
+			{
+				HierarchyComponent* hierarchy = compfactory::GetHierarchyComponent(transforms_[i]);
+				if (hierarchy == nullptr || hierarchy->GetParent() == INVALID_VUID)
+					continue;
+				Entity entity_parent = compfactory::GetEntityByVUID(hierarchy->GetParent());
+				auto it = lookupTransforms_.find(entity_parent);
+				parents[i] = it != lookupTransforms_.end() ? it->second : EXTERNAL_INDEX;
+			}
+
+			// depth of each node, resolved iteratively along the (unresolved) parent chain
+			allocator::frame_vector<uint32_t> depths(num_transforms, INVALID_INDEX);
+			allocator::frame_vector<uint32_t> chain;
+			uint32_t num_levels = 0;
+			for (uint32_t i = 0; i < num_transforms; ++i)
+			{
+				uint32_t node = i;
+				while (depths[node] == INVALID_INDEX && parents[node] < num_transforms && chain.size() < num_transforms)
+				{
+					chain.push_back(node);
+					node = parents[node];
+				}
+				uint32_t depth = depths[node];
+				if (depth == INVALID_INDEX)
+				{
+					// root (or a broken cycle)
+					vzlog_assert(chain.size() < num_transforms, "Cyclic hierarchy!");
+					depth = 0;
+					depths[node] = 0;
+				}
+				while (!chain.empty())
+				{
+					depths[chain.back()] = ++depth;
+					chain.pop_back();
+				}
+				num_levels = std::max(num_levels, depths[i] + 1);
+			}
+
+			// counting sort by depth: parents before children
+			flatTransformLevels.assign(num_levels + 1, 0u);
+			for (uint32_t i = 0; i < num_transforms; ++i)
+			{
+				flatTransformLevels[depths[i] + 1]++;
+			}
+			for (uint32_t level = 0; level < num_levels; ++level)
+			{
+				flatTransformLevels[level + 1] += flatTransformLevels[level];
+			}
+			allocator::frame_vector<uint32_t> level_cursors(flatTransformLevels.begin(), flatTransformLevels.end() - 1);
+			flatTransformLookup.resize(num_transforms);
+			for (uint32_t i = 0; i < num_transforms; ++i)
+			{
+				flatTransformLookup[i] = level_cursors[depths[i]]++;
+			}
+
+			flatTransforms.resize(num_transforms);
+			for (uint32_t i = 0; i < num_transforms; ++i)
+			{
+				FlatTransform& flat = flatTransforms[flatTransformLookup[i]];
+				flat.isExternalParent = parents[i] == EXTERNAL_INDEX;
+				flat.parent = parents[i] < num_transforms && depths[i] > 0 ? flatTransformLookup[parents[i]] : INVALID_INDEX;
+			}
+		}
+		jobsystem::TaskGraph::NodeID RunTransformUpdateSystem(jobsystem::TaskGraph& graph)
 		{
+			updateFlatHierarchy();
+
 			// local matrix update
-			jobsystem::Dispatch(ctx, (uint32_t)transforms_.size(), SMALL_SUBTASK_GROUPSIZE, [&](jobsystem::JobArgs args) {
+			return graph.AddNode("Transforms", (uint32_t)transforms_.size(), SMALL_SUBTASK_GROUPSIZE, [this](jobsystem::JobArgs args) {
 
 				Entity entity = transforms_[args.jobIndex];
 				TransformComponent* transform = compfactory::GetTransformComponent(entity);
 				transform->UpdateMatrix();
 
+				FlatTransform& flat = flatTransforms[flatTransformLookup[args.jobIndex]];
+				flat.transform = transform;
+				flat.local = transform->GetLocalMatrix();
+
 				isContentChanged_ |= TimeDurationCount(transform->GetTimeStamp(), recentUpdateTime_) > 0;
 
 				LayeredMaskComponent* layeredmask = compfactory::GetLayeredMaskComponent(entity);
@@ -168,16 +286,48 @@ namespace vz
 
 				});
 		}
-		void RunRenderableUpdateSystem(jobsystem::context& ctx)
+		// World matrix update over the flattened hierarchy, one graph node per depth level chained after node_transforms
+		//	returns the node of the deepest level, so no worker blocks waiting for a level to finish
+		jobsystem::TaskGraph::NodeID RunHierarchyUpdateSystem(jobsystem::TaskGraph& graph, const jobsystem::TaskGraph::NodeID node_transforms)
 		{
-			parallelBounds.clear();
+			jobsystem::TaskGraph::NodeID node_level = node_transforms;
+			for (size_t level = 0; level + 1 < flatTransformLevels.size(); ++level)
+			{
+				const uint32_t level_begin = flatTransformLevels[level];
+				const uint32_t level_count = flatTransformLevels[level + 1] - level_begin;
+				const jobsystem::TaskGraph::NodeID node = graph.AddNode("Hierarchy", level_count, SMALL_SUBTASK_GROUPSIZE, [this, level_begin](jobsystem::JobArgs args) {
 
+					FlatTransform& flat = flatTransforms[level_begin + args.jobIndex];
+					if (flat.isExternalParent)
+					{
+						// the ancestors are outside of this scene, so climb them as before
+						flat.transform->UpdateWorldMatrix();
+						flat.world = flat.transform->GetWorldMatrix();
+						return;
+					}
+					XMMATRIX W = XMLoadFloat4x4(&flat.local);
+					if (flat.parent != ~0u)
+					{
+						W = W * XMLoadFloat4x4(&flatTransforms[flat.parent].world);
+					}
+					XMStoreFloat4x4(&flat.world, W);
+					flat.transform->SetWorldMatrix(flat.world);
+					});
+				graph.AddDependency(node_level, node);
+				node_level = node;
+			}
+			return node_level;
+		}
+		jobsystem::TaskGraph::NodeID RunRenderableUpdateSystem(jobsystem::TaskGraph& graph)
+		{
 			size_t num_renderables = renderables_.size();
+			parallelBounds.clear();
 			parallelBounds.resize((size_t)jobsystem::DispatchGroupCount((uint32_t)num_renderables, SMALL_SUBTASK_GROUPSIZE));
 
 			matrixRenderables.resize(num_renderables);
 			matrixRenderablesPrev.resize(num_renderables);
 			aabbRenderables.resize(num_renderables);
+			aabbRenderablesPicking.resize(num_renderables);
 
 			renderableComponents.resize(num_renderables);
 			renderableMeshComponents.resize(num_renderables);
@@ -194,7 +344,7 @@ namespace vz
 
 			instanceResLookupAllocator.store(0u);
 
-			jobsystem::Dispatch(ctx, (uint32_t)num_renderables, SMALL_SUBTASK_GROUPSIZE, [&](jobsystem::JobArgs args) {
+			return graph.AddNode("Renderables", (uint32_t)num_renderables, SMALL_SUBTASK_GROUPSIZE, [this](jobsystem::JobArgs args) {
 
 				auto updateSprite = [&](GRenderableComponent* renderable) {
 
@@ -247,8 +397,7 @@ namespace vz
 				Entity entity = renderables_[args.jobIndex];
 
 				TransformComponent* transform = compfactory::GetTransformComponent(entity);
-				assert(transform);
-				transform->UpdateWorldMatrix();
+				assert(transform); // the world matrix is updated by the hierarchy system
 
 				GRenderableComponent* renderable = (GRenderableComponent*)compfactory::GetRenderableComponent(entity);
 				assert(renderable);
@@ -270,6 +419,7 @@ namespace vz
 				{
 					renderable->Update();	// AABB
 				}
+				aabbRenderablesPicking[args.jobIndex] = renderable->GetAABB();
 
 				isContentChanged_ |= TimeDurationCount(renderable->GetTimeStamp(), recentUpdateTime_) > 0; // renderable->layeredmask is checked in Transform Updates
 
@@ -370,17 +520,16 @@ namespace vz
 
 				}, sizeof(geometrics::AABB));
 		}
-		void RunLightUpdateSystem(jobsystem::context& ctx)
+		jobsystem::TaskGraph::NodeID RunLightUpdateSystem(jobsystem::TaskGraph& graph)
 		{
 			uint32_t num_lights = (uint32_t)lights_.size();
 			aabbLights.resize(num_lights);
 			lightComponents.resize(num_lights);
-			jobsystem::Dispatch(ctx, num_lights, SMALL_SUBTASK_GROUPSIZE, [&](jobsystem::JobArgs args) {
+			return graph.AddNode("Lights", num_lights, SMALL_SUBTASK_GROUPSIZE, [this](jobsystem::JobArgs args) {
 
 				Entity entity = lights_[args.jobIndex];
 				TransformComponent* transform = compfactory::GetTransformComponent(entity);
-				assert(transform);
-				transform->UpdateWorldMatrix();
+				assert(transform); // the world matrix is updated by the hierarchy system
 
 				GLightComponent* light = (GLightComponent*)compfactory::GetLightComponent(entity);
 
@@ -405,17 +554,16 @@ namespace vz
 
 				});
 		}
-		void RunProbeUpdateSystem(jobsystem::context& ctx)
+		jobsystem::TaskGraph::NodeID RunProbeUpdateSystem(jobsystem::TaskGraph& graph)
 		{
 			uint32_t num_probes = (uint32_t)probes_.size();
 			aabbProbes.resize(num_probes);
 			probeComponents.resize(num_probes);
-			jobsystem::Dispatch(ctx, num_probes, SMALL_SUBTASK_GROUPSIZE, [&](jobsystem::JobArgs args) {
+			return graph.AddNode("Probes", num_probes, SMALL_SUBTASK_GROUPSIZE, [this](jobsystem::JobArgs args) {
 
 				Entity entity = probes_[args.jobIndex];
 				TransformComponent* transform = compfactory::GetTransformComponent(entity);
 				vzlog_assert(transform, "Probe cannot be used without transform component!");
-				transform->UpdateWorldMatrix();
 
 				GProbeComponent* probe = (GProbeComponent*)compfactory::GetProbeComponent(entity);
 				assert(probe);
@@ -453,12 +601,12 @@ namespace vz
 
 				});
 		}
-		void RunGeometryUpdateSystem(jobsystem::context& ctx)
+		jobsystem::TaskGraph::NodeID RunGeometryUpdateSystem(jobsystem::TaskGraph& graph)
 		{
 			uint32_t num_geometries = (uint32_t)geometries_.size();
 			geometryComponents.resize(num_geometries);
 			geometryAllocator.store(0u);
-			jobsystem::Dispatch(ctx, num_geometries, SMALL_SUBTASK_GROUPSIZE, [&](jobsystem::JobArgs args) {
+			return graph.AddNode("Geometries", num_geometries, SMALL_SUBTASK_GROUPSIZE, [this](jobsystem::JobArgs args) {
 
 				Entity entity = geometries_[args.jobIndex];
 				GGeometryComponent* geometry = (GGeometryComponent*)compfactory::GetGeometryComponent(entity);
@@ -472,12 +620,12 @@ namespace vz
 
 				});
 		}
-		void RunMaterialUpdateSystem(jobsystem::context& ctx)
+		jobsystem::TaskGraph::NodeID RunMaterialUpdateSystem(jobsystem::TaskGraph& graph)
 		{
 			uint32_t num_materials = (uint32_t)materials_.size();
 			materialComponents.resize(num_materials);
 
-			jobsystem::Dispatch(ctx, num_materials, SMALL_SUBTASK_GROUPSIZE, [&](jobsystem::JobArgs args) {
+			return graph.AddNode("Materials", num_materials, SMALL_SUBTASK_GROUPSIZE, [this](jobsystem::JobArgs args) {
 
 				Entity entity = materials_[args.jobIndex];
 
@@ -658,13 +806,28 @@ namespace vz
 
 			profiler::EndRange(range);
 		}
-		void RunAnimationUpdateSystem(jobsystem::context& ctx)
+		// Rebuilds the picking BVH when the renderable set changed, otherwise only refits it to the new bounds
+		void UpdateRenderableBVH()
 		{
-			auto range = profiler::BeginRangeCPU("Animations");
-
+			auto range = profiler::BeginRangeCPU("Renderable BVH");
+			const uint32_t num_renderables = (uint32_t)renderables_.size();
+			if (renderableBvhRevision != renderablesRevision)
+			{
+				renderableBvhRevision = renderablesRevision;
+				renderableBvh.BuildParallel(aabbRenderablesPicking.data(), num_renderables);
+			}
+			else
+			{
+				renderableBvh.Update(aabbRenderablesPicking.data(), num_renderables);
+			}
+			profiler::EndRange(range);
+		}
+		jobsystem::TaskGraph::NodeID RunAnimationUpdateSystem(jobsystem::TaskGraph& graph)
+		{
+			// the queue count is only known after the dependency scan
 			jobsystem::Wait(animationDependencyScanWorkload);
 			
-			jobsystem::Dispatch(ctx, (uint32_t)animationQueueCount, 1, [&](jobsystem::JobArgs args) {
+			return graph.AddNode("Animations", (uint32_t)animationQueueCount, 1, [this](jobsystem::JobArgs args) {
 
 				AnimationQueue& animation_queue = animationQueues[args.jobIndex];
 				for (size_t animation_index = 0; animation_index < animation_queue.animations.size(); ++animation_index)
@@ -674,10 +837,6 @@ namespace vz
 					animation.Update(dt_);
 				}
 				});
-
-			jobsystem::Wait(ctx);
-
-			profiler::EndRange(range);
 		}
 
 		void CountCPUandGPUColliders()
@@ -775,7 +934,11 @@ namespace vz
 				};
 
 			remove_entity(lookupTransforms_, transforms_, entity);
-			remove_entity(lookupRenderables, renderables_, entity);
+			if (lookupRenderables.count(entity) > 0)
+			{
+				remove_entity(lookupRenderables, renderables_, entity);
+				renderablesRevision++;
+			}
 			remove_entity(lookupLights, lights_, entity);
 			remove_entity(lookupCameras, cameras_, entity);
 			remove_entity(lookupAnimations, animations_, entity);
@@ -802,10 +965,10 @@ namespace vz
 				return;
 			}
 
-			std::unordered_set<Entity> geometry_set(num_renderables);
-			std::unordered_set<Entity> material_set;
+			allocator::frame_unordered_set<Entity> geometry_set(num_renderables);
+			allocator::frame_unordered_set<Entity> material_set;
 			material_set.reserve(num_renderables);
-			std::unordered_set<Entity> collider_set;
+			allocator::frame_unordered_set<Entity> collider_set;
 			collider_set.reserve(num_renderables);
 
 			// TODO: atomic set in parallel
@@ -869,6 +1032,8 @@ namespace vz
 
 			jobsystem::Execute(animationDependencyScanWorkload, [&](jobsystem::JobArgs args) {
 				auto range = profiler::BeginRangeCPU("Animation Dependencies");
+				// target entities of each queue, only needed during the scan:
+				allocator::frame_vector<allocator::frame_unordered_set<Entity>> queue_entities;
 				for (size_t i = 0; i < animations_.size(); ++i)
 				{
 					AnimationComponent& animationA = *compfactory::GetAnimationComponent(animations_[i]);
@@ -880,6 +1045,7 @@ namespace vz
 					for (size_t queue_index = 0; queue_index < animationQueueCount; ++queue_index)
 					{
 						AnimationQueue& queue = animationQueues[queue_index];
+						allocator::frame_unordered_set<Entity>& entities = queue_entities[queue_index];
 						for (auto& channelA : animationA.GetChannels())
 						{
 							NameComponent* name = compfactory::GetNameComponentByVUID(channelA.targetNameVUID);
@@ -888,9 +1054,9 @@ namespace vz
 							if (dependency)
 							{
 								// If dependency has been found, record all other entities in this animation too:
-								queue.entities.insert(target_ett);
+								entities.insert(target_ett);
 							}
-							else if (queue.entities.find(target_ett) != queue.entities.end())
+							else if (entities.find(target_ett) != entities.end())
 							{
 								// If two animations target the same entity, they have a dependency and need to be executed in order:
 								dependency = true;
@@ -909,12 +1075,12 @@ namespace vz
 						AnimationQueue& queue = animationQueues[animationQueueCount];
 						queue.animations.clear();
 						queue.animations.push_back(&animationA);
-						queue.entities.clear();
+						allocator::frame_unordered_set<Entity>& entities = queue_entities.emplace_back();
 						for (auto& channelA : animationA.GetChannels())
 						{
 							NameComponent* name = compfactory::GetNameComponentByVUID(channelA.targetNameVUID);
 							vzlog_assert(name, "Channel has invalid target!");
-							queue.entities.insert(name->GetEntity());
+							entities.insert(name->GetEntity());
 						}
 						animationQueueCount++;
 					}
@@ -962,16 +1128,69 @@ namespace vz
 
 			// 1. fully CPU-based operations
 
+			//	dependencies: animations -> transforms -> hierarchy -> renderables, lights, probes
+			//	              animations -> geometries, materials (these don't depend on world matrices)
+			updateGraph.Clear();
+			const jobsystem::TaskGraph::NodeID node_animations = RunAnimationUpdateSystem(updateGraph);
+			const jobsystem::TaskGraph::NodeID node_transforms = RunTransformUpdateSystem(updateGraph);
+			const jobsystem::TaskGraph::NodeID node_hierarchy = RunHierarchyUpdateSystem(updateGraph, node_transforms);
+			const jobsystem::TaskGraph::NodeID node_renderables = RunRenderableUpdateSystem(updateGraph);
+			const jobsystem::TaskGraph::NodeID node_lights = RunLightUpdateSystem(updateGraph);
+			const jobsystem::TaskGraph::NodeID node_probes = RunProbeUpdateSystem(updateGraph);
+			const jobsystem::TaskGraph::NodeID node_geometries = RunGeometryUpdateSystem(updateGraph);
+			const jobsystem::TaskGraph::NodeID node_materials = RunMaterialUpdateSystem(updateGraph);
+			updateGraph.AddDependency(node_animations, node_transforms);
+			updateGraph.AddDependency(node_hierarchy, node_renderables);
+			updateGraph.AddDependency(node_hierarchy, node_lights);
+			updateGraph.AddDependency(node_hierarchy, node_probes);
+			updateGraph.AddDependency(node_animations, node_geometries);
+			updateGraph.AddDependency(node_animations, node_materials);
+
+			const bool is_profiling = profiler::IsEnabled();
+			const bool is_tracing = profiler::IsTraceCapturing();
+			const uint64_t trace_run_begin = is_tracing ? profiler::TraceTimestamp() : 0;
+
 			jobsystem::context ctx;
-			RunAnimationUpdateSystem(ctx);
-			RunTransformUpdateSystem(ctx);
-			jobsystem::Wait(ctx); // dependencies
-			RunRenderableUpdateSystem(ctx);
-			RunLightUpdateSystem(ctx);
-			RunProbeUpdateSystem(ctx);
-			RunGeometryUpdateSystem(ctx);
-			RunMaterialUpdateSystem(ctx);
-			jobsystem::Wait(ctx); // dependencies
+			updateGraph.Run(ctx);
+			jobsystem::Wait(ctx);
+			const uint64_t trace_run_end = is_tracing ? profiler::TraceTimestamp() : 0;
+
+			UpdateRenderableBVH();
+
+			if (is_profiling || is_tracing)
+			{
+				// Report which systems gated this frame's update:
+				//	the hierarchy depth levels are consecutive nodes of the same name, they are merged into one entry
+				updateGraph.GetCriticalPath(criticalPath);
+				const float run_ms = criticalPath.empty() ? 0.f : criticalPath.back().end;
+				const double ticks_per_ms = run_ms > 0.f ? double(trace_run_end - trace_run_begin) / run_ms : 0.0;
+				for (size_t i = 0, n = criticalPath.size(); i < n;)
+				{
+					const char* name = criticalPath[i].name;
+					size_t level_count = 1;
+					while (i + level_count < n && strcmp(criticalPath[i + level_count].name, name) == 0)
+					{
+						level_count++;
+					}
+					const float begin = criticalPath[i].begin;
+					const float end = criticalPath[i + level_count - 1].end;
+					if (is_profiling)
+					{
+						if (level_count > 1)
+							snprintf(criticalPathLabel, sizeof(criticalPathLabel), "Scene Critical Path: %s (%zu levels)", name, level_count);
+						else
+							snprintf(criticalPathLabel, sizeof(criticalPathLabel), "Scene Critical Path: %s", name);
+						profiler::AddRangeCPU(criticalPathLabel, end - begin);
+					}
+					if (is_tracing)
+					{
+						// node names are string literals, so they outlive the capture
+						profiler::TraceEvent(name, profiler::TraceCategory::Range,
+							trace_run_begin + uint64_t(begin * ticks_per_ms), trace_run_begin + uint64_t(end * ticks_per_ms), (uint32_t)level_count);
+					}
+					i += level_count;
+				}
+			}
 
 			renderableMeshComponents.resize(counterRenderable_Mesh.load());
 			renderableVolumeComponents.resize(counterRenderable_Volume.load());
@@ -1076,6 +1295,7 @@ namespace vz
 	{
 		transforms_.clear();
 		renderables_.clear();
+		DOWNCAST->renderablesRevision++;
 		lights_.clear();
 		cameras_.clear();
 		animations_.clear();
@@ -1085,6 +1305,10 @@ namespace vz
 		geometries_.clear();
 
 		lookupTransforms_.clear();
+		DOWNCAST->flatTransforms.clear();
+		DOWNCAST->flatTransformLookup.clear();
+		DOWNCAST->flatTransformLevels.clear();
+		DOWNCAST->isFlatHierarchyDirty = true;
 
 		DOWNCAST->lookupRenderables.clear();
 		DOWNCAST->lookupMeshRenderables.clear();
@@ -1098,6 +1322,9 @@ namespace vz
 		DOWNCAST->lookupAnimations.clear();
 
 		DOWNCAST->aabbRenderables.clear();
+		DOWNCAST->aabbRenderablesPicking.clear();
+		DOWNCAST->renderableBvhRevision = ~0ull;
+		DOWNCAST->renderableBvh = geometrics::BVH();
 		DOWNCAST->aabbLights.clear();
 		DOWNCAST->parallelBounds.clear();
 
@@ -1188,6 +1415,7 @@ namespace vz
 			assert(lookupRenderables.count(entity) == 0);
 			lookupRenderables[entity] = renderables_.size();
 			renderables_.push_back(entity);
+			DOWNCAST->renderablesRevision++;
 		}
 		else if (compfactory::ContainLightComponent(entity))
 		{
@@ -1760,8 +1988,51 @@ namespace vz
 		using namespace geometrics;
 		if (filterMask & SCU32(RenderableFilterFlags::RENDERABLE_ALL))
 		{
+			// Candidate renderables come from the top-level BVH (the ray is tested against bounds grown by toleranceRadius),
+			//	all renderables are tested if the renderable set changed since the last scene update
 			const size_t renderable_count = renderables_.size();
-			for (size_t renderable_index = 0; renderable_index < renderable_count; ++renderable_index)
+			const BVH& renderable_bvh = DOWNCAST->renderableBvh;
+			static thread_local std::vector<uint32_t> candidates;
+			candidates.clear();
+			if (renderable_bvh.node_count > 0 && DOWNCAST->renderableBvhRevision == DOWNCAST->renderablesRevision)
+			{
+				static thread_local std::vector<uint32_t> stack;
+				stack.clear();
+				stack.push_back(0);
+				while (!stack.empty())
+				{
+					const BVH::Node& node = renderable_bvh.nodes[stack.back()];
+					stack.pop_back();
+					AABB aabb = node.aabb;
+					aabb._min.x -= toleranceRadius;
+					aabb._min.y -= toleranceRadius;
+					aabb._min.z -= toleranceRadius;
+					aabb._max.x += toleranceRadius;
+					aabb._max.y += toleranceRadius;
+					aabb._max.z += toleranceRadius;
+					if (!ray.intersects(aabb))
+						continue;
+					if (node.isLeaf())
+					{
+						candidates.insert(candidates.end(), renderable_bvh.leaf_indices + node.offset, renderable_bvh.leaf_indices + node.offset + node.count);
+					}
+					else
+					{
+						stack.push_back(node.left);
+						stack.push_back(node.left + 1);
+					}
+				}
+			}
+			else
+			{
+				candidates.resize(renderable_count);
+				for (uint32_t i = 0; i < (uint32_t)renderable_count; ++i)
+				{
+					candidates[i] = i;
+				}
+			}
+
+			for (const uint32_t renderable_index : candidates)
 			{
 				Entity entity = renderables_[renderable_index];
 				GRenderableComponent* renderable = (GRenderableComponent*)compfactory::GetRenderableComponent(entity);
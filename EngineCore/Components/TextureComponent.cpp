@@ -4,6 +4,9 @@
 #include "Utils/Backlog.h"
 #include "Utils/JobSystem.h"
 #include <thread>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
 
 //enum class DataType : uint8_t
 //{
@@ -241,14 +244,82 @@ namespace vz
 	}
 }
 
+// The voxels are split into chunks, each job counts into its own private bins and they are merged at the end.
+//	uint8/uint16 voxels are counted by value (a direct index, no float math per voxel),
+//	the value counts are mapped to the bins once after merging.
 template<typename T>
 void updateHistoValues(const uint8_t* data, const uint32_t w, const uint32_t h, const uint32_t d, vz::Histogram& histogram)
 {
+	using namespace vz;
+
 	const T* data_t = (const T*)data;
-	uint32_t num_voxels = w * h * d;
-	for (uint32_t i = 0; i < num_voxels; ++i)
+	const size_t num_voxels = (size_t)w * h * d;
+	if (num_voxels == 0)
+		return;
+
+	const size_t min_chunk_size = 1u << 20;
+	const size_t max_chunk_size = 1u << 30; // keeps the uint32_t value counts from overflowing
+	size_t num_chunks = std::min((size_t)jobsystem::GetThreadCount() * 2, (num_voxels + min_chunk_size - 1) / min_chunk_size);
+	num_chunks = std::max(num_chunks, (num_voxels + max_chunk_size - 1) / max_chunk_size);
+	num_chunks = std::max(num_chunks, (size_t)1);
+	const size_t chunk_size = (num_voxels + num_chunks - 1) / num_chunks;
+
+	jobsystem::context ctx;
+	if constexpr (std::is_integral_v<T> && sizeof(T) <= 2)
 	{
-		histogram.CountValue((float)data_t[i]);
+		constexpr size_t num_values = size_t(1) << (sizeof(T) * 8);
+		std::vector<uint32_t> chunk_counts(num_chunks * num_values, 0);
+		jobsystem::Dispatch(ctx, (uint32_t)num_chunks, 1, [&](jobsystem::JobArgs args) {
+			uint32_t* counts = chunk_counts.data() + args.jobIndex * num_values;
+			const size_t begin = args.jobIndex * chunk_size;
+			const size_t end = std::min(num_voxels, begin + chunk_size);
+			for (size_t i = begin; i < end; ++i)
+			{
+				counts[data_t[i]]++;
+			}
+			});
+		jobsystem::Wait(ctx);
+
+		for (size_t value = 0; value < num_values; ++value)
+		{
+			uint64_t count = 0;
+			for (size_t chunk = 0; chunk < num_chunks; ++chunk)
+			{
+				count += chunk_counts[chunk * num_values + value];
+			}
+			size_t index;
+			if (count > 0 && histogram.FindBin((float)value, index))
+			{
+				histogram.histogram[index] += count;
+			}
+		}
+	}
+	else
+	{
+		const size_t num_bins = histogram.histogram.size();
+		std::vector<uint64_t> chunk_bins(num_chunks * num_bins, 0);
+		jobsystem::Dispatch(ctx, (uint32_t)num_chunks, 1, [&](jobsystem::JobArgs args) {
+			uint64_t* bins = chunk_bins.data() + args.jobIndex * num_bins;
+			const size_t begin = args.jobIndex * chunk_size;
+			const size_t end = std::min(num_voxels, begin + chunk_size);
+			size_t index;
+			for (size_t i = begin; i < end; ++i)
+			{
+				if (histogram.FindBin((float)data_t[i], index))
+				{
+					bins[index]++;
+				}
+			}
+			});
+		jobsystem::Wait(ctx);
+
+		for (size_t chunk = 0; chunk < num_chunks; ++chunk)
+		{
+			for (size_t bin = 0; bin < num_bins; ++bin)
+			{
+				histogram.histogram[bin] += chunk_bins[chunk * num_bins + bin];
+			}
+		}
 	}
 }
 
@@ -395,6 +466,206 @@ namespace vz
 	}
 }
 
+// Min/max blocks:
+//	a block covers its own voxels plus a one-voxel halo towards every neighbouring block,
+//	because trilinear sampling near a block boundary mixes in the values of the neighbour.
+//	The reduction is separable: rows are merged over y with SIMD, the merged rows over x,
+//	and the slices over z, where the z-halo is merged from the boundary slices of the neighbouring slabs.
+template<typename T>
+struct VoxelMinMax
+{
+	T minV; // same layout as the R8G8/R16G16/R32G32 block texel
+	T maxV;
+};
+
+template<typename T>
+inline void initRowMinMax(T* rowMin, T* rowMax, const T* row, const uint32_t count)
+{
+	std::memcpy(rowMin, row, count * sizeof(T));
+	std::memcpy(rowMax, row, count * sizeof(T));
+}
+
+template<typename T>
+inline void mergeRowMinMax(T* rowMin, T* rowMax, const T* row, const uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		rowMin[i] = std::min(rowMin[i], row[i]);
+		rowMax[i] = std::max(rowMax[i], row[i]);
+	}
+}
+
+#if defined(_XM_SSE_INTRINSICS_)
+template<>
+inline void mergeRowMinMax<uint8_t>(uint8_t* rowMin, uint8_t* rowMax, const uint8_t* row, const uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+		_mm_storeu_si128((__m128i*)(rowMin + i), _mm_min_epu8(_mm_loadu_si128((const __m128i*)(rowMin + i)), v));
+		_mm_storeu_si128((__m128i*)(rowMax + i), _mm_max_epu8(_mm_loadu_si128((const __m128i*)(rowMax + i)), v));
+	}
+	for (; i < count; ++i)
+	{
+		rowMin[i] = std::min(rowMin[i], row[i]);
+		rowMax[i] = std::max(rowMax[i], row[i]);
+	}
+}
+template<>
+inline void mergeRowMinMax<uint16_t>(uint16_t* rowMin, uint16_t* rowMax, const uint16_t* row, const uint32_t count)
+{
+	// SSE2 has no unsigned 16-bit min/max: min(a, b) = a - sat(a - b), max(a, b) = b + sat(a - b)
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i mn = _mm_loadu_si128((const __m128i*)(rowMin + i));
+		__m128i mx = _mm_loadu_si128((const __m128i*)(rowMax + i));
+		mn = _mm_sub_epi16(mn, _mm_subs_epu16(mn, v));
+		mx = _mm_add_epi16(mx, _mm_subs_epu16(v, mx));
+		_mm_storeu_si128((__m128i*)(rowMin + i), mn);
+		_mm_storeu_si128((__m128i*)(rowMax + i), mx);
+	}
+	for (; i < count; ++i)
+	{
+		rowMin[i] = std::min(rowMin[i], row[i]);
+		rowMax[i] = std::max(rowMax[i], row[i]);
+	}
+}
+template<>
+inline void mergeRowMinMax<float>(float* rowMin, float* rowMax, const float* row, const uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(row + i);
+		_mm_storeu_ps(rowMin + i, _mm_min_ps(_mm_loadu_ps(rowMin + i), v));
+		_mm_storeu_ps(rowMax + i, _mm_max_ps(_mm_loadu_ps(rowMax + i), v));
+	}
+	for (; i < count; ++i)
+	{
+		rowMin[i] = std::min(rowMin[i], row[i]);
+		rowMax[i] = std::max(rowMax[i], row[i]);
+	}
+}
+#endif
+
+template<typename T>
+inline void mergeBlockMinMax(VoxelMinMax<T>* dst, const VoxelMinMax<T>* src, const uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		dst[i].minV = std::min(dst[i].minV, src[i].minV);
+		dst[i].maxV = std::max(dst[i].maxV, src[i].maxV);
+	}
+}
+
+// [begin, end) of the voxels that affect the block, including the halo
+inline void blockWindow(const uint32_t block, const uint32_t pitch, const uint32_t size, uint32_t& begin, uint32_t& end)
+{
+	begin = block * pitch;
+	end = std::min(size, begin + pitch + 1);
+	if (begin > 0)
+		begin--;
+}
+
+// min/max of a single z-slice for every (x, y) block, including the x and y halos
+template<typename T>
+void updateSliceMinMax(const T* slice, const uint32_t w, const uint32_t h, const XMUINT3& pitch, 
+	const uint32_t numBlocksX, const uint32_t numBlocksY, T* rowMin, T* rowMax, VoxelMinMax<T>* sliceBlocks)
+{
+	for (uint32_t by = 0; by < numBlocksY; ++by)
+	{
+		uint32_t y_begin, y_end;
+		blockWindow(by, pitch.y, h, y_begin, y_end);
+
+		initRowMinMax(rowMin, rowMax, slice + (size_t)y_begin * w, w);
+		for (uint32_t y = y_begin + 1; y < y_end; ++y)
+		{
+			mergeRowMinMax(rowMin, rowMax, slice + (size_t)y * w, w);
+		}
+
+		VoxelMinMax<T>* blocks_row = sliceBlocks + (size_t)by * numBlocksX;
+		for (uint32_t bx = 0; bx < numBlocksX; ++bx)
+		{
+			uint32_t x_begin, x_end;
+			blockWindow(bx, pitch.x, w, x_begin, x_end);
+
+			T min_v = rowMin[x_begin];
+			T max_v = rowMax[x_begin];
+			for (uint32_t x = x_begin + 1; x < x_end; ++x)
+			{
+				min_v = std::min(min_v, rowMin[x]);
+				max_v = std::max(max_v, rowMax[x]);
+			}
+			blocks_row[bx] = { min_v, max_v };
+		}
+	}
+}
+
+template<typename T>
+void updateVolumeMinMaxBlocks(const uint8_t* data, const uint32_t w, const uint32_t h, const uint32_t d, 
+	const XMUINT3& pitch, const XMUINT3& numBlocks, uint8_t* blockData)
+{
+	using namespace vz;
+
+	const T* vol_data = (const T*)data;
+	const uint32_t num_blocksXY = numBlocks.x * numBlocks.y;
+	const size_t vol_wh = (size_t)w * h;
+	VoxelMinMax<T>* blocks = (VoxelMinMax<T>*)blockData;
+
+	// The first and the last slice of each slab, they are the z-halo of the neighbouring slabs
+	std::vector<VoxelMinMax<T>> slab_first((size_t)numBlocks.z * num_blocksXY);
+	std::vector<VoxelMinMax<T>> slab_last((size_t)numBlocks.z * num_blocksXY);
+
+	// 1.) Each z-slab of blocks is a job:
+	jobsystem::context ctx;
+	jobsystem::Dispatch(ctx, numBlocks.z, 1, [&](jobsystem::JobArgs args) {
+		const uint32_t bz = args.jobIndex;
+		const uint32_t z_begin = bz * pitch.z;
+		const uint32_t z_end = std::min(d, z_begin + pitch.z);
+
+		std::vector<T> row_minmax((size_t)w * 2);
+		std::vector<VoxelMinMax<T>> slice_blocks(num_blocksXY);
+		VoxelMinMax<T>* slab_blocks = blocks + (size_t)bz * num_blocksXY;
+		for (uint32_t z = z_begin; z < z_end; ++z)
+		{
+			updateSliceMinMax<T>(vol_data + z * vol_wh, w, h, pitch, numBlocks.x, numBlocks.y,
+				row_minmax.data(), row_minmax.data() + w, slice_blocks.data());
+			if (z == z_begin)
+			{
+				std::copy(slice_blocks.begin(), slice_blocks.end(), slab_blocks);
+				std::copy(slice_blocks.begin(), slice_blocks.end(), slab_first.begin() + (size_t)bz * num_blocksXY);
+			}
+			else
+			{
+				mergeBlockMinMax(slab_blocks, slice_blocks.data(), num_blocksXY);
+			}
+			if (z == z_end - 1)
+			{
+				std::copy(slice_blocks.begin(), slice_blocks.end(), slab_last.begin() + (size_t)bz * num_blocksXY);
+			}
+		}
+		});
+	jobsystem::Wait(ctx);
+
+	// 2.) z-halo from the neighbouring slabs:
+	jobsystem::Dispatch(ctx, numBlocks.z, 1, [&](jobsystem::JobArgs args) {
+		const uint32_t bz = args.jobIndex;
+		VoxelMinMax<T>* slab_blocks = blocks + (size_t)bz * num_blocksXY;
+		if (bz > 0)
+		{
+			mergeBlockMinMax(slab_blocks, slab_last.data() + (size_t)(bz - 1) * num_blocksXY, num_blocksXY);
+		}
+		if (bz < numBlocks.z - 1)
+		{
+			mergeBlockMinMax(slab_blocks, slab_first.data() + (size_t)(bz + 1) * num_blocksXY, num_blocksXY);
+		}
+		});
+	jobsystem::Wait(ctx);
+}
+
 namespace vz
 {
 	using uint = uint32_t;
@@ -414,103 +685,28 @@ namespace vz
 
 		const uint8_t* vol_data = resource.GetFileData().data();
 
-		uint modX = width_ % blockPitch_.x;
-		uint modY = height_ % blockPitch_.y;
-		uint modZ = depth_ % blockPitch_.z;
-		uint num_blocksX = width_ / blockPitch_.x + (modX != 0);
-		uint num_blocksY = height_ / blockPitch_.y + (modY != 0);
-		uint num_blocksZ = depth_ / blockPitch_.z + (modZ != 0);
+		uint num_blocksX = (width_ + blockPitch_.x - 1) / blockPitch_.x;
+		uint num_blocksY = (height_ + blockPitch_.y - 1) / blockPitch_.y;
+		uint num_blocksZ = (depth_ + blockPitch_.z - 1) / blockPitch_.z;
 
 		blocksSize_ = XMUINT3(num_blocksX, num_blocksY, num_blocksZ);
 
-		uint xy = num_blocksX * num_blocksY;
-		
-		uint num_blocksXY = num_blocksX * num_blocksY;
-		uint num_blocksXYZ = num_blocksXY * num_blocksZ;
-		uint vol_wh = width_ * height_;
+		uint num_blocksXYZ = num_blocksX * num_blocksY * num_blocksZ;
 
 		// MinMax Block Setting
 		uint stride = graphics::GetFormatStride(static_cast<graphics::Format>(textureFormat_));
 
 		volumeMinMaxBlocksData_.resize(num_blocksXYZ * stride * 2); // here, 2 refers min and max
 		uint8_t* block_data = volumeMinMaxBlocksData_.data();
-		XMUINT3 blk_idx = XMUINT3(0, 0, 0);
-		for (uint z = 0; z < depth_; z += blockPitch_.z, blk_idx.z++)
+		switch (volFormat_)
 		{
-			blk_idx.y = 0;
-			for (uint y = 0; y < height_; y += blockPitch_.y, blk_idx.y++)
-			{
-				blk_idx.x = 0;
-				for (uint x = 0; x < width_; x += blockPitch_.x, blk_idx.x++)
-				{
-					float min_v = FLT_MAX;		// Min
-					float max_v = -FLT_MAX;		// Max
-
-					XMUINT3 boundary_size = blockPitch_;
-					if (width_ < x + blockPitch_.x)
-						boundary_size.x = modX;
-					if (height_ < y + blockPitch_.y)
-						boundary_size.y = modY;
-					if (depth_ < z + blockPitch_.z)
-						boundary_size.z = modZ;
-
-					// consider the trilinear sampling case: +1 and -1 for blk_idx
-					//	when trilinear sampling nearby a block boundary,
-					//	the sampled value within the block can be outside 
-					//		of the range of values within the block
-					XMINT3 start_index = XMINT3(0, 0, 0);
-					XMINT3 end_index = *(XMINT3*)&boundary_size;
-					if (blk_idx.x > 0)
-						start_index.x = -1;
-					if (blk_idx.y > 0)
-						start_index.y = -1;
-					if (blk_idx.z > 0)
-						start_index.z = -1;
-					if (blk_idx.x < num_blocksX - 1)
-						end_index.x += 1;
-					if (blk_idx.y < num_blocksY - 1)
-						end_index.y += 1;
-					if (blk_idx.z < num_blocksZ - 1)
-						end_index.z += 1;
-					for (int sub_z = start_index.z; sub_z < end_index.z; sub_z++)
-					{
-						for (int sub_y = start_index.y; sub_y < end_index.y; sub_y++)
-						{
-							for (int sub_x = start_index.x; sub_x < end_index.x; sub_x++)
-							{
-								float v = 0;
-								uint addr = (z + sub_z) * vol_wh + (y + sub_y) * width_ + x + sub_x;
-
-								switch (volFormat_)
-								{
-								case VolumeFormat::UINT8: v = (float)vol_data[addr]; break;
-								case VolumeFormat::UINT16: v = (float)((uint16_t*)vol_data)[addr]; break;
-								case VolumeFormat::FLOAT: v = ((float*)vol_data)[addr]; break;
-								default: assert(0);
-								}
-
-								if (v < min_v)
-									min_v = v;
-								if (v > max_v)
-									max_v = v;
-							}
-						}
-					}
-
-					uint block_addr = blk_idx.z * num_blocksXY + blk_idx.y * num_blocksX + blk_idx.x;
-
-					switch (volFormat_)
-					{
-					case VolumeFormat::UINT8: 
-						((uint16_t*)block_data)[block_addr] = (uint8_t)min_v | (((uint8_t)max_v) << 8); break;
-					case VolumeFormat::UINT16: 
-						((uint32_t*)block_data)[block_addr] = (uint16_t)min_v | (((uint16_t)max_v) << 16); break;
-					case VolumeFormat::FLOAT: 
-						((XMFLOAT2*)block_data)[block_addr] = XMFLOAT2(min_v, max_v); break;
-					default: assert(0);
-					}
-				}
-			}
+		case VolumeFormat::UINT8:
+			updateVolumeMinMaxBlocks<uint8_t>(vol_data, width_, height_, depth_, blockPitch_, blocksSize_, block_data); break;
+		case VolumeFormat::UINT16:
+			updateVolumeMinMaxBlocks<uint16_t>(vol_data, width_, height_, depth_, blockPitch_, blocksSize_, block_data); break;
+		case VolumeFormat::FLOAT:
+			updateVolumeMinMaxBlocks<float>(vol_data, width_, height_, depth_, blockPitch_, blocksSize_, block_data); break;
+		default: assert(0);
 		}
 
 		using namespace graphics;
@@ -231,6 +231,46 @@ namespace vzm
 		return detected;
 	}
 
+	bool VzActorStaticMesh::CollisionCheckBatch(const std::vector<ActorVID>& targetActorVIDs, const bool allContacts, std::vector<Contact>* contacts) const
+	{
+		GET_RENDERABLE_COMP(renderable, false);
+		std::vector<bvhcollision::CollisionObject> objects_src = { { renderable->GetGeometry(), componentVID_ } };
+		std::vector<bvhcollision::CollisionObject> objects_target;
+		std::vector<ActorVID> target_vids;
+		objects_target.reserve(targetActorVIDs.size());
+		target_vids.reserve(targetActorVIDs.size());
+		for (const ActorVID target_vid : targetActorVIDs)
+		{
+			RenderableComponent* renderable_target = compfactory::GetRenderableComponent(target_vid);
+			if (renderable_target == nullptr)
+			{
+				vzlog_error("Invalid Target Actor! (%llu)", target_vid);
+				continue;
+			}
+			objects_target.push_back({ renderable_target->GetGeometry(), target_vid });
+			target_vids.push_back(target_vid);
+		}
+
+		std::vector<bvhcollision::CollisionContact> batch_contacts;
+		bool detected = bvhcollision::CollisionBatchCheck(objects_src, objects_target,
+			allContacts ? bvhcollision::CollisionQuery::ALL_CONTACTS : bvhcollision::CollisionQuery::FIRST_HIT, batch_contacts);
+		if (contacts)
+		{
+			contacts->resize(batch_contacts.size());
+			for (size_t i = 0, n = batch_contacts.size(); i < n; ++i)
+			{
+				const bvhcollision::CollisionContact& batch_contact = batch_contacts[i];
+				Contact& contact = (*contacts)[i];
+				contact.targetActorVID = target_vids[batch_contact.objectIndex2];
+				contact.partIndexSrc = batch_contact.partIndex1;
+				contact.partIndexTarget = batch_contact.partIndex2;
+				contact.triIndexSrc = batch_contact.triIndex1;
+				contact.triIndexTarget = batch_contact.triIndex2;
+			}
+		}
+		return detected;
+	}
+
 	std::vector<MaterialVID> VzActorStaticMesh::GetMaterials() const
 	{
 		GET_RENDERABLE_COMP(renderable, std::vector<MaterialVID>());
@@ -25,6 +25,19 @@ namespace vzm
 		virtual bool ColliderCollisionCheck(const ActorVID targetActorVID) const = 0;
 		virtual bool CollisionCheck(const ActorVID targetActorVID,
 			int* partIndexSrc = nullptr, int* partIndexTarget = nullptr, int* triIndexSrc = nullptr, int* triIndexTarget = nullptr) const = 0;
+
+		struct Contact
+		{
+			ActorVID targetActorVID = INVALID_VID;
+			int partIndexSrc = -1;
+			int partIndexTarget = -1;
+			int triIndexSrc = -1; // -1 for a convex part
+			int triIndexTarget = -1; // -1 for a convex part
+		};
+		// Checks against all target actors at once (e.g., an implant against anatomy meshes), the targets are tested in parallel
+		//	allContacts == false : one contact per colliding target, allContacts == true : every intersecting triangle pair
+		//	targets whose BVH is not ready yet are skipped
+		virtual bool CollisionCheckBatch(const std::vector<ActorVID>& targetActorVIDs, const bool allContacts = false, std::vector<Contact>* contacts = nullptr) const = 0;
 	};
 	struct API_EXPORT VIzGI
 	{
@@ -109,6 +122,7 @@ namespace vzm
 		bool ColliderCollisionCheck(const ActorVID targetActorVID) const override;
 		bool CollisionCheck(const ActorVID targetActorVID, 
 			int* partIndexSrc = nullptr, int* partIndexTarget = nullptr, int* triIndexSrc = nullptr, int* triIndexTarget = nullptr) const override;
+		bool CollisionCheckBatch(const std::vector<ActorVID>& targetActorVIDs, const bool allContacts = false, std::vector<Contact>* contacts = nullptr) const override;
 
 		// ----- interfaces for VIzGI -----
 		void EnableShadowsCast(const bool enabled) override;
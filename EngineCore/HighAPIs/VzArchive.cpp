@@ -40,6 +40,15 @@ namespace vzm
 			transform->Serialize(*archive, 0);
 			camera->Serialize(*archive, 0);
 		} break;
+		case COMPONENT_TYPE::GEOMETRY:
+			// name, geometry (including the cached CPU BVH of its parts)
+		{
+			NameComponent* name = compfactory::GetNameComponent(entity);
+			GeometryComponent* geometry = compfactory::GetGeometryComponent(entity);
+			assert(name && geometry);
+			name->Serialize(*archive, 0);
+			geometry->Serialize(*archive, 0);
+		} break;
 
 		default:
 			assert(0 && "NOT YET SUPPORTED!");
@@ -94,14 +103,6 @@ namespace vzm
 	{
 		GET_ARCHIVE(archive, false);
 		archive->SetCompressionEnabled(true);
-
-		std::vector<uint8_t> data;
-		if (vz::helper::FileRead(fileName, data))
-		{
-			archive->ReadData(data.data(), data.size());
-			return true;
-		}
-
-		return false;
+		return archive->ReadFile(fileName);
 	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "Common/ResourceManager.h"
 #include "Utils/Config.h"
 #include "Utils/Backlog.h"
+#include "Utils/Allocator.h"
 #include "Utils/Platform.h"
 #include "Utils/EventHandler.h"
 #include "Utils/ECS.h"
@@ -179,17 +180,23 @@ namespace vzm
 		{
 			vzlog_warning("# of PendingSubmitCommand (%d) is over 50!\n\t\tForce to Submit Commandlist!!!\n\t\tReport your scenario to korfriend@gmail.com", n);
 
-			graphics::GraphicsDevice* device = graphics::GetDevice();
-			graphics::CommandList cmd = device->BeginCommandList();
-			profiler::EndFrame(&cmd); // cmd must be assigned before SubmitCommandLists
-			device->SubmitCommandLists();
-			vzm::ResetPendingSubmitCommand();
+			SubmitEngineFrame();
 		}
 	}
 	size_t GetCountPendingSubmitCommand()
 	{
 		return countPendingSubmitCommand.load();
 	}
+	// Ends an engine frame: every submit path goes through here, so the frame arenas advance exactly once per frame
+	void SubmitEngineFrame()
+	{
+		graphics::GraphicsDevice* device = graphics::GetDevice();
+		graphics::CommandList cmd = device->BeginCommandList();
+		profiler::EndFrame(&cmd); // cmd must be assigned before SubmitCommandLists
+		device->SubmitCommandLists();
+		vz::allocator::advance_frame(); // frame arena memory of two frames ago can be reused from now
+		ResetPendingSubmitCommand();
+	}
 
 	std::thread::id engineThreadId;
 	inline uint64_t threadToInteger(const std::thread::id& id) {
@@ -434,6 +441,14 @@ namespace vzm
 			{
 				section.Set("RENDERING_SKIP_STABLES", 30);
 			}
+			if (!section.Has("LOG_MODE"))
+			{
+				section.Set("LOG_MODE", "SYNC");
+			}
+			if (!section.Has("LOG_FLUSH_INTERVAL_MS"))
+			{
+				section.Set("LOG_FLUSH_INTERVAL_MS", 200);
+			}
 			configFile.Commit();
 		}
 
@@ -560,6 +575,12 @@ namespace vzm
 
 		skipStableCount = section.GetInt("RENDERING_SKIP_STABLES");
 
+		// ASYNC (opt-in): worker threads never wait for the log file, errors are still flushed right away
+		//	SYNC (default): every message is written and flushed by the posting thread
+		int logFlushInterval = section.GetInt("LOG_FLUSH_INTERVAL_MS");
+		backlog::setFlushPolicy(backlog::LogLevel::Error, logFlushInterval > 0 ? (uint32_t)logFlushInterval : 200u);
+		backlog::setAsyncMode(section.GetText("LOG_MODE") == "ASYNC");
+
 		// initialize the graphics backend
 		graphics::ValidationMode validationMode = graphics::ValidationMode::Disabled;
 		std::string validation = "DISABLED";
@@ -268,11 +268,7 @@ namespace vzm
 
 		if (!IsPendingSubmitCommand())
 		{
-			graphics::GraphicsDevice* device = graphics::GetDevice();
-			graphics::CommandList cmd = device->BeginCommandList();
-			profiler::EndFrame(&cmd); // cmd must be assigned before SubmitCommandLists
-			device->SubmitCommandLists();
-			vzm::ResetPendingSubmitCommand();
+			vzm::SubmitEngineFrame();
 		}
 		else
 		{
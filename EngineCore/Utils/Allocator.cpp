@@ -2,6 +2,9 @@
 
 #include <cassert>
 #include <atomic>
+#include <mutex>
+#include <new>
+#include <thread>
 
 namespace vz::allocator
 {
@@ -26,4 +29,264 @@ namespace vz::allocator
 	{
 		return block_allocators[id];
 	}
+
+	static std::atomic<uint64_t> frame_index{ 0 };
+	static std::atomic<size_t> frame_arena_cap{ 64ull * 1024ull * 1024ull };
+
+	// Every frame allocation is preceded by this header, so frame_deallocate() can tell arena memory
+	//	from heap fallback memory regardless of the thread that releases it
+	struct FrameAllocationHeader
+	{
+		static constexpr uint32_t HEAP_MAGIC = 0x48454150u; // 'HEAP'
+		uint32_t magic;		// HEAP_MAGIC for heap fallback allocations, 0 for arena allocations
+		uint32_t offset;	// heap fallback: distance from the start of the heap block to the user pointer
+	};
+	static_assert(sizeof(FrameAllocationHeader) == 8);
+
+	// Header space in front of an allocation, keeps the user pointer aligned:
+	static inline size_t frame_header_size(size_t alignment)
+	{
+		return std::max(alignment, sizeof(FrameAllocationHeader));
+	}
+
+	// Chunked bump allocator with two buffers, one for even and one for odd frames
+	struct FrameArena
+	{
+		static constexpr size_t chunk_alignment = 64;
+		static constexpr size_t initial_chunk_size = 256ull * 1024ull;
+
+		struct Chunk
+		{
+			uint8_t* mem = nullptr;
+			size_t size = 0;
+		};
+		struct Buffer
+		{
+			std::vector<Chunk> chunks;
+			size_t chunk = 0;	// index of the chunk being filled
+			size_t offset = 0;	// fill offset in the current chunk
+			size_t used = 0;	// bytes consumed in this frame, including padding and abandoned chunk tails
+			uint64_t frame = ~0ull;
+		};
+		Buffer buffers[2];
+
+		// Stats, written by the owning thread and read by get_frame_arena_stats():
+		std::atomic<uint64_t> thread_id{ 0 };
+		std::atomic<size_t> peak_bytes{ 0 };
+		std::atomic<size_t> last_frame_bytes{ 0 };
+		std::atomic<size_t> current_bytes{ 0 };
+		std::atomic<size_t> capacity{ 0 };
+		std::atomic<uint64_t> heap_allocations{ 0 };
+		std::atomic<uint64_t> overflow_allocations{ 0 };
+
+		Chunk allocate_chunk(size_t size)
+		{
+			Chunk chunk;
+			chunk.mem = (uint8_t*)::operator new[](size, std::align_val_t(chunk_alignment));
+			chunk.size = size;
+			capacity.fetch_add(size, std::memory_order_relaxed);
+			heap_allocations.fetch_add(1, std::memory_order_relaxed);
+			return chunk;
+		}
+		void free_chunk(Chunk& chunk)
+		{
+			::operator delete[](chunk.mem, std::align_val_t(chunk_alignment));
+			capacity.fetch_sub(chunk.size, std::memory_order_relaxed);
+			chunk = {};
+		}
+
+		// Retires the previous contents of the buffer (two frames old) and reuses it for the new frame
+		//	multiple chunks are merged into one so a steady state frame is served from a single chunk,
+		//	an oversized chunk is shrunk when a frame used less than a quarter of it
+		void begin_frame(Buffer& buffer, uint64_t frame)
+		{
+			const size_t used = buffer.used;
+			if (buffer.frame != ~0ull)
+			{
+				last_frame_bytes.store(used, std::memory_order_relaxed);
+				if (used > peak_bytes.load(std::memory_order_relaxed))
+				{
+					peak_bytes.store(used, std::memory_order_relaxed);
+				}
+			}
+
+			size_t total = 0;
+			for (auto& chunk : buffer.chunks)
+			{
+				total += chunk.size;
+			}
+			const bool merge = buffer.chunks.size() > 1;
+			const bool shrink = total > initial_chunk_size && used < total / 4;
+			if (merge || shrink)
+			{
+				for (auto& chunk : buffer.chunks)
+				{
+					free_chunk(chunk);
+				}
+				buffer.chunks.clear();
+				const size_t size = shrink ? std::max(initial_chunk_size, used * 2) : total;
+				buffer.chunks.push_back(allocate_chunk(size));
+			}
+
+			buffer.chunk = 0;
+			buffer.offset = 0;
+			buffer.used = 0;
+			buffer.frame = frame;
+			current_bytes.store(0, std::memory_order_relaxed);
+		}
+
+		void* allocate(Buffer& buffer, size_t size, size_t alignment)
+		{
+			assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+			while (buffer.chunk < buffer.chunks.size())
+			{
+				Chunk& chunk = buffer.chunks[buffer.chunk];
+				const uintptr_t base = (uintptr_t)chunk.mem;
+				const uintptr_t aligned = (base + buffer.offset + alignment - 1) & ~uintptr_t(alignment - 1);
+				const size_t end = size_t(aligned - base) + size;
+				if (end <= chunk.size)
+				{
+					buffer.used += end - buffer.offset;
+					buffer.offset = end;
+					current_bytes.store(buffer.used, std::memory_order_relaxed);
+					return (void*)aligned;
+				}
+				// the tail of this chunk is abandoned for this frame:
+				buffer.used += chunk.size - buffer.offset;
+				buffer.chunk++;
+				buffer.offset = 0;
+			}
+
+			// Out of space, grow geometrically:
+			size_t chunk_size = buffer.chunks.empty() ? initial_chunk_size : buffer.chunks.back().size * 2;
+			chunk_size = std::max(chunk_size, size + alignment);
+			buffer.chunks.push_back(allocate_chunk(chunk_size));
+			buffer.chunk = buffer.chunks.size() - 1;
+			buffer.offset = 0;
+			return allocate(buffer, size, alignment);
+		}
+	};
+
+	// Arenas are never destroyed, a thread returns its arena on exit and a new thread can reuse it
+	//	(allocations made by the exited thread stay valid until the end of the next frame)
+	struct FrameArenaRegistry
+	{
+		std::mutex locker;
+		std::vector<FrameArena*> arenas;
+		std::vector<FrameArena*> free_arenas;
+	};
+	static FrameArenaRegistry* frame_arena_registry = new FrameArenaRegistry; // only destroyed after program exit, never earlier
+
+	struct FrameArenaBinding
+	{
+		FrameArena* arena = nullptr;
+
+		inline FrameArena* get()
+		{
+			if (arena == nullptr)
+			{
+				std::scoped_lock lck(frame_arena_registry->locker);
+				if (frame_arena_registry->free_arenas.empty())
+				{
+					arena = new FrameArena;
+					frame_arena_registry->arenas.push_back(arena);
+				}
+				else
+				{
+					arena = frame_arena_registry->free_arenas.back();
+					frame_arena_registry->free_arenas.pop_back();
+				}
+				arena->thread_id.store(std::hash<std::thread::id>()(std::this_thread::get_id()), std::memory_order_relaxed);
+			}
+			return arena;
+		}
+		~FrameArenaBinding()
+		{
+			if (arena != nullptr)
+			{
+				arena->thread_id.store(0, std::memory_order_relaxed);
+				std::scoped_lock lck(frame_arena_registry->locker);
+				frame_arena_registry->free_arenas.push_back(arena);
+			}
+		}
+	};
+	static thread_local FrameArenaBinding frame_arena_binding;
+
+	void* frame_allocate(size_t size, size_t alignment)
+	{
+		FrameArena* arena = frame_arena_binding.get();
+		const uint64_t frame = frame_index.load(std::memory_order_acquire);
+		FrameArena::Buffer& buffer = arena->buffers[frame & 1];
+		if (buffer.frame != frame)
+		{
+			arena->begin_frame(buffer, frame);
+		}
+
+		const size_t header_size = frame_header_size(alignment);
+		if (buffer.used + size + header_size > frame_arena_cap.load(std::memory_order_relaxed))
+		{
+			// Over the high-water cap (e.g., a thread that allocates while no frame advances):
+			//	fall back to the heap, the block is freed by frame_deallocate() like a regular allocation
+			const size_t block_alignment = std::max(alignment, alignof(std::max_align_t));
+			const size_t block_header_size = frame_header_size(block_alignment);
+			uint8_t* block = (uint8_t*)::operator new[](size + block_header_size, std::align_val_t(block_alignment));
+			uint8_t* ptr = block + block_header_size;
+			FrameAllocationHeader* header = (FrameAllocationHeader*)ptr - 1;
+			header->magic = FrameAllocationHeader::HEAP_MAGIC;
+			header->offset = (uint32_t)block_header_size;
+			arena->overflow_allocations.fetch_add(1, std::memory_order_relaxed);
+			return ptr;
+		}
+
+		uint8_t* ptr = (uint8_t*)arena->allocate(buffer, size + header_size, alignment) + header_size;
+		FrameAllocationHeader* header = (FrameAllocationHeader*)ptr - 1;
+		header->magic = 0;
+		header->offset = 0;
+		return ptr;
+	}
+
+	void frame_deallocate(void* ptr, size_t alignment)
+	{
+		if (ptr == nullptr)
+			return;
+		const FrameAllocationHeader* header = (const FrameAllocationHeader*)ptr - 1;
+		if (header->magic != FrameAllocationHeader::HEAP_MAGIC)
+			return; // arena memory is released when the frame is recycled
+		const size_t block_alignment = std::max(alignment, alignof(std::max_align_t));
+		::operator delete[]((uint8_t*)ptr - header->offset, std::align_val_t(block_alignment));
+	}
+
+	void advance_frame()
+	{
+		frame_index.fetch_add(1, std::memory_order_acq_rel);
+	}
+
+	void set_frame_arena_cap(size_t bytes)
+	{
+		frame_arena_cap.store(bytes, std::memory_order_relaxed);
+	}
+
+	uint64_t get_frame_index()
+	{
+		return frame_index.load(std::memory_order_acquire);
+	}
+
+	void get_frame_arena_stats(std::vector<FrameArenaStats>& stats)
+	{
+		stats.clear();
+		std::scoped_lock lck(frame_arena_registry->locker);
+		stats.reserve(frame_arena_registry->arenas.size());
+		for (FrameArena* arena : frame_arena_registry->arenas)
+		{
+			FrameArenaStats& stat = stats.emplace_back();
+			stat.thread_id = arena->thread_id.load(std::memory_order_relaxed);
+			stat.peak_bytes = arena->peak_bytes.load(std::memory_order_relaxed);
+			stat.last_frame_bytes = arena->last_frame_bytes.load(std::memory_order_relaxed);
+			stat.current_bytes = arena->current_bytes.load(std::memory_order_relaxed);
+			stat.capacity = arena->capacity.load(std::memory_order_relaxed);
+			stat.heap_allocations = arena->heap_allocations.load(std::memory_order_relaxed);
+			stat.overflow_allocations = arena->overflow_allocations.load(std::memory_order_relaxed);
+			stat.peak_bytes = std::max(stat.peak_bytes, stat.current_bytes);
+		}
+	}
 }
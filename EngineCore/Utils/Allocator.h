@@ -6,8 +6,11 @@
 #include <atomic>
 #include <memory>
 #include <cassert>
+#include <cstddef>
 #include <algorithm>
 #include <vector>
+#include <unordered_set>
+#include <unordered_map>
 
 #ifndef UTIL_EXPORT
 #ifdef _WIN32
@@ -65,9 +68,22 @@ namespace vz::allocator
 	};
 
 
+	// Per-thread cache of free elements for one pooled allocator ("magazine")
+	//	the owning thread allocates and reclaims without locking,
+	//	whole batches are exchanged with the allocator's global free list when it runs empty or full
+	struct ThreadMagazine
+	{
+		static constexpr uint32_t capacity = 64;
+		static constexpr uint32_t batch = capacity / 2;
+		uint32_t count = 0;
+		void* items[capacity];
+	};
+
 	// Interface for allocating pooled shared_ptr
 	struct SharedBlockAllocator
 	{
+		// Returns every cached element of a magazine to the global free list (called on thread exit)
+		virtual void flush_magazine(ThreadMagazine&) {}
 		virtual void init_refcount(void* ptr) = 0;
 		virtual uint32_t get_refcount(void* ptr) = 0;
 		virtual uint32_t inc_refcount(void* ptr) = 0;
@@ -84,6 +100,35 @@ namespace vz::allocator
 	UTIL_EXPORT uint8_t get_shared_block_allocator_count();
 	UTIL_EXPORT SharedBlockAllocator* get_shared_block_allocator(uint8_t id);
 
+	// Magazines of the calling thread, indexed by allocator_id, created on first use
+	//	this is instantiated per module, but an allocator is only ever accessed through the code of its own module
+	struct ThreadMagazines
+	{
+		ThreadMagazine* magazines[256] = {};
+
+		~ThreadMagazines()
+		{
+			for (size_t i = 0; i < arraysize(magazines); ++i)
+			{
+				if (magazines[i] != nullptr)
+				{
+					get_shared_block_allocator(uint8_t(i))->flush_magazine(*magazines[i]);
+					delete magazines[i];
+				}
+			}
+		}
+	};
+	inline ThreadMagazine& get_thread_magazine(uint8_t allocator_id)
+	{
+		static thread_local ThreadMagazines thread_magazines;
+		ThreadMagazine*& magazine = thread_magazines.magazines[allocator_id];
+		if (magazine == nullptr)
+		{
+			magazine = new ThreadMagazine;
+		}
+		return *magazine;
+	}
+
 	// Shared ptr using a block allocation strategy, refcounted, thread-safe
 	//	handle encoding: upper 56 bits = pointer, lower 8 bits = allocator_id
 	//	Requires allocated memory to be 256-byte aligned (lower 8 bits of pointer must be 0)
@@ -240,27 +285,40 @@ namespace vz::allocator
 		std::vector<RawStruct*> free_list;
 		vz::SpinLock locker;
 
-		template<typename... ARG>
-		inline shared_ptr<T> allocate(ARG&&... args)
+		// Moves a batch from the global free list into the thread's empty magazine, growing the pool if needed
+		void refill_magazine(ThreadMagazine& magazine)
 		{
-			locker.lock();
-			if (free_list.empty())
+			std::scoped_lock lck(locker);
+			while (free_list.size() < ThreadMagazine::batch)
 			{
 				Block& block = blocks.emplace_back();
 				block.mem.reset(new RawStruct[block_size]);
 				RawStruct* ptr = block.mem.get();
-				free_list.reserve(block_size);
+				free_list.reserve(free_list.size() + block_size);
 				for (size_t i = 0; i < block_size; ++i)
 				{
 					free_list.push_back(ptr + i);
 				}
 			}
-			RawStruct* ptr = free_list.back();
+			for (uint32_t i = 0; i < ThreadMagazine::batch; ++i)
+			{
+				magazine.items[magazine.count++] = free_list.back();
+				free_list.pop_back();
+			}
+		}
+
+		template<typename... ARG>
+		inline shared_ptr<T> allocate(ARG&&... args)
+		{
+			ThreadMagazine& magazine = get_thread_magazine(allocator_id);
+			if (magazine.count == 0)
+			{
+				refill_magazine(magazine);
+			}
+			RawStruct* ptr = (RawStruct*)magazine.items[--magazine.count];
 			assert((uint64_t)ptr == ((uint64_t)ptr & (~0ull << 8ull))); // lower 8 bits must be 0 for handle encoding
-			free_list.pop_back();
-			locker.unlock();
 
-			// Construction can be outside of lock, this structure wasn't shared yet:
+			// Construction doesn't need a lock, this structure wasn't shared yet:
 			new (ptr) T(std::forward<ARG>(args)...);
 			init_refcount(ptr);
 			shared_ptr<T> allocation;
@@ -269,9 +327,24 @@ namespace vz::allocator
 		}
 
 		void reclaim(void* ptr)
+		{
+			ThreadMagazine& magazine = get_thread_magazine(allocator_id);
+			if (magazine.count == ThreadMagazine::capacity)
+			{
+				// Full, hand the older half back to the global free list:
+				std::scoped_lock lck(locker);
+				free_list.insert(free_list.end(), (RawStruct**)magazine.items, (RawStruct**)magazine.items + ThreadMagazine::batch);
+				magazine.count -= ThreadMagazine::batch;
+				std::copy(magazine.items + ThreadMagazine::batch, magazine.items + ThreadMagazine::capacity, magazine.items);
+			}
+			magazine.items[magazine.count++] = ptr;
+		}
+
+		void flush_magazine(ThreadMagazine& magazine) override
 		{
 			std::scoped_lock lck(locker);
-			free_list.push_back((RawStruct*)ptr);
+			free_list.insert(free_list.end(), (RawStruct**)magazine.items, (RawStruct**)magazine.items + magazine.count);
+			magazine.count = 0;
 		}
 
 		void init_refcount(void* ptr) override
@@ -433,4 +506,75 @@ namespace vz::allocator
 		return shared_heap_allocator->allocate(std::forward<ARG>(args)...);
 	}
 
+	// Per-thread linear "frame arena" for transient data that only lives for a frame
+	//	allocation is a pointer bump in the calling thread's arena, there is no individual free
+	//	memory remains valid until the end of the next frame (each arena rotates two buffers by frame index)
+	//	a buffer is reset lazily on the thread's first allocation in a new frame, idle threads cost nothing
+	//	once a thread used more than the high-water cap in one frame, further allocations fall back to the heap
+	//	and are freed by frame_deallocate(), so threads that never see a frame advance do not grow without limit
+	//	alignment must be a power of two
+	//
+	//	Users: the per-update temporaries of Scene::Update (transform hierarchy flattening, resource scan sets,
+	//	animation queue entity sets) and the per-call camera constants of GRenderPath3DDetails::BindCameraCB.
+	//	Not for containers that persist across frames and are cleared and reused (Visibility lists, scene bounds,
+	//	render queue sort scratch), they stop allocating after warm-up and must not point to recycled memory,
+	//	nor for mesh processing (e.g., Primitive::ComputeNormals) that runs on loader threads outside of any frame.
+	UTIL_EXPORT void* frame_allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	// Releases heap fallback memory, a no-op for arena memory (which is recycled with its frame)
+	UTIL_EXPORT void frame_deallocate(void* ptr, size_t alignment = alignof(std::max_align_t));
+	// Ends the current frame for all frame arenas
+	//	the engine calls this once per submitted frame (vzm::SubmitEngineFrame), applications that update scenes
+	//	without rendering (headless) call it once per update tick instead
+	UTIL_EXPORT void advance_frame();
+	UTIL_EXPORT uint64_t get_frame_index();
+	// Per-thread, per-frame high-water cap of the arena (64 MB by default)
+	UTIL_EXPORT void set_frame_arena_cap(size_t bytes);
+
+	struct FrameArenaStats
+	{
+		uint64_t thread_id = 0;			// hash of the std::thread::id that owns the arena, 0 if the arena is currently unbound
+		size_t peak_bytes = 0;			// highest usage of a single frame since the arena was created, use this to size the arenas
+		size_t last_frame_bytes = 0;	// usage of the most recently retired frame
+		size_t current_bytes = 0;		// usage of the frame in progress
+		size_t capacity = 0;			// bytes reserved from the heap by both buffers
+		uint64_t heap_allocations = 0;	// chunk allocations so far, should stop growing after warm-up
+		uint64_t overflow_allocations = 0;	// allocations served by the heap fallback because the cap was reached
+	};
+	UTIL_EXPORT void get_frame_arena_stats(std::vector<FrameArenaStats>& stats);
+
+	// STL allocator adapter over the frame arena
+	//	deallocate is a no-op for arena memory, containers must not outlive the next frame
+	//	a container can be filled from any thread, every thread allocates from its own arena
+	template<typename T>
+	struct FrameAllocator
+	{
+		using value_type = T;
+		using is_always_equal = std::true_type;
+
+		FrameAllocator() noexcept = default;
+		template<typename U>
+		FrameAllocator(const FrameAllocator<U>&) noexcept {}
+
+		inline T* allocate(size_t n)
+		{
+			return static_cast<T*>(frame_allocate(n * sizeof(T), alignof(T)));
+		}
+		inline void deallocate(T* p, size_t) noexcept
+		{
+			frame_deallocate(p, alignof(T));
+		}
+
+		template<typename U>
+		bool operator==(const FrameAllocator<U>&) const noexcept { return true; }
+		template<typename U>
+		bool operator!=(const FrameAllocator<U>&) const noexcept { return false; }
+	};
+
+	template<typename T>
+	using frame_vector = std::vector<T, FrameAllocator<T>>;
+	template<typename K, typename H = std::hash<K>, typename E = std::equal_to<K>>
+	using frame_unordered_set = std::unordered_set<K, H, E, FrameAllocator<K>>;
+	template<typename K, typename V, typename H = std::hash<K>, typename E = std::equal_to<K>>
+	using frame_unordered_map = std::unordered_map<K, V, H, E, FrameAllocator<std::pair<const K, V>>>;
+
 }
@@ -7,6 +7,13 @@
 #include "ThirdParty/spdlog/sinks/stdout_color_sinks.h"
 
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef PLATFORM_WINDOWS_DESKTOP
 #include <shlobj.h>
@@ -30,10 +37,205 @@ namespace vz::backlog
 {
 	std::shared_ptr<spdlog::logger> apiLogger = spdlog::default_logger();
 
-	LogLevel logLevel = LogLevel::Trace;
+	std::atomic<LogLevel> logLevel{ LogLevel::Trace };
 	bool isInitialized = false;
+	std::once_flag initializeOnce;
 	std::string logPath;
 
+	std::atomic<bool> isAsync{ false };
+	std::atomic<LogLevel> flushLevel{ LogLevel::Error };
+	std::atomic<uint32_t> flushIntervalMs{ 200 };
+	std::atomic<uint64_t> droppedCount{ 0 };
+
+	// Async backend:
+	//	bounded MPSC ring, every slot carries a sequence number (Vyukov's bounded queue)
+	//	 - slot.sequence == pos				: free for the producer claiming pos
+	//	 - slot.sequence == pos + 1			: published, readable by the writer
+	//	 - slot.sequence == pos + RING_SIZE	: consumed, free for the next lap
+	//	producers claim positions with a CAS on enqueuePos, the single writer thread owns dequeuePos
+	struct AsyncLog
+	{
+		static constexpr uint64_t RING_SIZE = 8192; // power of two
+		static constexpr uint64_t RING_MASK = RING_SIZE - 1;
+
+		struct Slot
+		{
+			std::atomic<uint64_t> sequence{ 0 };
+			LogLevel level = LogLevel::Info;
+			spdlog::log_clock::time_point time;
+			std::string text; // keeps its capacity across laps, no allocation once warmed up
+		};
+
+		std::vector<Slot> slots;
+		alignas(64) std::atomic<uint64_t> enqueuePos{ 0 };
+		alignas(64) uint64_t dequeuePos = 0;
+		std::atomic<uint64_t> consumedPos{ 0 }; // dequeuePos published for flush()
+
+		std::thread writer;
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<bool> wakeRequested{ false };
+		std::atomic<bool> running{ false };
+		std::mutex controlMutex; // start / stop / flush
+
+		AsyncLog() : slots(RING_SIZE)
+		{
+			for (uint64_t i = 0; i < RING_SIZE; ++i)
+			{
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+		~AsyncLog()
+		{
+			Stop();
+		}
+
+		bool TryEnqueue(const char* text, const size_t length, const LogLevel level)
+		{
+			uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+			Slot* slot = nullptr;
+			for (;;)
+			{
+				slot = &slots[pos & RING_MASK];
+				const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+				const int64_t diff = (int64_t)sequence - (int64_t)pos;
+				if (diff == 0)
+				{
+					if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return false; // full, the writer has not consumed this slot of the previous lap
+				}
+				else
+				{
+					pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+			slot->level = level;
+			slot->time = spdlog::log_clock::now();
+			slot->text.assign(text, length);
+			slot->sequence.store(pos + 1, std::memory_order_release);
+
+			// batches are written when the writer wakes up, only urgent messages
+			//	and a filling queue (every half ring) wake it early
+			if (level >= flushLevel.load(std::memory_order_relaxed) || ((pos + 1) & (RING_SIZE / 2 - 1)) == 0)
+			{
+				Wake();
+			}
+			return true;
+		}
+
+		void Wake()
+		{
+			if (!wakeRequested.exchange(true))
+			{
+				{
+					// pairs with the predicate check in the writer, so the notify can't slip in before its wait
+					std::lock_guard<std::mutex> lock(wakeMutex);
+				}
+				wakeCondition.notify_one();
+			}
+		}
+
+		// Writer side: writes every published message, returns the number of messages written
+		size_t Drain()
+		{
+			size_t count = 0;
+			for (;;)
+			{
+				Slot& slot = slots[dequeuePos & RING_MASK];
+				if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1)
+					break;
+				apiLogger->log(slot.time, spdlog::source_loc{}, (spdlog::level::level_enum)slot.level,
+					spdlog::string_view_t(slot.text.data(), slot.text.size()));
+				slot.sequence.store(dequeuePos + RING_SIZE, std::memory_order_release);
+				dequeuePos++;
+				count++;
+			}
+			consumedPos.store(dequeuePos, std::memory_order_release);
+			return count;
+		}
+
+		void WriterLoop()
+		{
+			uint64_t reported_dropped = droppedCount.load();
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(wakeMutex);
+					wakeCondition.wait_for(lock, std::chrono::milliseconds(flushIntervalMs.load()), [this] {
+						return wakeRequested.load() || !running.load();
+						});
+					wakeRequested.store(false);
+				}
+				const bool stopping = !running.load();
+
+				size_t written = Drain();
+				const uint64_t dropped = droppedCount.load();
+				if (dropped != reported_dropped)
+				{
+					std::string message = "Log queue overflow: " + std::to_string(dropped - reported_dropped) + " messages dropped";
+					apiLogger->log(spdlog::level::warn, spdlog::string_view_t(message.data(), message.size()));
+					reported_dropped = dropped;
+					written++;
+				}
+				if (written > 0)
+				{
+					apiLogger->flush();
+				}
+				if (stopping)
+					break;
+			}
+		}
+
+		void Start()
+		{
+			std::lock_guard<std::mutex> lock(controlMutex);
+			if (running.load())
+				return;
+			running.store(true);
+			writer = std::thread([this] { WriterLoop(); });
+		}
+
+		void Stop()
+		{
+			std::lock_guard<std::mutex> lock(controlMutex);
+			if (!running.load())
+				return;
+			running.store(false);
+			wakeRequested.store(false);
+			Wake();
+			if (writer.joinable())
+			{
+				writer.join();
+			}
+			// late posts that raced with the mode switch
+			if (Drain() > 0)
+			{
+				apiLogger->flush();
+			}
+		}
+
+		void Flush()
+		{
+			std::lock_guard<std::mutex> lock(controlMutex);
+			if (running.load())
+			{
+				// the writer is the only consumer, wait until it went past everything claimed so far
+				const uint64_t target = enqueuePos.load();
+				while (consumedPos.load(std::memory_order_acquire) < target)
+				{
+					Wake();
+					std::this_thread::yield();
+				}
+			}
+			apiLogger->flush();
+		}
+	};
+	AsyncLog asyncLog;
+
 	const char* GetLogPath() 
 	{
 		return logPath.c_str();
@@ -87,10 +289,10 @@ namespace vz::backlog
 			}
 
 			logPath += "\\";
-#else
-			logPath += "/";
-#endif
 		}
+#else
+		logPath += "/";
+#endif // PLATFORM_WINDOWS_DESKTOP
 
 		std::string log_file_path = logPath + "vzEngine.log";
 
@@ -100,7 +302,7 @@ namespace vz::backlog
 		auto console_sink = std::make_shared <spdlog::sinks::stdout_color_sink_mt>();
 		//apiLogger->sinks().push_back(consoleSink);
 		apiLogger->sinks().push_back(file_sink);
-		apiLogger->flush_on(spdlog::level::trace);
+		apiLogger->flush_on(isAsync.load() ? (spdlog::level::level_enum)flushLevel.load() : spdlog::level::trace);
 
 		apiLogger->set_pattern("[%Y-%m-%d %H:%M:%S.%e] [%^%l%$] %v");
 		apiLogger->info("Log Initialized with Path : " + log_file_path);
@@ -110,6 +312,9 @@ namespace vz::backlog
 	
 	void Destroy()
 	{
+		// later posts must not go to a ring that nobody drains
+		isAsync.store(false);
+		asyncLog.Stop();
 		apiLogger.reset();
 	}
 
@@ -118,37 +323,92 @@ namespace vz::backlog
 		intialize();
 	}
 
-	std::mutex mutex;
 	void postThreadSafe(const std::string& input, LogLevel level)
 	{
-		std::lock_guard<std::mutex> lock(mutex);
 		post(input, level);
 	}
 
-	void post(const std::string& input, LogLevel level)
+	static void postText(const char* text, const size_t length, const LogLevel level)
 	{
+		if (level >= LogLevel::None || level < logLevel.load(std::memory_order_relaxed))
+			return;
 		if (!isInitialized)
 		{
-			intialize();
-		}
-		switch (level)
-		{
-		case LogLevel::Trace:
-			apiLogger->trace(input); break;
-		case LogLevel::Debug:
-			apiLogger->debug(input); break;
-		case LogLevel::Info:
-			apiLogger->info(input); break;
-		case LogLevel::Warn:
-			apiLogger->warn(input); break;
-		case LogLevel::Error:
-			apiLogger->error(input); break;
-		case LogLevel::Critical:
-			apiLogger->critical(input); break;
-		case LogLevel::None:
-		default:
+			std::call_once(initializeOnce, [] { if (!isInitialized) intialize(); });
+		}
+
+		if (isAsync.load(std::memory_order_relaxed))
+		{
+			if (asyncLog.TryEnqueue(text, length, level))
+				return;
+			if (level < LogLevel::Error)
+			{
+				droppedCount.fetch_add(1, std::memory_order_relaxed);
 				return;
+			}
+			// errors are never dropped, wait for the writer to make room
+			while (isAsync.load(std::memory_order_relaxed))
+			{
+				asyncLog.Wake();
+				std::this_thread::yield();
+				if (asyncLog.TryEnqueue(text, length, level))
+					return;
+			}
+		}
+		if (apiLogger)
+		{
+			apiLogger->log(spdlog::source_loc{}, (spdlog::level::level_enum)level, spdlog::string_view_t(text, length));
+		}
+	}
+
+	void post(const std::string& input, LogLevel level)
+	{
+		postText(input.data(), input.size(), level);
+	}
+
+	// Formats into a thread local buffer, returns the length or -1 on a format error
+	static int formatText(const char*& text, const char* format, va_list args)
+	{
+		thread_local std::vector<char> buffer(1024);
+		va_list args_retry;
+		va_copy(args_retry, args);
+		int length = vsnprintf(buffer.data(), buffer.size(), format, args);
+		if (length >= 0 && (size_t)length >= buffer.size())
+		{
+			buffer.resize((size_t)length + 1);
+			length = vsnprintf(buffer.data(), buffer.size(), format, args_retry);
 		}
+		va_end(args_retry);
+		text = buffer.data();
+		return length;
+	}
+
+	void postf(LogLevel level, const char* format, ...)
+	{
+		if (level >= LogLevel::None || level < logLevel.load(std::memory_order_relaxed))
+			return;
+
+		const char* text = nullptr;
+		va_list args;
+		va_start(args, format);
+		int length = formatText(text, format, args);
+		va_end(args);
+		if (length < 0)
+			return;
+		postText(text, (size_t)length, level);
+	}
+
+	const char* postfText(LogLevel level, const char* format, ...)
+	{
+		const char* text = nullptr;
+		va_list args;
+		va_start(args, format);
+		int length = formatText(text, format, args);
+		va_end(args);
+		if (length < 0)
+			return "";
+		postText(text, (size_t)length, level);
+		return text;
 	}
 
 	void setLogLevel(LogLevel newLevel)
@@ -161,4 +421,56 @@ namespace vz::backlog
 	{
 		return logLevel;
 	}
-}
\ No newline at end of file
+
+	void setAsyncMode(bool enabled)
+	{
+		if (!isInitialized)
+		{
+			std::call_once(initializeOnce, [] { if (!isInitialized) intialize(); });
+		}
+		if (enabled)
+		{
+			asyncLog.Start();
+			isAsync.store(true);
+			apiLogger->flush_on((spdlog::level::level_enum)flushLevel.load());
+		}
+		else
+		{
+			isAsync.store(false);
+			asyncLog.Stop();
+			apiLogger->flush_on(spdlog::level::trace);
+		}
+	}
+
+	bool isAsyncMode()
+	{
+		return isAsync.load();
+	}
+
+	void setFlushPolicy(LogLevel level, uint32_t intervalMs)
+	{
+		flushLevel.store(level);
+		flushIntervalMs.store(std::max(intervalMs, 1u));
+		if (isAsync.load() && apiLogger)
+		{
+			apiLogger->flush_on((spdlog::level::level_enum)level);
+		}
+	}
+
+	uint64_t getDroppedCount()
+	{
+		return droppedCount.load();
+	}
+
+	void flush()
+	{
+		if (isAsync.load())
+		{
+			asyncLog.Flush();
+		}
+		else if (apiLogger)
+		{
+			apiLogger->flush();
+		}
+	}
+}
@@ -10,8 +10,8 @@
 #endif
 #endif
 
-#define vzlog_level(str,level,...) {char text[1024]; snprintf(text, sizeof(text), str, ## __VA_ARGS__); vz::backlog::post(text, level);}
-#define vzlog_messagebox(str,...) {char text[1024]; snprintf(text, sizeof(text), str, ## __VA_ARGS__); vz::backlog::post(text, vz::backlog::LogLevel::Error); vz::helper::messageBox(text, "Error!");}
+#define vzlog_level(str,level,...) {vz::backlog::postf(level, str, ## __VA_ARGS__);}
+#define vzlog_messagebox(str,...) {const char* text = vz::backlog::postfText(vz::backlog::LogLevel::Error, str, ## __VA_ARGS__); vz::helper::messageBox(text, "Error!");}
 #define vzlog_warning(str,...) {vzlog_level(str, vz::backlog::LogLevel::Warn, ## __VA_ARGS__);}
 #define vzlog_error(str,...) {vzlog_level(str, vz::backlog::LogLevel::Error, ## __VA_ARGS__);}
 #define vzlog(str,...) {vzlog_level(str, vz::backlog::LogLevel::Info, ## __VA_ARGS__);}
@@ -34,13 +34,37 @@ namespace vz::backlog
 
 	extern "C" UTIL_EXPORT void post(const std::string& input, LogLevel level = LogLevel::Info);
 
+	// post is thread safe, kept for the existing callers
 	extern "C" UTIL_EXPORT void postThreadSafe(const std::string& input, LogLevel level = LogLevel::Info);
 
+	// printf-style post, formats into a thread local buffer (used by the vzlog macros)
+	extern "C" UTIL_EXPORT void postf(LogLevel level, const char* format, ...);
+
+	// Same as postf, but always formats and returns the text (valid until the next postf/postfText call on this thread)
+	extern "C" UTIL_EXPORT const char* postfText(LogLevel level, const char* format, ...);
+
 	extern "C" UTIL_EXPORT void setLogLevel(LogLevel newLevel);
 
 	extern "C" UTIL_EXPORT LogLevel getLogLevel();
 
 	extern "C" UTIL_EXPORT const char* GetLogPath();
+
+	// Async mode: posting threads push into a lock-free queue and a background writer thread
+	//	writes the messages in batches, so callers never wait for the disk.
+	//	Sync mode (default) writes and flushes every message on the posting thread.
+	extern "C" UTIL_EXPORT void setAsyncMode(bool enabled);
+
+	extern "C" UTIL_EXPORT bool isAsyncMode();
+
+	// Async mode flush policy: messages at flushLevel or above are flushed right away,
+	//	everything else is flushed at least every flushIntervalMs
+	extern "C" UTIL_EXPORT void setFlushPolicy(LogLevel flushLevel, uint32_t flushIntervalMs);
+
+	// Number of messages dropped because the async queue was full (Error and Critical are never dropped)
+	extern "C" UTIL_EXPORT uint64_t getDroppedCount();
+
+	// Writes out everything posted so far and flushes the log file
+	extern "C" UTIL_EXPORT void flush();
 };
 
 namespace vz
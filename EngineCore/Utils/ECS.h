@@ -6,13 +6,13 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
-#include <deque>
 
 #include <cstdint>
 #include <cassert>
 #include <atomic>
 #include <memory>
 #include <string>
+#include <new>
 
 #define THREAD_SAFE_ECS_COMPONENTS
 
@@ -132,6 +132,164 @@ namespace vz::ecs
 		}
 	};
 
+	// Paged sparse array that maps an entity to a dense component index with a plain array lookup
+	//	Entities are allocated by an increasing global counter and are never reused, so the entity value itself indexes the pages
+	//	Pages are only allocated for entity ranges that contain an entry, and freed when their last entry is erased
+	class EntityIndex
+	{
+	public:
+		static constexpr uint32_t INVALID_INDEX = ~0u;
+
+		inline uint32_t get(Entity entity) const
+		{
+			const size_t page = size_t(entity >> PAGE_SHIFT);
+			if (page >= pages.size() || pages[page] == nullptr)
+				return INVALID_INDEX;
+			return pages[page][entity & PAGE_MASK];
+		}
+		inline void set(Entity entity, size_t index)
+		{
+			assert(index < INVALID_INDEX);
+			const size_t page = size_t(entity >> PAGE_SHIFT);
+			if (page >= pages.size())
+			{
+				pages.resize(page + 1);
+				pageCounts.resize(page + 1);
+			}
+			if (pages[page] == nullptr)
+			{
+				pages[page].reset(new uint32_t[PAGE_SIZE]);
+				std::fill(pages[page].get(), pages[page].get() + PAGE_SIZE, INVALID_INDEX);
+			}
+			uint32_t& slot = pages[page][entity & PAGE_MASK];
+			if (slot == INVALID_INDEX)
+			{
+				count++;
+				pageCounts[page]++;
+			}
+			slot = uint32_t(index);
+		}
+		inline void erase(Entity entity)
+		{
+			const size_t page = size_t(entity >> PAGE_SHIFT);
+			if (page < pages.size() && pages[page] != nullptr && pages[page][entity & PAGE_MASK] != INVALID_INDEX)
+			{
+				pages[page][entity & PAGE_MASK] = INVALID_INDEX;
+				count--;
+				if (--pageCounts[page] == 0)
+				{
+					pages[page].reset();
+					while (!pages.empty() && pages.back() == nullptr)
+					{
+						pages.pop_back();
+						pageCounts.pop_back();
+					}
+				}
+			}
+		}
+		inline bool contains(Entity entity) const { return get(entity) != INVALID_INDEX; }
+		inline void clear() { pages.clear(); pageCounts.clear(); count = 0; }
+		inline size_t size() const { return count; }
+		inline bool empty() const { return count == 0; }
+
+	private:
+		static constexpr size_t PAGE_SHIFT = 10;
+		static constexpr size_t PAGE_SIZE = size_t(1) << PAGE_SHIFT;
+		static constexpr Entity PAGE_MASK = PAGE_SIZE - 1;
+		std::vector<std::unique_ptr<uint32_t[]>> pages;
+		std::vector<uint16_t> pageCounts; // number of entries in each page
+		size_t count = 0;
+	};
+
+	// Dense component storage made of fixed-size contiguous pages
+	//	Growing never relocates existing components, so references stay valid while other components are created
+	//	(this is what THREAD_SAFE_ECS_COMPONENTS requires, and unlike std::deque the pages are large and contiguous)
+	template<typename Component>
+	class ComponentPages
+	{
+	public:
+		static constexpr size_t PAGE_SIZE = sizeof(Component) >= 1024 ? 16 : 16384 / sizeof(Component);
+
+		ComponentPages() = default;
+		~ComponentPages() { clear(); }
+
+		inline size_t size() const { return count; }
+		inline bool empty() const { return count == 0; }
+
+		inline Component& operator[](size_t index) { return *at(index); }
+		inline const Component& operator[](size_t index) const { return *at(index); }
+		inline Component& back() { return *at(count - 1); }
+		inline const Component& back() const { return *at(count - 1); }
+
+		inline void reserve(size_t capacity)
+		{
+			while (pages.size() * PAGE_SIZE < capacity)
+			{
+				pages.emplace_back(new Page);
+			}
+		}
+		template<typename... ARG>
+		inline Component& emplace_back(ARG&&... args)
+		{
+			reserve(count + 1);
+			Component* component = new (at(count)) Component(std::forward<ARG>(args)...);
+			count++;
+			return *component;
+		}
+		inline void pop_back()
+		{
+			assert(count > 0);
+			count--;
+			at(count)->~Component();
+			// Empty pages are freed, one is kept so that create/remove around a page boundary does not reallocate
+			const size_t used_pages = (count + PAGE_SIZE - 1) / PAGE_SIZE;
+			while (pages.size() > used_pages + 1)
+			{
+				pages.pop_back();
+			}
+		}
+		// Destroys all components and frees the pages
+		inline void clear()
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				at(i)->~Component();
+			}
+			count = 0;
+			pages.clear();
+		}
+
+		template<typename PAGES, typename T>
+		struct Iterator
+		{
+			PAGES* container;
+			size_t index;
+			inline T& operator*() const { return (*container)[index]; }
+			inline Iterator& operator++() { ++index; return *this; }
+			inline bool operator!=(const Iterator& other) const { return index != other.index; }
+		};
+		inline Iterator<ComponentPages, Component> begin() { return { this, 0 }; }
+		inline Iterator<ComponentPages, Component> end() { return { this, count }; }
+		inline Iterator<const ComponentPages, const Component> begin() const { return { this, 0 }; }
+		inline Iterator<const ComponentPages, const Component> end() const { return { this, count }; }
+
+	private:
+		struct Page
+		{
+			alignas(Component) uint8_t data[sizeof(Component) * PAGE_SIZE];
+		};
+		std::vector<std::unique_ptr<Page>> pages;
+		size_t count = 0;
+
+		inline Component* at(size_t index) const
+		{
+			return reinterpret_cast<Component*>(pages[index / PAGE_SIZE]->data) + (index % PAGE_SIZE);
+		}
+
+		ComponentPages(const ComponentPages&) = delete;
+		ComponentPages& operator=(const ComponentPages&) = delete;
+	};
+
 	// The ComponentManager is a container that stores components and matches them with entities
 	//	Note: final keyword is used to indicate this is a final implementation.
 	//	This allows function inlining and avoid calls, improves performance considerably
@@ -148,11 +306,8 @@ namespace vz::ecs
 
 		inline void Reserve(size_t count)
 		{
-#ifndef THREAD_SAFE_ECS_COMPONENTS
 			components.reserve(count);
-#endif
 			entities.reserve(count);
-			lookup.reserve(count);
 			lookupVUID.reserve(count);
 		}
 
@@ -171,7 +326,6 @@ namespace vz::ecs
 		{
 			components.reserve(GetCount() + other.GetCount());
 			entities.reserve(GetCount() + other.GetCount());
-			lookup.reserve(GetCount() + other.GetCount());
 			lookupVUID.reserve(GetCount() + other.GetCount());
 			for (size_t i = 0; i < other.GetCount(); ++i)
 			{
@@ -179,7 +333,7 @@ namespace vz::ecs
 				VUID vuid = other.components[i].GetVUID();
 				assert(!Contains(entity));
 				entities.push_back(entity);
-				lookup[entity] = components.size();
+				lookup.set(entity, components.size());
 				lookupVUID[vuid] = components.size();
 				components.push_back(other.components[i]);
 			}
@@ -192,7 +346,6 @@ namespace vz::ecs
 		{
 			components.reserve(GetCount() + other.GetCount());
 			entities.reserve(GetCount() + other.GetCount());
-			lookup.reserve(GetCount() + other.GetCount());
 			lookupVUID.reserve(GetCount() + other.GetCount());
 		
 			for (size_t i = 0; i < other.GetCount(); ++i)
@@ -202,7 +355,7 @@ namespace vz::ecs
 				assert(!Contains(entity));
 				assert(!ContainsVUID(vuid));
 				entities.push_back(entity);
-				lookup[entity] = components.size();
+				lookup.set(entity, components.size());
 				lookupVUID[vuid] = components.size();
 				components.push_back(std::move(other.components[i]));
 			}
@@ -255,8 +408,7 @@ namespace vz::ecs
 						assert(!ContainsVUID(vuid));
 						Entity entity_archived = entityMapper.GetEntity(vuid);
 						Entity entity = entityMapper.RemapEntity(entity_archived);
-						Create(entity, vuid);
-						components[lookup[entity]].Serialize(archive, version);
+						Create(entity, vuid).Serialize(archive, version);
 					}
 				}
 			}
@@ -303,8 +455,7 @@ namespace vz::ecs
 						assert(!ContainsVUID(vuid));
 						Entity entity_archived = entityMapper.GetEntity(vuid);
 						Entity entity = entityMapper.RemapEntity(entity_archived);
-						Create(entity, vuid);
-						components[lookup[entity]].Serialize(archive, version);
+						Create(entity, vuid).Serialize(archive, version);
 					}
 				}
 			}
@@ -335,14 +486,14 @@ namespace vz::ecs
 			assert(entity != INVALID_ENTITY);
 
 			// Only one of this component type per entity is allowed!
-			assert(lookup.find(entity) == lookup.end());
+			assert(!lookup.contains(entity));
 
 			// Entity count must always be the same as the number of coponents!
 			assert(entities.size() == components.size());
 			assert(lookup.size() == components.size());
 
 			// Update the entity lookup table:
-			lookup[entity] = components.size();
+			lookup.set(entity, components.size());
 
 			// New components are always pushed to the end:
 			components.emplace_back(entity, vuid);
@@ -361,11 +512,11 @@ namespace vz::ecs
 		// Remove a component of a certain entity if it exists
 		inline void Remove(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const uint32_t found = lookup.get(entity);
+			if (found != EntityIndex::INVALID_INDEX)
 			{
 				// Directly index into components and entities array:
-				const size_t index = it->second;
+				const size_t index = found;
 				assert(entities[index] == entity);
 
 				VUID vuid = components[index].GetVUID();
@@ -377,7 +528,7 @@ namespace vz::ecs
 					entities[index] = entities.back();
 
 					// Update the lookup tables:
-					lookup[entities[index]] = index;
+					lookup.set(entities[index], index);
 
 					VUID vuid_updated = components[index].GetVUID();
 					lookupVUID[vuid_updated] = index;
@@ -394,11 +545,11 @@ namespace vz::ecs
 		// Remove a component of a certain entity if it exists while keeping the current ordering
 		inline void RemoveKeepSorted(Entity entity)
 		{
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
+			const uint32_t found = lookup.get(entity);
+			if (found != EntityIndex::INVALID_INDEX)
 			{
 				// Directly index into components and entities array:
-				const size_t index = it->second;
+				const size_t index = found;
 				assert(entities[index] == entity);
 				VUID vuid = components[index].GetVUID();
 
@@ -413,7 +564,7 @@ namespace vz::ecs
 					for (size_t i = index + 1; i < entities.size(); ++i)
 					{
 						entities[i - 1] = entities[i];
-						lookup[entities[i - 1]] = i - 1;
+						lookup.set(entities[i - 1], i - 1);
 
 						VUID vuid_updated = components[i - 1].GetVUID();
 						lookupVUID[vuid_updated] = i - 1;
@@ -450,7 +601,7 @@ namespace vz::ecs
 				const size_t next = i + direction;
 				components[i] = std::move(components[next]);
 				entities[i] = entities[next];
-				lookup[entities[i]] = i;
+				lookup.set(entities[i], i);
 
 				VUID vuid = components[i].GetVUID();
 				lookupVUID[vuid] = i;
@@ -459,16 +610,14 @@ namespace vz::ecs
 			// Saved entity-component moved to the required position:
 			components[index_to] = std::move(component);
 			entities[index_to] = entity;
-			lookup[entity] = index_to;
+			lookup.set(entity, index_to);
 			lookupVUID[vuid_from] = index_to;
 		}
 
 		// Check if a component exists for a given entity or not
 		inline bool Contains(Entity entity) const
 		{
-			if (lookup.empty())
-				return false;
-			return lookup.find(entity) != lookup.end();
+			return lookup.contains(entity);
 		}
 		// Check if a component exists for a given VUID or not
 		inline bool ContainsVUID(VUID vuid) const
@@ -481,29 +630,15 @@ namespace vz::ecs
 		// Retrieve a [read/write] component specified by an entity (if it exists, otherwise nullptr)
 		inline Component* GetComponent(Entity entity)
 		{
-			if (lookup.empty()) {
-				return nullptr;
-			}
-			auto it = lookup.find(entity);
-			if (it != lookup.end())
-			{
-				return &components[it->second];
-			}
-			return nullptr;
+			const uint32_t index = lookup.get(entity);
+			return index == EntityIndex::INVALID_INDEX ? nullptr : &components[index];
 		}
 
 		// Retrieve a [read only] component specified by an entity (if it exists, otherwise nullptr)
 		inline const Component* GetComponent(Entity entity) const
 		{
-			if (lookup.empty()) {
-				return nullptr;
-			}
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
-			{
-				return &components[it->second];
-			}
-			return nullptr;
+			const uint32_t index = lookup.get(entity);
+			return index == EntityIndex::INVALID_INDEX ? nullptr : &components[index];
 		}
 
 		// Retrieve a [read/write] component specified by a VUID (if it exists, otherwise nullptr)
@@ -535,14 +670,8 @@ namespace vz::ecs
 		// Retrieve component index by entity handle (if not exists, returns ~0ull value)
 		inline size_t GetIndex(Entity entity) const
 		{
-			if (lookup.empty())
-				return ~0ull;
-			const auto it = lookup.find(entity);
-			if (it != lookup.end())
-			{
-				return it->second;
-			}
-			return ~0ull;
+			const uint32_t index = lookup.get(entity);
+			return index == EntityIndex::INVALID_INDEX ? ~0ull : size_t(index);
 		}
 
 		// Retrieve component index by entity handle (if not exists, returns ~0ull value)
@@ -611,15 +740,16 @@ namespace vz::ecs
 	private:
 		// This is a linear array of alive components
 #ifdef THREAD_SAFE_ECS_COMPONENTS
-		std::deque<Component> components;
+		ComponentPages<Component> components;
 #else
 		std::vector<Component> components;
 #endif
 		// This is a linear array of entities corresponding to each alive component
 		std::vector<Entity> entities;
-		// This is a lookup table for entities
-		std::unordered_map<Entity, size_t> lookup;
+		// This is a lookup table for entities (dense index by entity value, no hashing)
+		EntityIndex lookup;
 		// This is a lookup table for component's vuid
+		//	VUIDs are timestamp based 64-bit keys (see uuid::generateUUID), so this one stays hashed
 		std::unordered_map<VUID, size_t> lookupVUID;
 
 		// Disallow this to be copied by mistake
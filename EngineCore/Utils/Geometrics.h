@@ -1,16 +1,24 @@
 #pragma once
 #include "vzMath.h"
+#include "JobSystem.h"
 
 #include <limits>
 #include <vector>
 #include <cassert>
 #include <functional>
+#include <atomic>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace vz::geometrics
 {
 	struct Sphere;
 	struct Ray;
 	struct AABB;
+	struct AABBSoA;
 	struct Capsule;
 	struct Plane;
 
@@ -79,6 +87,22 @@ namespace vz::geometrics
 
 		//void Serialize(vz::Archive& archive, vz::ecs::EntitySerializer& seri);
 	};
+	// Structure-of-arrays mirror of an AABB array, used by the batch culling kernel (Frustum::CullBoxes)
+	//	the arrays are padded up to SIMD_WIDTH with invalid boxes, so the kernel never needs a scalar tail
+	struct AABBSoA
+	{
+		static constexpr size_t SIMD_WIDTH = 8;
+
+		std::vector<float> minX, minY, minZ;
+		std::vector<float> maxX, maxY, maxZ;
+		std::vector<uint32_t> layerMask;
+		size_t count = 0;
+
+		inline void Resize(const size_t num);
+		inline void Set(const size_t index, const AABB& aabb);
+		inline void Build(const AABB* aabbs, const size_t num);
+		inline void Clear();
+	};
 	struct Sphere
 	{
 		XMFLOAT3 center;
@@ -225,6 +249,11 @@ namespace vz::geometrics
 		};
 		inline BoxFrustumIntersect CheckBox(const AABB& box) const;
 		inline bool CheckBoxFast(const AABB& box) const;
+		// Batch version of CheckBoxFast() including the layer mask test, over the range [begin, end) of boxes
+		//	begin must be a multiple of AABBSoA::SIMD_WIDTH
+		//	writes the indices of the passing boxes (in ascending order) to visibleIndices, which must hold (end - begin) entries
+		//	returns the number of written indices
+		inline uint32_t CullBoxes(const AABBSoA& boxes, const uint32_t begin, const uint32_t end, const uint32_t layerMask, uint32_t* visibleIndices) const;
 
 		inline const XMFLOAT4& getNearPlane() const;
 		inline const XMFLOAT4& getFarPlane() const;
@@ -1120,6 +1149,149 @@ namespace vz::geometrics
 		return true;
 	}
 
+	uint32_t Frustum::CullBoxes(const AABBSoA& boxes, const uint32_t begin, const uint32_t end, const uint32_t layerMask, uint32_t* visibleIndices) const
+	{
+		assert(end <= boxes.count);
+		assert(begin % AABBSoA::SIMD_WIDTH == 0); // full SIMD loads must stay inside the padded arrays
+		if (begin >= end)
+			return 0;
+
+		// The box corner that is furthest along a plane normal only depends on the plane, not the box,
+		//	so the min/max array selection of CheckBoxFast() is resolved once per plane here:
+		const float* px[6];
+		const float* py[6];
+		const float* pz[6];
+		for (size_t p = 0; p < 6; ++p)
+		{
+			px[p] = planes[p].x < 0 ? boxes.minX.data() : boxes.maxX.data();
+			py[p] = planes[p].y < 0 ? boxes.minY.data() : boxes.maxY.data();
+			pz[p] = planes[p].z < 0 ? boxes.minZ.data() : boxes.maxZ.data();
+		}
+
+		uint32_t count = 0;
+		uint32_t i = begin;
+
+		// Lane bits of passing boxes are compacted to indices, lanes at or past end are ignored:
+		auto compact = [&](uint32_t visibleBits, const uint32_t width) {
+			const uint32_t lanes = std::min(width, end - i);
+			for (uint32_t lane = 0; lane < lanes; ++lane)
+			{
+				visibleIndices[count] = i + lane;
+				count += (visibleBits >> lane) & 1u;
+			}
+			};
+
+#if defined(__AVX2__)
+		{
+			const __m256i mask = _mm256_set1_epi32((int)layerMask);
+			const __m256i zeroi = _mm256_setzero_si256();
+			const __m256 zero = _mm256_setzero_ps();
+			__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+			for (size_t p = 0; p < 6; ++p)
+			{
+				plane_x[p] = _mm256_set1_ps(planes[p].x);
+				plane_y[p] = _mm256_set1_ps(planes[p].y);
+				plane_z[p] = _mm256_set1_ps(planes[p].z);
+				plane_w[p] = _mm256_set1_ps(planes[p].w);
+			}
+			for (; i < end; i += 8)
+			{
+				const __m256i layer = _mm256_loadu_si256((const __m256i*)(boxes.layerMask.data() + i));
+				__m256 culled = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(layer, mask), zeroi));
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(_mm256_loadu_ps(boxes.minX.data() + i), _mm256_loadu_ps(boxes.maxX.data() + i), _CMP_GT_OQ));
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(_mm256_loadu_ps(boxes.minY.data() + i), _mm256_loadu_ps(boxes.maxY.data() + i), _CMP_GT_OQ));
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(_mm256_loadu_ps(boxes.minZ.data() + i), _mm256_loadu_ps(boxes.maxZ.data() + i), _CMP_GT_OQ));
+				for (size_t p = 0; p < 6; ++p)
+				{
+					__m256 dist = _mm256_add_ps(_mm256_mul_ps(plane_x[p], _mm256_loadu_ps(px[p] + i)), plane_w[p]);
+					dist = _mm256_add_ps(_mm256_mul_ps(plane_y[p], _mm256_loadu_ps(py[p] + i)), dist);
+					dist = _mm256_add_ps(_mm256_mul_ps(plane_z[p], _mm256_loadu_ps(pz[p] + i)), dist);
+					culled = _mm256_or_ps(culled, _mm256_cmp_ps(dist, zero, _CMP_LT_OQ));
+				}
+				compact(~(uint32_t)_mm256_movemask_ps(culled) & 0xFFu, 8);
+			}
+		}
+#endif // __AVX2__
+
+		const XMVECTOR mask = XMVectorReplicateInt(layerMask);
+		const XMVECTOR zero = XMVectorZero();
+		XMVECTOR plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+		for (size_t p = 0; p < 6; ++p)
+		{
+			const XMVECTOR plane = XMLoadFloat4(&planes[p]);
+			plane_x[p] = XMVectorSplatX(plane);
+			plane_y[p] = XMVectorSplatY(plane);
+			plane_z[p] = XMVectorSplatZ(plane);
+			plane_w[p] = XMVectorSplatW(plane);
+		}
+		for (; i < end; i += 4)
+		{
+			XMVECTOR culled = XMVectorEqualInt(XMVectorAndInt(XMLoadInt4(boxes.layerMask.data() + i), mask), zero);
+			culled = XMVectorOrInt(culled, XMVectorGreater(XMLoadFloat4((const XMFLOAT4*)(boxes.minX.data() + i)), XMLoadFloat4((const XMFLOAT4*)(boxes.maxX.data() + i))));
+			culled = XMVectorOrInt(culled, XMVectorGreater(XMLoadFloat4((const XMFLOAT4*)(boxes.minY.data() + i)), XMLoadFloat4((const XMFLOAT4*)(boxes.maxY.data() + i))));
+			culled = XMVectorOrInt(culled, XMVectorGreater(XMLoadFloat4((const XMFLOAT4*)(boxes.minZ.data() + i)), XMLoadFloat4((const XMFLOAT4*)(boxes.maxZ.data() + i))));
+			for (size_t p = 0; p < 6; ++p)
+			{
+				XMVECTOR dist = XMVectorMultiplyAdd(plane_x[p], XMLoadFloat4((const XMFLOAT4*)(px[p] + i)), plane_w[p]);
+				dist = XMVectorMultiplyAdd(plane_y[p], XMLoadFloat4((const XMFLOAT4*)(py[p] + i)), dist);
+				dist = XMVectorMultiplyAdd(plane_z[p], XMLoadFloat4((const XMFLOAT4*)(pz[p] + i)), dist);
+				culled = XMVectorOrInt(culled, XMVectorLess(dist, zero));
+			}
+#if defined(_XM_SSE_INTRINSICS_)
+			const uint32_t culled_bits = (uint32_t)_mm_movemask_ps(culled);
+#else
+			XMUINT4 culled_lanes;
+			XMStoreUInt4(&culled_lanes, culled);
+			const uint32_t culled_bits = (culled_lanes.x & 1u) | ((culled_lanes.y & 1u) << 1u) | ((culled_lanes.z & 1u) << 2u) | ((culled_lanes.w & 1u) << 3u);
+#endif
+			compact(~culled_bits & 0xFu, 4);
+		}
+
+		return count;
+	}
+
+	void AABBSoA::Resize(const size_t num)
+	{
+		count = num;
+		const size_t padded = (num + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+		// padding lanes hold inverted (invalid) boxes with an empty layer mask:
+		minX.resize(padded); minY.resize(padded); minZ.resize(padded);
+		maxX.resize(padded); maxY.resize(padded); maxZ.resize(padded);
+		layerMask.resize(padded);
+		for (size_t i = num; i < padded; ++i)
+		{
+			minX[i] = minY[i] = minZ[i] = std::numeric_limits<float>::max();
+			maxX[i] = maxY[i] = maxZ[i] = std::numeric_limits<float>::lowest();
+			layerMask[i] = 0;
+		}
+	}
+	void AABBSoA::Set(const size_t index, const AABB& aabb)
+	{
+		assert(index < count);
+		minX[index] = aabb._min.x;
+		minY[index] = aabb._min.y;
+		minZ[index] = aabb._min.z;
+		maxX[index] = aabb._max.x;
+		maxY[index] = aabb._max.y;
+		maxZ[index] = aabb._max.z;
+		layerMask[index] = aabb.layerMask;
+	}
+	void AABBSoA::Build(const AABB* aabbs, const size_t num)
+	{
+		Resize(num);
+		for (size_t i = 0; i < num; ++i)
+		{
+			Set(i, aabbs[i]);
+		}
+	}
+	void AABBSoA::Clear()
+	{
+		minX.clear(); minY.clear(); minZ.clear();
+		maxX.clear(); maxY.clear(); maxZ.clear();
+		layerMask.clear();
+		count = 0;
+	}
+
 	const XMFLOAT4& Frustum::getNearPlane() const { return planes[0]; }
 	const XMFLOAT4& Frustum::getFarPlane() const { return planes[1]; }
 	const XMFLOAT4& Frustum::getLeftPlane() const { return planes[2]; }
@@ -1375,7 +1547,118 @@ namespace vz::geometrics
 				subdivide(0, aabbs);
 		}
 
-		// Updates the AABBs, but doesn't modify the tree structure (fast update mode) 
+		// Completely rebuilds tree from scratch with binned SAH, subtrees are built in parallel on the job system
+		//	The node layout is the same as Build(): children are at left and left + 1, and always after their parent
+		//	Can be called from inside a job, the calling thread helps executing the subtree jobs while waiting
+		void BuildParallel(const AABB* aabbs, uint32_t aabb_count)
+		{
+			node_count = 0;
+			if (aabb_count == 0)
+				return;
+
+			const uint32_t node_capacity = aabb_count * 2 - 1;
+			allocation.resize(
+				sizeof(Node) * node_capacity +
+				sizeof(uint32_t) * aabb_count
+			);
+			nodes = (Node*)allocation.data();
+			leaf_indices = (uint32_t*)(nodes + node_capacity);
+			leaf_count = aabb_count;
+
+			BinnedBuild build;
+			build.refs.resize(aabb_count);
+
+			// Leaf centers, root bounds and root centroid bounds:
+			const uint32_t group_count = jobsystem::DispatchGroupCount(aabb_count, BINNED_RANGE_GROUPSIZE);
+			std::vector<Bin> group_bounds(group_count);
+			jobsystem::Dispatch(build.ctx, group_count, 1, [&](jobsystem::JobArgs args) {
+				const uint32_t begin = args.jobIndex * BINNED_RANGE_GROUPSIZE;
+				const uint32_t end = std::min(begin + BINNED_RANGE_GROUPSIZE, aabb_count);
+				Bin bounds;
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					AABB& ref = build.refs[i];
+					ref = aabbs[i];
+					ref.userdata = i;
+					bounds.add(ref);
+				}
+				group_bounds[args.jobIndex] = bounds;
+				});
+			jobsystem::Wait(build.ctx);
+
+			Bin root;
+			for (const Bin& bounds : group_bounds)
+			{
+				root.add(bounds);
+			}
+			Node& node = nodes[0];
+			node = {};
+			node.aabb = root.aabb;
+			node.count = aabb_count;
+
+			subdivideBinned(build, 0, root.centers);
+			jobsystem::Wait(build.ctx);
+			node_count = build.node_counter.load();
+
+			jobsystem::Dispatch(build.ctx, aabb_count, BINNED_RANGE_GROUPSIZE, [&](jobsystem::JobArgs args) {
+				leaf_indices[args.jobIndex] = build.refs[args.jobIndex].userdata;
+				});
+			jobsystem::Wait(build.ctx);
+		}
+
+		// Surface area heuristic cost of the tree, relative to the root bounds (lower is better)
+		float GetSAHCost() const
+		{
+			if (node_count == 0)
+				return 0;
+			const float root_area = surfaceArea(nodes[0].aabb);
+			float cost = 0;
+			for (uint32_t i = 0; i < node_count; ++i)
+			{
+				const Node& node = nodes[i];
+				const float area = surfaceArea(node.aabb) / root_area;
+				cost += node.isLeaf() ? primitiveCost * node.count * area : traversalCost * area;
+			}
+			return cost;
+		}
+
+		// Rebinds the tree to an allocation that was filled from outside (e.g. loaded from an archive)
+		//	The allocation must have the layout of Build(): node capacity of leafCount * 2 - 1, then the leaf indices
+		//	Returns false and leaves the tree empty if the allocation is not a consistent tree
+		bool Restore(uint32_t nodeCount, uint32_t leafCount)
+		{
+			nodes = nullptr;
+			leaf_indices = nullptr;
+			node_count = 0;
+			leaf_count = 0;
+			if (nodeCount == 0 || leafCount == 0)
+				return false;
+			const size_t node_capacity = (size_t)leafCount * 2 - 1;
+			if (nodeCount > node_capacity || allocation.size() != sizeof(Node) * node_capacity + sizeof(uint32_t) * leafCount)
+				return false;
+
+			Node* restored_nodes = (Node*)allocation.data();
+			uint32_t* restored_indices = (uint32_t*)(restored_nodes + node_capacity);
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				const Node& node = restored_nodes[i];
+				if (node.isLeaf() ? ((uint64_t)node.offset + node.count > leafCount) : (node.left <= i || node.left + 1 >= nodeCount))
+					return false;
+			}
+			for (uint32_t i = 0; i < leafCount; ++i)
+			{
+				if (restored_indices[i] >= leafCount)
+					return false;
+			}
+
+			nodes = restored_nodes;
+			leaf_indices = restored_indices;
+			node_count = nodeCount;
+			leaf_count = leafCount;
+			return true;
+		}
+
+		// Updates the AABBs, but doesn't modify the tree structure (fast update mode)
 		void Update(const AABB* aabbs, uint32_t aabb_count)
 		{
 			if (node_count == 0)
@@ -1385,7 +1668,7 @@ namespace vz::geometrics
 			if (aabb_count != leaf_count)
 				return;
 
-			for (uint32_t i = node_count - 1; i > 0; --i)
+			for (uint32_t i = node_count; i-- > 0;) // children are always after their parent, the root is refitted last
 			{
 				Node& node = nodes[i];
 				node.aabb = AABB();
@@ -1619,7 +1902,186 @@ namespace vz::geometrics
 			subdivide(right_child_index, leaf_aabb_data);
 		}
 
-		inline float surfaceArea(const vz::geometrics::AABB& b)
+		static constexpr uint32_t BINNED_BIN_COUNT = 32;
+		static constexpr uint32_t BINNED_MAX_SAH_LEAF = 16;				// SAH can terminate a node as a leaf only below this size
+		static constexpr uint32_t BINNED_PARALLEL_SUBTREE = 4096;		// subtrees at least this large are built by a separate job
+		static constexpr uint32_t BINNED_PARALLEL_RANGE = 256 * 1024;	// nodes at least this large are binned by multiple jobs
+		static constexpr uint32_t BINNED_RANGE_GROUPSIZE = 64 * 1024;
+
+		struct BinnedBuild
+		{
+			// Copies of the input AABBs with userdata = leaf index, partitioned in place so that the build streams through memory
+			//	leaf_indices are written from them when the tree is complete
+			std::vector<AABB> refs;
+			std::atomic<uint32_t> node_counter{ 1 };
+			jobsystem::context ctx;
+		};
+		struct Bin
+		{
+			AABB aabb;		// bounds of the leaves
+			AABB centers;	// bounds of the leaf centers
+			uint32_t count = 0;
+
+			inline void add(const AABB& leaf)
+			{
+				const XMFLOAT3 center = leaf.getCenter();
+				aabb._min = vz::math::Min(aabb._min, leaf._min);
+				aabb._max = vz::math::Max(aabb._max, leaf._max);
+				centers._min = vz::math::Min(centers._min, center);
+				centers._max = vz::math::Max(centers._max, center);
+				count++;
+			}
+			inline void add(const Bin& other)
+			{
+				aabb = AABB::Merge(aabb, other.aabb);
+				centers = AABB::Merge(centers, other.centers);
+				count += other.count;
+			}
+		};
+
+		// Runs func(begin, end, group) over [begin, end) of the build refs, split into groups that are processed in parallel
+		template<typename F>
+		void forEachRangeParallel(uint32_t begin, uint32_t end, const F& func)
+		{
+			jobsystem::context ctx;
+			const uint32_t group_count = jobsystem::DispatchGroupCount(end - begin, BINNED_RANGE_GROUPSIZE);
+			jobsystem::Dispatch(ctx, group_count, 1, [&](jobsystem::JobArgs args) {
+				const uint32_t group_begin = begin + args.jobIndex * BINNED_RANGE_GROUPSIZE;
+				func(group_begin, std::min(group_begin + BINNED_RANGE_GROUPSIZE, end), args.jobIndex);
+				});
+			jobsystem::Wait(ctx);
+		}
+
+		// centroid_bounds: bounds of the leaf centers of the node, they decide the binning axis and range
+		void subdivideBinned(BinnedBuild& build, uint32_t nodeIndex, const AABB& centroid_bounds)
+		{
+			Node& node = nodes[nodeIndex];
+			if (node.count <= maxLeafPrimitives)
+				return;
+
+			const uint32_t begin = node.offset;
+			const uint32_t end = begin + node.count;
+			const bool parallel = node.count >= BINNED_PARALLEL_RANGE;
+
+			const XMFLOAT3 cmin = centroid_bounds.getMin();
+			const XMFLOAT3 cextent = centroid_bounds.getWidth();
+			int axis = 0;
+			if (cextent.y > cextent.x) axis = 1;
+			if (cextent.z > ((const float*)&cextent)[axis]) axis = 2;
+			const float axis_min = ((const float*)&cmin)[axis];
+			const float axis_extent = ((const float*)&cextent)[axis];
+			if (!(axis_extent > 0))
+				return; // all centers coincide, they can't be separated
+			const uint32_t bin_count = std::min(BINNED_BIN_COUNT, std::max(4u, node.count)); // small nodes don't need many split candidates
+			const float scale = bin_count / axis_extent;
+			auto binIndex = [&](const AABB& ref) {
+				const float value = (((const float*)&ref._min)[axis] + ((const float*)&ref._max)[axis]) * 0.5f;
+				return std::min(bin_count - 1, (uint32_t)((value - axis_min) * scale));
+				};
+
+			// Bin the leaves:
+			Bin bins[BINNED_BIN_COUNT];
+			auto fillBins = [&](uint32_t range_begin, uint32_t range_end, Bin* range_bins) {
+				for (uint32_t i = range_begin; i < range_end; ++i)
+				{
+					const AABB& ref = build.refs[i];
+					range_bins[binIndex(ref)].add(ref);
+				}
+				};
+			if (parallel)
+			{
+				std::vector<Bin> group_bins(jobsystem::DispatchGroupCount(node.count, BINNED_RANGE_GROUPSIZE) * bin_count);
+				forEachRangeParallel(begin, end, [&](uint32_t range_begin, uint32_t range_end, uint32_t group) {
+					fillBins(range_begin, range_end, group_bins.data() + group * bin_count);
+					});
+				for (size_t i = 0; i < group_bins.size(); ++i)
+				{
+					bins[i % bin_count].add(group_bins[i]);
+				}
+			}
+			else
+			{
+				fillBins(begin, end, bins);
+			}
+
+			// Sweep the split planes between the bins:
+			float left_area[BINNED_BIN_COUNT - 1];
+			uint32_t left_count[BINNED_BIN_COUNT - 1];
+			AABB left_bounds;
+			uint32_t left_sum = 0;
+			for (uint32_t i = 0; i < bin_count - 1; ++i)
+			{
+				left_sum += bins[i].count;
+				left_count[i] = left_sum;
+				left_bounds = AABB::Merge(left_bounds, bins[i].aabb);
+				left_area[i] = surfaceArea(left_bounds);
+			}
+			const float parent_area = surfaceArea(node.aabb);
+			float best_cost = FLT_MAX;
+			uint32_t best_split = 0;
+			AABB right_bounds;
+			uint32_t right_sum = 0;
+			for (uint32_t i = bin_count - 1; i > 0; --i)
+			{
+				right_sum += bins[i].count;
+				right_bounds = AABB::Merge(right_bounds, bins[i].aabb);
+				if (left_count[i - 1] == 0 || right_sum == 0)
+					continue;
+				const float cost = traversalCost + primitiveCost * (left_area[i - 1] * left_count[i - 1] + surfaceArea(right_bounds) * right_sum) / parent_area;
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					best_split = i;
+				}
+			}
+			if (best_split == 0)
+				return;
+			if (best_cost >= primitiveCost * node.count && node.count <= BINNED_MAX_SAH_LEAF)
+				return;
+
+			// Partition leaves at the chosen bin boundary:
+			AABB* refs = build.refs.data();
+			AABB* middle = std::partition(refs + begin, refs + end, [&](const AABB& ref) {
+				return binIndex(ref) < best_split;
+				});
+			const uint32_t left_leaf_count = uint32_t(middle - (refs + begin));
+			assert(left_leaf_count > 0 && left_leaf_count < node.count);
+
+			Bin left_child_bounds, right_child_bounds;
+			for (uint32_t i = 0; i < bin_count; ++i)
+			{
+				(i < best_split ? left_child_bounds : right_child_bounds).add(bins[i]);
+			}
+			assert(left_child_bounds.count == left_leaf_count);
+
+			const uint32_t left_child_index = build.node_counter.fetch_add(2);
+			const uint32_t right_child_index = left_child_index + 1;
+			node.left = left_child_index;
+			nodes[left_child_index] = {};
+			nodes[left_child_index].aabb = left_child_bounds.aabb;
+			nodes[left_child_index].offset = begin;
+			nodes[left_child_index].count = left_leaf_count;
+			nodes[right_child_index] = {};
+			nodes[right_child_index].aabb = right_child_bounds.aabb;
+			nodes[right_child_index].offset = begin + left_leaf_count;
+			nodes[right_child_index].count = node.count - left_leaf_count;
+			node.count = 0;
+
+			if (left_leaf_count >= BINNED_PARALLEL_SUBTREE)
+			{
+				const AABB left_centers = left_child_bounds.centers;
+				jobsystem::Execute(build.ctx, [this, &build, left_child_index, left_centers](jobsystem::JobArgs) {
+					subdivideBinned(build, left_child_index, left_centers);
+					});
+			}
+			else
+			{
+				subdivideBinned(build, left_child_index, left_child_bounds.centers);
+			}
+			subdivideBinned(build, right_child_index, right_child_bounds.centers);
+		}
+
+		static inline float surfaceArea(const vz::geometrics::AABB& b)
 		{
 			XMFLOAT3 e = b.getHalfWidth();           // half-extents
 			float a = 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
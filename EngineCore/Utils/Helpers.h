@@ -8,6 +8,7 @@
 #include <filesystem>
 #include <functional>
 #include <thread>
+#include <memory>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -16,6 +17,10 @@
 #include <comdef.h> // com_error
 #else
 #include <sys/sysinfo.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "Utility/portable-file-dialogs.h"
 #endif
 
@@ -230,6 +235,84 @@ namespace vz::helper
 		return FileRead_Impl(fileName, data, max_read, offset);
 	}
 
+	// Read-only memory mapping of a whole file, it is unmapped when the last reference is released
+	inline std::shared_ptr<const void> FileMap(const std::string& fileName, size_t& size)
+	{
+		size = 0;
+#if defined(PLATFORM_LINUX)
+		std::string filepath = fileName;
+		std::replace(filepath.begin(), filepath.end(), '\\', '/');
+		int fd = open(filepath.c_str(), O_RDONLY);
+		if (fd < 0)
+			return nullptr;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size <= 0)
+		{
+			close(fd);
+			return nullptr;
+		}
+		const size_t file_size = (size_t)st.st_size;
+		void* mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd); // the mapping stays valid after closing the descriptor
+		if (mapped == MAP_FAILED)
+			return nullptr;
+		size = file_size;
+		return std::shared_ptr<const void>(mapped, [file_size](const void* ptr) { munmap((void*)ptr, file_size); });
+#else
+		HANDLE file = CreateFileW(ToNativeString(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return nullptr;
+		LARGE_INTEGER file_size = {};
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+		{
+			CloseHandle(file);
+			return nullptr;
+		}
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+			return nullptr;
+		void* mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); // the view keeps the mapping alive
+		if (mapped == nullptr)
+			return nullptr;
+		size = (size_t)file_size.QuadPart;
+		return std::shared_ptr<const void>(mapped, [](const void* ptr) { UnmapViewOfFile(ptr); });
+#endif // PLATFORM_LINUX
+	}
+
+	// Reserves address space without backing memory, it is released when the last reference is released
+	//	Parts of it must be committed with MemoryCommit() before they are accessed
+	inline std::shared_ptr<void> MemoryReserve(size_t size)
+	{
+		if (size == 0)
+			return nullptr;
+#if defined(PLATFORM_LINUX)
+		void* reserved = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (reserved == MAP_FAILED)
+			return nullptr;
+		return std::shared_ptr<void>(reserved, [size](void* ptr) { munmap(ptr, size); });
+#else
+		void* reserved = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+		if (reserved == nullptr)
+			return nullptr;
+		return std::shared_ptr<void>(reserved, [](void* ptr) { VirtualFree(ptr, 0, MEM_RELEASE); });
+#endif // PLATFORM_LINUX
+	}
+
+	// Commits zero initialized, read-write memory to a range of MemoryReserve() address space
+	inline bool MemoryCommit(void* ptr, size_t size)
+	{
+#if defined(PLATFORM_LINUX)
+		const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+		const uintptr_t begin = (uintptr_t)ptr & ~(page - 1);
+		const uintptr_t end = (uintptr_t)ptr + size;
+		return mprotect((void*)begin, (size_t)(end - begin), PROT_READ | PROT_WRITE) == 0;
+#else
+		return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#endif // PLATFORM_LINUX
+	}
+
 	inline bool FileWrite(const std::string& fileName, const uint8_t* data, size_t size)
 	{
 		if (size <= 0)
@@ -593,6 +676,7 @@ namespace vz::helper
 		uint64_t total_physical = 0;	// size of physical memory on whole system (in bytes)
 		uint64_t total_virtual = 0;		// size of virtual address space on whole system (in bytes)
 		uint64_t process_physical = 0;	// size of currently committed physical memory by application (in bytes)
+		uint64_t process_physical_peak = 0;	// the largest process_physical since the application started (in bytes)
 		uint64_t process_virtual = 0;	// size of currently mapped virtual memory by application (in bytes)
 	};
 	inline MemoryUsage GetMemoryUsage()
@@ -610,6 +694,7 @@ namespace vz::helper
 		PROCESS_MEMORY_COUNTERS_EX pmc = {};
 		GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&pmc, sizeof(pmc));
 		mem.process_physical = pmc.WorkingSetSize;
+		mem.process_physical_peak = pmc.PeakWorkingSetSize;
 		mem.process_virtual = pmc.PrivateUsage;
 #elif defined(PLATFORM_LINUX)
 		// TODO Linux
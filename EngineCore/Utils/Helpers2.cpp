@@ -853,4 +853,10 @@ namespace vz::helper2
 		res = ZSTD_decompress(dst_data.data(), dst_data.size(), src_data, src_size);
 		return ZSTD_isError(res) == 0;
 	}
+
+	bool Decompress(const uint8_t* src_data, size_t src_size, uint8_t* dst_data, size_t dst_size)
+	{
+		size_t res = ZSTD_decompress(dst_data, dst_size, src_data, src_size);
+		return ZSTD_isError(res) == 0 && res == dst_size;
+	}
 }
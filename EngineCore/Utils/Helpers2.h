@@ -9,6 +9,8 @@ namespace vz::helper2
 	bool DecompressPNG(const uint8_t* src_data, size_t src_size, std::vector<uint8_t>& dst_data);
 	bool Compress(const uint8_t* src_data, size_t src_size, std::vector<uint8_t>& dst_data, int level);
 	bool Decompress(const uint8_t* src_data, size_t src_size, std::vector<uint8_t>& dst_data);
+	// Decompress a single frame into preallocated memory, dst_size must be exactly the decompressed size
+	bool Decompress(const uint8_t* src_data, size_t src_size, uint8_t* dst_data, size_t dst_size);
 
 	// Returns file path if successful, empty string otherwise
 	std::string screenshot(const vz::graphics::SwapChain& swapchain, const std::string& name = "");
@@ -2,6 +2,9 @@
 #include "Backlog.h"
 #include "Platform.h"
 #include "Timer.h"
+#include "Allocator.h"
+#include "Spinlock.h"
+#include "Profiler.h"
 
 #include "CommonInclude.h"
 
@@ -13,6 +16,8 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <new>
 
 #ifdef PLATFORM_LINUX
 #include <pthread.h>
@@ -20,66 +25,199 @@
 
 namespace vz::jobsystem
 {
-	struct Job
+	// Heap allocations made by the job system, see GetHeapAllocationCount()
+	static std::atomic<uint64_t> heapAllocationCount{ 0 };
+
+	// Task state shared by all groups of one Execute/Dispatch call
+	//	The task is stored once per call instead of once per group, the last finishing group releases it
+	struct JobTask
 	{
-		std::function<void(JobArgs)> task;
+		Task task;
 		context* ctx = nullptr;
-		contextConcurrency* ctxConcurrency = nullptr;
-		uint32_t groupID = 0;
-		uint32_t groupJobOffset = 0;
-		uint32_t groupJobEnd = 0;
+		uint32_t jobCount = 0;
+		uint32_t groupSize = 0;
 		uint32_t sharedmemory_size = 0;
-		uint32_t concurrentID = 0;
+		std::atomic<uint32_t> remainingGroups{ 0 };
+		TaskGraph* graph = nullptr; // if the task is a TaskGraph node, the graph is notified when all groups finished
+		TaskGraph::NodeID graphNode = 0;
+	};
 
-		inline void execute()
+	// JobTasks are pooled, so that submitting jobs doesn't touch the heap after warm-up
+	//	Every thread takes tasks from and releases them into its own magazine (see allocator::ThreadMagazine),
+	//	the lock is only taken to exchange a whole batch, so submitters and completing workers don't serialize on it.
+	//	Cached tasks stay constructed (with an empty callable), the global free list holds destructed ones.
+	struct JobTaskPool
+	{
+		allocator::BlockAllocator<JobTask, 256> blockAllocator;
+		vz::SpinLock locker;
+
+		inline JobTask* allocate(Task&& task);
+		inline void free(JobTask* jobTask);
+
+		void refill(allocator::ThreadMagazine& magazine)
 		{
-			static std::atomic<int> max_ctx_counter = 0;
-			static std::mutex locker;
+			std::scoped_lock lock(locker);
+			for (uint32_t i = 0; i < allocator::ThreadMagazine::batch; ++i)
 			{
-				std::scoped_lock lock(locker);
-				if (ctx->counter > max_ctx_counter.load())
+				if (blockAllocator.free_list.empty())
 				{
-					backlog::post("Increases the capacity of job queues to " + std::to_string(ctx->counter), LogLevel::Info);
-					max_ctx_counter = ctx->counter;
+					heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
 				}
+				magazine.items[magazine.count++] = blockAllocator.allocate();
 			}
-
-			JobArgs args;
-			args.groupID = groupID;
-			if (sharedmemory_size > 0)
+		}
+		void flush(allocator::ThreadMagazine& magazine, uint32_t count)
+		{
+			std::scoped_lock lock(locker);
+			for (uint32_t i = 0; i < count; ++i)
 			{
-				args.sharedmemory = _malloca(sharedmemory_size);
-				//args.sharedmemory = alloca(sharedmemory_size);
+				blockAllocator.free((JobTask*)magazine.items[i]);
 			}
-			else
+			magazine.count -= count;
+			std::copy(magazine.items + count, magazine.items + count + magazine.count, magazine.items);
+		}
+	};
+	static JobTaskPool& jobTaskPool = *new JobTaskPool; // only destroyed after program exit, threads can still flush their magazines until then
+
+	struct JobTaskMagazine : allocator::ThreadMagazine
+	{
+		~JobTaskMagazine()
+		{
+			jobTaskPool.flush(*this, count);
+		}
+	};
+	static thread_local JobTaskMagazine tls_jobTaskMagazine;
+
+	inline JobTask* JobTaskPool::allocate(Task&& task)
+	{
+		if (task.IsHeapAllocated())
+		{
+			heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		JobTaskMagazine& magazine = tls_jobTaskMagazine;
+		if (magazine.count == 0)
+		{
+			refill(magazine);
+		}
+		JobTask* jobTask = (JobTask*)magazine.items[--magazine.count];
+		jobTask->task = std::move(task);
+		jobTask->graph = nullptr;
+		return jobTask;
+	}
+	inline void JobTaskPool::free(JobTask* jobTask)
+	{
+		// The callable (and its captures) is destructed right away, the task can be released on any thread:
+		jobTask->task.reset();
+		JobTaskMagazine& magazine = tls_jobTaskMagazine;
+		if (magazine.count == allocator::ThreadMagazine::capacity)
+		{
+			// Full, hand the older half back to the global free list:
+			flush(magazine, allocator::ThreadMagazine::batch);
+		}
+		magazine.items[magazine.count++] = jobTask;
+	}
+
+	// Per-thread scratch memory backing JobArgs::sharedmemory
+	//	Linear allocator with 64-byte aligned allocations, the group's allocation is released when the group finishes.
+	//	Groups can nest (a job can Wait() and execute other jobs on the same thread), so releases are stack ordered.
+	struct ScratchArena
+	{
+		static constexpr size_t ALIGNMENT = 64;
+		static constexpr size_t INITIAL_CAPACITY = 64 * 1024;
+
+		uint8_t* memory = nullptr;
+		size_t capacity = 0;
+		size_t offset = 0;
+
+		~ScratchArena()
+		{
+			if (memory != nullptr)
 			{
-				args.sharedmemory = nullptr;
+				::operator delete(memory, std::align_val_t(ALIGNMENT));
 			}
+		}
 
-			for (uint32_t j = groupJobOffset; j < groupJobEnd; ++j)
+		inline void* allocate(size_t size)
+		{
+			size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+			if (offset + size > capacity)
 			{
-				args.jobIndex = j;
-				args.groupIndex = j - groupJobOffset;
-				args.isFirstJobInGroup = (j == groupJobOffset);
-				args.isLastJobInGroup = (j == groupJobEnd - 1);
-				task(args);
+				if (offset > 0)
+				{
+					// Outer groups still use the arena, it can't be moved; this group gets its own block:
+					heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+					return ::operator new(size, std::align_val_t(ALIGNMENT));
+				}
+				if (memory != nullptr)
+				{
+					::operator delete(memory, std::align_val_t(ALIGNMENT));
+				}
+				capacity = std::max(std::max(capacity * 2, INITIAL_CAPACITY), size);
+				memory = (uint8_t*)::operator new(capacity, std::align_val_t(ALIGNMENT));
+				heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
 			}
-
-			if (args.sharedmemory)
+			void* ptr = memory + offset;
+			offset += size;
+			return ptr;
+		}
+		// marker is the offset before the allocation was made
+		inline void release(void* ptr, size_t marker)
+		{
+			if (ptr < memory || ptr >= memory + capacity)
 			{
-				_freea(args.sharedmemory);
+				::operator delete(ptr, std::align_val_t(ALIGNMENT));
+				return;
 			}
+			offset = marker;
+		}
+	};
+	static thread_local ScratchArena tls_scratchArena;
 
-			AtomicAdd(&ctx->counter, -1);
+	// One group of a JobTask
+	//	This is trivially copyable so that it can be stored in the lock-free work-stealing deque
+	struct Job
+	{
+		JobTask* jobTask = nullptr;
+		uint32_t groupID = 0;
+
+		// Timeline name of a task: the TaskGraph node name, or the fallback for plain Execute/Dispatch
+		static inline const char* traceName(const JobTask* jobTask, const char* fallback)
+		{
+			if (jobTask->graph != nullptr && jobTask->graph->nodes[jobTask->graphNode].name != nullptr)
+			{
+				return jobTask->graph->nodes[jobTask->graphNode].name;
+			}
+			return fallback;
 		}
 
-		inline void executeConcurrent()
+		inline void execute()
 		{
+			context* ctx = jobTask->ctx;
+			const bool tracing = profiler::IsTraceCapturingInline();
+			const uint64_t trace_begin = tracing ? profiler::TraceTimestamp() : 0;
+
+			// Diagnostic only, so it doesn't need to be exact; the thread that raises the maximum reports it:
+			static std::atomic<long> max_ctx_counter{ 0 };
+			const long ctx_counter = AtomicLoad(&ctx->counter);
+			long max_counter = max_ctx_counter.load(std::memory_order_relaxed);
+			while (ctx_counter > max_counter)
+			{
+				if (max_ctx_counter.compare_exchange_weak(max_counter, ctx_counter, std::memory_order_relaxed))
+				{
+					backlog::post("Increases the capacity of job queues to " + std::to_string(ctx_counter), LogLevel::Info);
+					break;
+				}
+			}
+
+			const uint32_t groupJobOffset = groupID * jobTask->groupSize;
+			const uint32_t groupJobEnd = std::min(groupJobOffset + jobTask->groupSize, jobTask->jobCount);
+
 			JobArgs args;
 			args.groupID = groupID;
-			if (sharedmemory_size > 0)
+			const size_t scratch_marker = tls_scratchArena.offset;
+			if (jobTask->sharedmemory_size > 0)
 			{
-				args.sharedmemory = _malloca(sharedmemory_size);
+				args.sharedmemory = tls_scratchArena.allocate(jobTask->sharedmemory_size);
 			}
 			else
 			{
@@ -92,52 +230,185 @@ namespace vz::jobsystem
 				args.groupIndex = j - groupJobOffset;
 				args.isFirstJobInGroup = (j == groupJobOffset);
 				args.isLastJobInGroup = (j == groupJobEnd - 1);
-				task(args);
+				jobTask->task(args);
+			}
+
+			if (tracing)
+			{
+				profiler::TraceEvent(traceName(jobTask, "Job"), profiler::TraceCategory::Job, trace_begin, profiler::TraceTimestamp(), groupID);
 			}
 
 			if (args.sharedmemory)
 			{
-				_freea(args.sharedmemory);
+				tls_scratchArena.release(args.sharedmemory, scratch_marker);
 			}
+
+			// The task must be released before the context is signaled, the waiting thread may destroy captured state right after
+			TaskGraph* graph = jobTask->graph;
+			const TaskGraph::NodeID graphNode = jobTask->graphNode;
+			if (jobTask->remainingGroups.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				jobTaskPool.free(jobTask);
+				if (graph != nullptr)
+				{
+					// Launches the successor nodes before this group signals the context:
+					graph->finish(graphNode);
+				}
+			}
+			jobTask = nullptr;
+
+			AtomicAdd(&ctx->counter, -1);
+		}
+	};
+
+	// Jobs of ExecuteConcurrency(), these are kept in a separate latest-only queue
+	struct ConcurrentJob
+	{
+		std::function<void(JobArgs)> task;
+		contextConcurrency* ctxConcurrency = nullptr;
+		uint32_t concurrentID = 0;
+
+		inline void executeConcurrent()
+		{
+			JobArgs args;
+			args.groupID = 0;
+			args.jobIndex = 0;
+			args.groupIndex = 0;
+			args.isFirstJobInGroup = true;
+			args.isLastJobInGroup = true;
+			args.sharedmemory = nullptr;
+			task(args);
 		}
 	};
+
+	// Bounded Chase-Lev work-stealing deque (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models")
+	//	Only the owner thread pushes and pops at the bottom (LIFO), any other thread steals from the top (FIFO)
+	//	When the ring is full, jobs spill into a mutex-guarded overflow queue that any thread can access
 	struct JobQueue
 	{
-		std::deque<Job> queue;
-		std::mutex locker;
+		static constexpr int64_t CAPACITY = 2048; // must be power of two
+		static constexpr int64_t MASK = CAPACITY - 1;
 
+		// Slots are read by thieves concurrently with the owner, so the fields are atomics (relaxed).
+		//	A torn read can only happen when the thief loses the CAS on top, and in that case it is discarded
+		struct Slot
+		{
+			std::atomic<JobTask*> jobTask{ nullptr };
+			std::atomic<uint32_t> groupID{ 0 };
+		};
+
+		alignas(64) std::atomic<int64_t> top{ 0 };
+		alignas(64) std::atomic<int64_t> bottom{ 0 };
+		alignas(64) std::atomic<uint32_t> overflowCount{ 0 };
+		std::unique_ptr<Slot[]> ring{ new Slot[CAPACITY] };
+		std::deque<Job> overflow;
+		std::mutex overflowLocker;
+
+		// Owner thread only
 		inline void push_back(const Job& item)
 		{
-			std::scoped_lock lock(locker);
-			queue.push_back(item);
+			const int64_t b = bottom.load(std::memory_order_relaxed);
+			const int64_t t = top.load(std::memory_order_acquire);
+			if (b - t >= CAPACITY)
+			{
+				push_overflow(item);
+				return;
+			}
+			Slot& slot = ring[b & MASK];
+			slot.jobTask.store(item.jobTask, std::memory_order_relaxed);
+			slot.groupID.store(item.groupID, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
 		}
-		inline bool pop_front(Job& item)
+		// Owner thread only
+		inline bool pop_back(Job& item)
 		{
-			std::scoped_lock lock(locker);
-			if (queue.empty())
+			const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			int64_t t = top.load(std::memory_order_relaxed);
+			if (t <= b)
+			{
+				Slot& slot = ring[b & MASK];
+				item.jobTask = slot.jobTask.load(std::memory_order_relaxed);
+				item.groupID = slot.groupID.load(std::memory_order_relaxed);
+				if (t == b)
+				{
+					// Last item, race against thieves:
+					const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+					bottom.store(b + 1, std::memory_order_relaxed);
+					if (!won)
+					{
+						return pop_overflow(item);
+					}
+				}
+				return true;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return pop_overflow(item);
+		}
+		// Any thread
+		//	contended is set when the item was lost to an other thread, so the queue might still be non-empty
+		inline bool steal(Job& item, bool& contended)
+		{
+			int64_t t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const int64_t b = bottom.load(std::memory_order_acquire);
+			if (t < b)
 			{
+				Slot& slot = ring[t & MASK];
+				item.jobTask = slot.jobTask.load(std::memory_order_relaxed);
+				item.groupID = slot.groupID.load(std::memory_order_relaxed);
+				if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				{
+					return true;
+				}
+				contended = true;
 				return false;
 			}
-			item = std::move(queue.front());
-			queue.pop_front();
+			return pop_overflow(item);
+		}
+
+		// Any thread
+		inline void push_overflow(const Job& item)
+		{
+			heapAllocationCount.fetch_add(1, std::memory_order_relaxed); // the overflow deque can allocate
+			std::scoped_lock lock(overflowLocker);
+			overflow.push_back(item);
+			overflowCount.fetch_add(1, std::memory_order_release);
+		}
+		inline bool pop_overflow(Job& item)
+		{
+			if (overflowCount.load(std::memory_order_acquire) == 0)
+			{
+				return false;
+			}
+			std::scoped_lock lock(overflowLocker);
+			if (overflow.empty())
+			{
+				return false;
+			}
+			item = overflow.front();
+			overflow.pop_front();
+			overflowCount.fetch_sub(1, std::memory_order_release);
 			return true;
 		}
 	};
 
 	struct JobConcurrentQueue
 	{
-		std::unordered_map<uint32_t, std::deque<Job>> mapQueue;
+		std::unordered_map<uint32_t, std::deque<ConcurrentJob>> mapQueue;
 		std::mutex locker;
 
 		int MAX_QUEUE = 5;
 
 		inline static std::atomic_int max_concurrent_queue_count = 0u;
 
-		inline void push_back(const Job& item, const uint32_t concurrentID)
+		inline void push_back(const ConcurrentJob& item, const uint32_t concurrentID)
 		{
 			std::scoped_lock lock(locker);
 
-			std::deque<Job>& queue = mapQueue[concurrentID];
+			std::deque<ConcurrentJob>& queue = mapQueue[concurrentID];
 			queue.push_back(item);
 			if (max_concurrent_queue_count.load() < queue.size())
 			{
@@ -149,7 +420,7 @@ namespace vz::jobsystem
 				queue.pop_front();
 			}
 		}
-		inline bool pop_back(Job& item)
+		inline bool pop_back(ConcurrentJob& item)
 		{
 			std::scoped_lock lock(locker);
 
@@ -157,7 +428,7 @@ namespace vz::jobsystem
 			auto it = mapQueue.begin();
 			for (; it != mapQueue.end(); it++)
 			{
-				std::deque<Job>& queue = it->second;
+				std::deque<ConcurrentJob>& queue = it->second;
 				if (queue.empty())
 				{
 					continue;
@@ -175,42 +446,155 @@ namespace vz::jobsystem
 		}
 	};
 
+	// Maximum number of non-worker threads (main thread, other priority workers, loaders, ...) that can own a job queue per priority at the same time
+	//	A thread gives its queue back when it exits and the next submitter thread reuses it,
+	//	further concurrent submitter threads push into the overflow queues instead
+	static constexpr uint32_t MAX_EXTERNAL_QUEUES = 8;
+
+	// Which job queue the current thread owns for a priority, only valid when matching the resource generation
+	struct QueueBinding
+	{
+		uint32_t generation = 0;
+		uint32_t queueIndex = ~0u;
+	};
+	struct QueueBindings
+	{
+		QueueBinding priorities[int(Priority::Count)];
+		~QueueBindings(); // gives the external queues back, defined after internal_state
+	};
+	static thread_local QueueBindings tls_queueBindings;
+
 	struct PriorityResources
 	{
+		inline static std::atomic<uint32_t> generationCounter{ 0 };
+
+		Priority priority = Priority::High;
+		uint32_t generation = 0;
 		uint32_t numThreads = 0;
+		uint32_t maxQueues = 0;
+		std::atomic<uint32_t> numQueues{ 0 }; // high-water mark of used queues, a released queue stays visible to stealers while it still has jobs
+		std::atomic<uint32_t> externalQueueMask{ 0 }; // bit i is set while external queue (numThreads + i) is owned by a thread
 		std::vector<std::thread> threads;
-		std::unique_ptr<JobQueue[]> jobQueuePerThread;
+		std::unique_ptr<JobQueue[]> jobQueuePerThread; // [0, numThreads) are owned by workers, the rest by external submitter threads
 		std::unique_ptr<JobConcurrentQueue> jobConcurrentQueue; // all threads can access
 		std::atomic<uint32_t> nextQueue{ 0 };
 		std::condition_variable wakeCondition;
 		std::mutex wakeMutex;
 
-		// Start working on a job queue
-		//	After the job queue is finished, it can switch to an other queue and steal jobs from there
-		inline void work(uint32_t startingQueue)
+		inline void bindWorker(uint32_t threadID)
+		{
+			tls_queueBindings.priorities[int(priority)] = { generation, threadID };
+		}
+
+		// Returns the job queue owned by the calling thread, registering one if needed
+		//	Returns ~0u if the thread could not get a queue
+		inline uint32_t getQueueIndex()
+		{
+			QueueBinding& binding = tls_queueBindings.priorities[int(priority)];
+			if (binding.generation == generation)
+			{
+				return binding.queueIndex;
+			}
+			binding.generation = generation;
+			binding.queueIndex = ~0u;
+			constexpr uint32_t full_mask = (1u << MAX_EXTERNAL_QUEUES) - 1;
+			uint32_t mask = externalQueueMask.load(std::memory_order_relaxed);
+			while ((mask & full_mask) != full_mask)
+			{
+				uint32_t slot = 0;
+				while (mask & (1u << slot))
+				{
+					slot++;
+				}
+				// acquire: a reused queue can still hold jobs that its previous owner pushed
+				if (externalQueueMask.compare_exchange_weak(mask, mask | (1u << slot), std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					binding.queueIndex = numThreads + slot;
+					uint32_t queueCount = numQueues.load(std::memory_order_relaxed);
+					while (queueCount <= binding.queueIndex && !numQueues.compare_exchange_weak(queueCount, binding.queueIndex + 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {}
+					break;
+				}
+			}
+			return binding.queueIndex;
+		}
+
+		// Gives the external queue of an exiting thread back, jobs left in it are still stolen by the workers
+		inline void releaseQueue(QueueBinding& binding)
+		{
+			if (binding.generation == generation && binding.queueIndex >= numThreads && binding.queueIndex < maxQueues)
+			{
+				externalQueueMask.fetch_and(~(1u << (binding.queueIndex - numThreads)), std::memory_order_release);
+			}
+			binding = {};
+		}
+
+		inline void push(const Job& job)
+		{
+			const uint32_t queueIndex = getQueueIndex();
+			if (queueIndex < maxQueues)
+			{
+				jobQueuePerThread[queueIndex].push_back(job);
+			}
+			else
+			{
+				jobQueuePerThread[nextQueue.fetch_add(1) % numThreads].push_overflow(job);
+			}
+		}
+
+		inline bool steal(uint32_t startingQueue, Job& job, uint32_t& victim)
+		{
+			const uint32_t queueCount = numQueues.load(std::memory_order_acquire);
+			bool contended;
+			do
+			{
+				contended = false;
+				for (uint32_t i = 0; i < queueCount; ++i)
+				{
+					victim = (startingQueue + i) % queueCount;
+					if (jobQueuePerThread[victim].steal(job, contended))
+					{
+						return true;
+					}
+				}
+			} while (contended);
+			return false;
+		}
+
+		// Start working on the calling thread's own job queue
+		//	After the own queue is finished, it steals jobs from the other queues
+		inline void work()
 		{
+			const uint32_t queueIndex = getQueueIndex();
+			const bool ownsQueue = queueIndex < maxQueues;
+			const uint32_t startingQueue = ownsQueue ? queueIndex + 1 : nextQueue.fetch_add(1);
+
 			Job job;
-			for (uint32_t i = 0; i < numThreads; ++i)
+			uint32_t victim = 0;
+			while (true)
 			{
-				uint32_t thread_id = startingQueue % numThreads;
-				JobQueue& job_queue = jobQueuePerThread[thread_id];
-				while (job_queue.pop_front(job))
+				if (ownsQueue && jobQueuePerThread[queueIndex].pop_back(job))
 				{
 					job.execute();
+					continue;
 				}
-
-				//JobConcurrentQueue& job_concurrent_queue = jobConcurrentQueuePerThread[thread_id];
-				//while (job_concurrent_queue.pop_back(job))
-				//{
-				//	job.executeConcurrent();
-				//}
-				startingQueue++; // go to next queue
+				if (steal(startingQueue, job, victim))
+				{
+					if (profiler::IsTraceCapturingInline())
+					{
+						const uint64_t now = profiler::TraceTimestamp();
+						profiler::TraceEvent("Steal", profiler::TraceCategory::Steal, now, now, victim);
+					}
+					job.execute();
+					continue;
+				}
+				break;
 			}
 
 			// while executing the popped job, other threads can steal the remaining jobs
-			while (jobConcurrentQueue->pop_back(job))
+			ConcurrentJob concurrentJob;
+			while (jobConcurrentQueue->pop_back(concurrentJob))
 			{
-				job.executeConcurrent();
+				concurrentJob.executeConcurrent();
 			}
 		}
 	};
@@ -236,6 +620,9 @@ namespace vz::jobsystem
 				x.jobConcurrentQueue.reset();
 				x.threads.clear();
 				x.numThreads = 0;
+				x.maxQueues = 0;
+				x.numQueues.store(0);
+				x.externalQueueMask.store(0);
 			}
 			numCores = 0;
 		}
@@ -263,6 +650,14 @@ namespace vz::jobsystem
 		}
 	} static internal_state;
 
+	QueueBindings::~QueueBindings()
+	{
+		for (int prio = 0; prio < int(Priority::Count); ++prio)
+		{
+			internal_state.resources[prio].releaseQueue(priorities[prio]);
+		}
+	}
+
 	void Initialize(uint32_t maxThreadCount)
 	{
 		ShutDown();
@@ -298,7 +693,12 @@ namespace vz::jobsystem
 				break;
 			}
 			res.numThreads = clamp(res.numThreads, 1u, maxThreadCount);
-			res.jobQueuePerThread.reset(new JobQueue[res.numThreads]);
+			res.priority = priority;
+			res.generation = PriorityResources::generationCounter.fetch_add(1) + 1; // invalidates queue bindings of a previous initialization
+			res.maxQueues = res.numThreads + MAX_EXTERNAL_QUEUES;
+			res.numQueues.store(res.numThreads);
+			res.externalQueueMask.store(0);
+			res.jobQueuePerThread.reset(new JobQueue[res.maxQueues]);
 			res.jobConcurrentQueue.reset(new JobConcurrentQueue);
 			res.threads.reserve(res.numThreads);
 
@@ -331,9 +731,15 @@ namespace vz::jobsystem
 #else
 				std::thread& worker = res.threads.emplace_back([threadID, &res] {
 #endif
+					res.bindWorker(threadID);
+					{
+						const char* prefix = res.priority == Priority::High ? "vz::job_" : res.priority == Priority::Low ? "vz::job_lo_" : "vz::job_st_";
+						profiler::SetTraceThreadName((prefix + std::to_string(threadID)).c_str());
+					}
+
 					while (internal_state.alive.load())
 					{
-						res.work(threadID);
+						res.work();
 
 						// finished with jobs, put to sleep
 						std::unique_lock<std::mutex> lock(res.wakeMutex);
@@ -453,7 +859,44 @@ namespace vz::jobsystem
 		return internal_state.resources[int(priority)].numThreads;
 	}
 
-	void Execute(context& ctx, const std::function<void(JobArgs)>& task)
+	// Generates one real job for each group of the task
+	//	The context counter must have been increased by groupCount already
+	inline void SubmitGroups(PriorityResources& res, JobTask* jobTask, uint32_t groupCount)
+	{
+		const bool tracing = profiler::IsTraceCapturingInline();
+		const uint64_t trace_begin = tracing ? profiler::TraceTimestamp() : 0;
+		const char* trace_name = tracing ? Job::traceName(jobTask, "Dispatch") : nullptr; // before the groups can release the task
+
+		Job job;
+		for (uint32_t groupID = 0; groupID < groupCount; ++groupID)
+		{
+			job.jobTask = jobTask;
+			job.groupID = groupID;
+
+			if (res.numThreads < 1)
+			{
+				// If job system is not yet initialized, job will be executed immediately here instead of thread:
+				job.execute();
+			}
+			else
+			{
+				// Pushed to the bottom of this thread's own queue, idle workers steal from the top
+				res.push(job);
+			}
+		}
+
+		if (res.numThreads > 1)
+		{
+			res.wakeCondition.notify_all();
+		}
+
+		if (tracing)
+		{
+			profiler::TraceEvent(trace_name, profiler::TraceCategory::Dispatch, trace_begin, profiler::TraceTimestamp(), groupCount);
+		}
+	}
+
+	void Execute(context& ctx, Task&& task)
 	{
 		vzlog_assert(ctx.IsAvailable(), "CRITICAL JOBSYSTEM MISUSE!: Invalid context passed to jobsystem API");
 
@@ -463,12 +906,13 @@ namespace vz::jobsystem
 		AtomicAdd(&ctx.counter, 1);
 
 		Job job;
-		job.ctx = &ctx;
-		job.task = task;
+		job.jobTask = jobTaskPool.allocate(std::move(task));
+		job.jobTask->ctx = &ctx;
+		job.jobTask->jobCount = 1;
+		job.jobTask->groupSize = 1;
+		job.jobTask->sharedmemory_size = 0;
+		job.jobTask->remainingGroups.store(1, std::memory_order_relaxed);
 		job.groupID = 0;
-		job.groupJobOffset = 0;
-		job.groupJobEnd = 1;
-		job.sharedmemory_size = 0;
 
 		if (res.numThreads < 1)
 		{
@@ -477,9 +921,22 @@ namespace vz::jobsystem
 			return;
 		}
 
-		res.jobQueuePerThread[res.nextQueue.fetch_add(1) % res.numThreads].push_back(job);
+		const bool tracing = profiler::IsTraceCapturingInline();
+		const uint64_t trace_begin = tracing ? profiler::TraceTimestamp() : 0;
+
+		res.push(job);
 
 		res.wakeCondition.notify_one();
+
+		if (tracing)
+		{
+			profiler::TraceEvent("Execute", profiler::TraceCategory::Dispatch, trace_begin, profiler::TraceTimestamp(), 1);
+		}
+	}
+
+	void Execute(context& ctx, const std::function<void(JobArgs)>& task)
+	{
+		Execute(ctx, Task(task));
 	}
 
 	void ExecuteConcurrency(contextConcurrency& ctx, const std::function<void(JobArgs)>& task)
@@ -488,13 +945,9 @@ namespace vz::jobsystem
 
 		PriorityResources& res = internal_state.resources[int(Priority::Low)];
 
-		Job job;
+		ConcurrentJob job;
 		job.ctxConcurrency = &ctx;
 		job.task = task;
-		job.groupID = 0;
-		job.groupJobOffset = 0;
-		job.groupJobEnd = 1;
-		job.sharedmemory_size = 0;
 		job.concurrentID = ctx.concurrentID;
 
 		if (res.numThreads < 1)
@@ -510,7 +963,7 @@ namespace vz::jobsystem
 		res.wakeCondition.notify_one();
 	}
 
-	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& task, size_t sharedmemory_size)
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, Task&& task, size_t sharedmemory_size)
 	{
 		vzlog_assert(ctx.IsAvailable(), "CRITICAL JOBSYSTEM MISUSE!: Invalid context passed to jobsystem API");
 
@@ -525,33 +978,20 @@ namespace vz::jobsystem
 		// Context state is updated:
 		AtomicAdd(&ctx.counter, groupCount);
 
-		Job job;
-		job.ctx = &ctx;
-		job.task = task;
-		job.sharedmemory_size = (uint32_t)sharedmemory_size;
-
-		for (uint32_t groupID = 0; groupID < groupCount; ++groupID)
-		{
-			// For each group, generate one real job:
-			job.groupID = groupID;
-			job.groupJobOffset = groupID * groupSize;
-			job.groupJobEnd = std::min(job.groupJobOffset + groupSize, jobCount);
+		// The task is shared by all groups:
+		JobTask* jobTask = jobTaskPool.allocate(std::move(task));
+		jobTask->ctx = &ctx;
+		jobTask->jobCount = jobCount;
+		jobTask->groupSize = groupSize;
+		jobTask->sharedmemory_size = (uint32_t)sharedmemory_size;
+		jobTask->remainingGroups.store(groupCount, std::memory_order_relaxed);
 
-			if (res.numThreads < 1)
-			{
-				// If job system is not yet initialized, job will be executed immediately here instead of thread:
-				job.execute();
-			}
-			else
-			{
-				res.jobQueuePerThread[res.nextQueue.fetch_add(1) % res.numThreads].push_back(job);
-			}
-		}
+		SubmitGroups(res, jobTask, groupCount);
+	}
 
-		if (res.numThreads > 1)
-		{
-			res.wakeCondition.notify_all();
-		}
+	void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& task, size_t sharedmemory_size)
+	{
+		Dispatch(ctx, jobCount, groupSize, Task(task), sharedmemory_size);
 	}
 
 	uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize)
@@ -574,12 +1014,14 @@ namespace vz::jobsystem
 		if (IsBusy(ctx))
 		{
 			PriorityResources& res = internal_state.resources[int(ctx.priority)];
+			const bool tracing = profiler::IsTraceCapturingInline();
+			const uint64_t trace_begin = tracing ? profiler::TraceTimestamp() : 0;
 
 			// Wake any threads that might be sleeping:
 			res.wakeCondition.notify_all();
 
 			// work() will pick up any jobs that are on stand by and execute them on this thread:
-			res.work(res.nextQueue.fetch_add(1) % res.numThreads);
+			res.work();
 
 			while (IsBusy(ctx))
 			{
@@ -589,6 +1031,11 @@ namespace vz::jobsystem
 				//	Allow to swap out this thread by OS to not spin endlessly for nothing
 				std::this_thread::yield();
 			}
+
+			if (tracing)
+			{
+				profiler::TraceEvent("Wait", profiler::TraceCategory::Wait, trace_begin, profiler::TraceTimestamp());
+			}
 		}
 	}
 
@@ -615,10 +1062,16 @@ namespace vz::jobsystem
 
 		// Passive waiting: do not execute queued jobs on this thread.
 		// Yield CPU while other workers drain the queue for this context.
+		const bool tracing = profiler::IsTraceCapturingInline();
+		const uint64_t trace_begin = tracing ? profiler::TraceTimestamp() : 0;
 		while (IsBusy(ctx))
 		{
 			std::this_thread::yield();
 		}
+		if (tracing)
+		{
+			profiler::TraceEvent("Wait", profiler::TraceCategory::Wait, trace_begin, profiler::TraceTimestamp());
+		}
 	}
 
 	void WaitAllJobs()
@@ -630,4 +1083,147 @@ namespace vz::jobsystem
 			internal_state.alive.store(true);
 		}
 	}
+
+	static inline int64_t GetTimestampNS()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	TaskGraph::NodeID TaskGraph::AddNode(const char* name, uint32_t jobCount, uint32_t groupSize, Task&& task, size_t sharedmemory_size)
+	{
+		Node& node = nodes.emplace_back();
+		node.name = name;
+		node.jobCount = jobCount;
+		node.groupSize = groupSize;
+		node.sharedmemory_size = sharedmemory_size;
+		node.task = std::move(task);
+		return NodeID(nodes.size() - 1);
+	}
+
+	void TaskGraph::AddDependency(NodeID predecessor, NodeID successor)
+	{
+		assert(predecessor < nodes.size() && successor < nodes.size() && predecessor != successor);
+		nodes[predecessor].successors.push_back(successor);
+		nodes[successor].predecessorCount++;
+	}
+
+	void TaskGraph::Run(context& ctx)
+	{
+		vzlog_assert(ctx.IsAvailable(), "CRITICAL JOBSYSTEM MISUSE!: Invalid context passed to jobsystem API");
+
+		const size_t nodeCount = nodes.size();
+		if (nodeCount == 0)
+		{
+			return;
+		}
+		if (pendingCapacity < nodeCount)
+		{
+			pendingPredecessors.reset(new std::atomic<uint32_t>[nodeCount]);
+			pendingCapacity = nodeCount;
+		}
+		for (size_t i = 0; i < nodeCount; ++i)
+		{
+			pendingPredecessors[i].store(nodes[i].predecessorCount, std::memory_order_relaxed);
+			nodes[i].gatingPredecessor = ~0u;
+		}
+		this->ctx = &ctx;
+		runTime = GetTimestampNS();
+
+		// Every node holds the context until it finished, so the context can't be signaled between nodes:
+		AtomicAdd(&ctx.counter, (long)nodeCount);
+
+		// Launch roots (the static predecessor count is checked, launched nodes are already modifying the pending counters):
+		bool hasRoot = false;
+		for (size_t i = 0; i < nodeCount; ++i)
+		{
+			if (nodes[i].predecessorCount == 0)
+			{
+				hasRoot = true;
+				launch(NodeID(i));
+			}
+		}
+		vzlog_assert(hasRoot, "TaskGraph has no root node (cyclic dependency)!");
+	}
+
+	void TaskGraph::Clear()
+	{
+		assert(ctx == nullptr || !IsBusy(*ctx));
+		nodes.clear();
+		ctx = nullptr;
+	}
+
+	void TaskGraph::launch(NodeID id)
+	{
+		Node& node = nodes[id];
+		node.beginTime = GetTimestampNS();
+		if (node.jobCount == 0 || node.groupSize == 0)
+		{
+			node.task.reset();
+			finish(id);
+			return;
+		}
+
+		PriorityResources& res = internal_state.resources[int(ctx->priority)];
+		const uint32_t groupCount = DispatchGroupCount(node.jobCount, node.groupSize);
+		AtomicAdd(&ctx->counter, groupCount);
+
+		JobTask* jobTask = jobTaskPool.allocate(std::move(node.task));
+		jobTask->ctx = ctx;
+		jobTask->jobCount = node.jobCount;
+		jobTask->groupSize = node.groupSize;
+		jobTask->sharedmemory_size = (uint32_t)node.sharedmemory_size;
+		jobTask->remainingGroups.store(groupCount, std::memory_order_relaxed);
+		jobTask->graph = this;
+		jobTask->graphNode = id;
+
+		SubmitGroups(res, jobTask, groupCount);
+	}
+
+	void TaskGraph::finish(NodeID id)
+	{
+		Node& node = nodes[id];
+		node.endTime = GetTimestampNS();
+		context* run_ctx = ctx; // the graph may be destroyed once the context is signaled
+		for (NodeID successor : node.successors)
+		{
+			if (pendingPredecessors[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				nodes[successor].gatingPredecessor = id;
+				launch(successor);
+			}
+		}
+		AtomicAdd(&run_ctx->counter, -1);
+	}
+
+	void TaskGraph::GetCriticalPath(std::vector<PathNode>& path) const
+	{
+		path.clear();
+		if (nodes.empty() || ctx == nullptr)
+		{
+			return;
+		}
+		NodeID id = 0;
+		for (NodeID i = 1; i < (NodeID)nodes.size(); ++i)
+		{
+			if (nodes[i].endTime > nodes[id].endTime)
+			{
+				id = i;
+			}
+		}
+		while (id != ~0u)
+		{
+			const Node& node = nodes[id];
+			PathNode& path_node = path.emplace_back();
+			path_node.name = node.name;
+			path_node.begin = float(double(node.beginTime - runTime) * 1e-6);
+			path_node.end = float(double(node.endTime - runTime) * 1e-6);
+			id = node.gatingPredecessor;
+		}
+		std::reverse(path.begin(), path.end());
+	}
+
+	uint64_t GetHeapAllocationCount()
+	{
+		return heapAllocationCount.load(std::memory_order_relaxed);
+	}
 }
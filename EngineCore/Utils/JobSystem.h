@@ -2,6 +2,12 @@
 
 #include <functional>
 #include <atomic>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <memory>
 
 #ifndef UTIL_EXPORT
 #ifdef _WIN32
@@ -40,6 +46,101 @@ namespace vz::jobsystem
 		Count
 	};
 
+	// Move-only, type-erased job task with small-buffer storage
+	//	Callables up to INLINE_SIZE bytes (e.g. lambdas capturing a few references) are stored in place,
+	//	so submitting them doesn't allocate. Larger callables fall back to the heap.
+	class Task
+	{
+	public:
+		static constexpr size_t INLINE_SIZE = 64;
+
+		Task() = default;
+		template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+		Task(F&& fn)
+		{
+			using Fn = std::decay_t<F>;
+			if constexpr (sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<Fn>)
+			{
+				new (storage) Fn(std::forward<F>(fn));
+				invoker = [](void* target, JobArgs args) { (*static_cast<Fn*>(target))(args); };
+				manager = [](Operation op, void* dst, void* src) {
+					Fn* fn_src = static_cast<Fn*>(src);
+					if (op == Operation::Move)
+					{
+						new (dst) Fn(std::move(*fn_src));
+					}
+					fn_src->~Fn();
+				};
+			}
+			else
+			{
+				*reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(fn));
+				invoker = [](void* target, JobArgs args) { (**static_cast<Fn**>(target))(args); };
+				manager = [](Operation op, void* dst, void* src) {
+					if (op == Operation::Move)
+					{
+						*static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+					}
+					else
+					{
+						delete* static_cast<Fn**>(src);
+					}
+				};
+				heapAllocated = true;
+			}
+		}
+		Task(Task&& other) noexcept { moveFrom(other); }
+		Task& operator=(Task&& other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+				moveFrom(other);
+			}
+			return *this;
+		}
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+		~Task() { reset(); }
+
+		inline void operator()(JobArgs args) { invoker(storage, args); }
+		explicit operator bool() const { return invoker != nullptr; }
+		bool IsHeapAllocated() const { return heapAllocated; }
+
+		void reset()
+		{
+			if (manager != nullptr)
+			{
+				manager(Operation::Destroy, nullptr, storage);
+			}
+			invoker = nullptr;
+			manager = nullptr;
+			heapAllocated = false;
+		}
+
+	private:
+		enum class Operation { Move, Destroy };
+
+		alignas(std::max_align_t) uint8_t storage[INLINE_SIZE];
+		void (*invoker)(void* target, JobArgs args) = nullptr;
+		void (*manager)(Operation op, void* dst, void* src) = nullptr;
+		bool heapAllocated = false;
+
+		void moveFrom(Task& other)
+		{
+			if (other.manager != nullptr)
+			{
+				other.manager(Operation::Move, storage, other.storage);
+			}
+			invoker = other.invoker;
+			manager = other.manager;
+			heapAllocated = other.heapAllocated;
+			other.invoker = nullptr;
+			other.manager = nullptr;
+			other.heapAllocated = false;
+		}
+	};
+
 	// Defines a state of execution, can be waited on
 	struct context
 	{
@@ -62,7 +163,13 @@ namespace vz::jobsystem
 	UTIL_EXPORT uint32_t GetThreadCount(Priority priority = Priority::High);
 
 	// Add a task to execute asynchronously. Any idle thread will execute this.
+	UTIL_EXPORT void Execute(context& ctx, Task&& task);
 	UTIL_EXPORT void Execute(context& ctx, const std::function<void(JobArgs)>& task);
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+	inline void Execute(context& ctx, F&& task)
+	{
+		Execute(ctx, Task(std::forward<F>(task)));
+	}
 
 	UTIL_EXPORT void ExecuteConcurrency(contextConcurrency& ctx, const std::function<void(JobArgs)>& task);
 
@@ -70,7 +177,13 @@ namespace vz::jobsystem
 	//	jobCount	: how many jobs to generate for this task.
 	//	groupSize	: how many jobs to execute per thread. Jobs inside a group execute serially. It might be worth to increase for small jobs
 	//	task		: receives a JobArgs as parameter
+	UTIL_EXPORT void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, Task&& task, size_t sharedmemory_size = 0);
 	UTIL_EXPORT void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, const std::function<void(JobArgs)>& task, size_t sharedmemory_size = 0);
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+	inline void Dispatch(context& ctx, uint32_t jobCount, uint32_t groupSize, F&& task, size_t sharedmemory_size = 0)
+	{
+		Dispatch(ctx, jobCount, groupSize, Task(std::forward<F>(task)), sharedmemory_size);
+	}
 
 	// Returns the amount of job groups that will be created for a set number of jobs and group size
 	UTIL_EXPORT uint32_t DispatchGroupCount(uint32_t jobCount, uint32_t groupSize);
@@ -87,4 +200,74 @@ namespace vz::jobsystem
 	UTIL_EXPORT void WaitNoWork(const context& ctx);
 
 	UTIL_EXPORT void WaitAllJobs();
+
+	struct Job;
+
+	// Dependency graph of Dispatches
+	//	Each node is a Dispatch, edges are dependencies between them. A node is dispatched as soon as its
+	//	last predecessor has finished (from the thread that finished it), so there is no global wait between nodes.
+	//	Usage: AddNode()/AddDependency(), Run(ctx), then Wait(ctx). Nodes consume their task, so rebuild the graph per run.
+	//	The graph object must stay alive until the context is finished.
+	class TaskGraph
+	{
+	public:
+		using NodeID = uint32_t;
+
+		// Returns the ID of the new node, see Dispatch() for the parameters
+		UTIL_EXPORT NodeID AddNode(const char* name, uint32_t jobCount, uint32_t groupSize, Task&& task, size_t sharedmemory_size = 0);
+		template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Task>>>
+		inline NodeID AddNode(const char* name, uint32_t jobCount, uint32_t groupSize, F&& task, size_t sharedmemory_size = 0)
+		{
+			return AddNode(name, jobCount, groupSize, Task(std::forward<F>(task)), sharedmemory_size);
+		}
+
+		// The successor node will only start after the predecessor node has finished
+		UTIL_EXPORT void AddDependency(NodeID predecessor, NodeID successor);
+
+		// Starts every node without predecessors, the context stays busy until all nodes have finished
+		UTIL_EXPORT void Run(context& ctx);
+
+		// Removes all nodes (must not be running)
+		UTIL_EXPORT void Clear();
+
+		struct PathNode
+		{
+			const char* name = nullptr;
+			float begin = 0;	// milliseconds since Run()
+			float end = 0;		// milliseconds since Run()
+		};
+		// Chain of nodes that gated the last finished run: the node that finished last, then its last finishing predecessor, and so on
+		//	Returned in execution order. Only valid after the context of Run() has finished.
+		UTIL_EXPORT void GetCriticalPath(std::vector<PathNode>& path) const;
+
+		size_t GetNodeCount() const { return nodes.size(); }
+
+	private:
+		struct Node
+		{
+			const char* name = nullptr;
+			uint32_t jobCount = 0;
+			uint32_t groupSize = 0;
+			size_t sharedmemory_size = 0;
+			Task task;
+			std::vector<NodeID> successors;
+			uint32_t predecessorCount = 0;
+			NodeID gatingPredecessor = ~0u;
+			int64_t beginTime = 0;
+			int64_t endTime = 0;
+		};
+		std::vector<Node> nodes;
+		std::unique_ptr<std::atomic<uint32_t>[]> pendingPredecessors;
+		size_t pendingCapacity = 0;
+		context* ctx = nullptr;
+		int64_t runTime = 0;
+
+		void launch(NodeID node);
+		void finish(NodeID node);
+		friend struct Job;
+	};
+
+	// Number of heap allocations made by the job system so far (task pool growth, oversized task callables, queue overflow)
+	//	Sample it once per frame: after warm-up the difference between frames should stay zero
+	UTIL_EXPORT uint64_t GetHeapAllocationCount();
 }
@@ -19,6 +19,17 @@
 #include <mutex>
 #include <atomic>
 #include <sstream>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
 
 using namespace vz::graphics;
 
@@ -68,6 +79,141 @@ namespace vz::profiler
 	static std::string warnningProfile = "";
 	static std::atomic_bool beginRetreived{ true };
 
+	// Timeline capture:
+	//	each thread owns a ring of records, only the owner writes it (no lock, no shared cache line)
+	//	the rings are read when the capture ended, records are converted to Chrome trace events then
+	//	a writer raises its thread's writing flag and re-checks the capture state before it touches the ring,
+	//	EndTraceCapture clears the state and waits for raised flags before it reads the rings
+	//	(both sides are seq_cst: either the writer sees the capture stopped, or EndTraceCapture sees the flag)
+	static constexpr uint64_t TRACE_RING_SIZE = 64 * 1024; // records per thread, must be power of two
+	static constexpr uint32_t TRACE_MAX_DEPTH = 64; // nested BeginRangeCPU per thread
+
+	struct TraceRecord
+	{
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+		uint32_t arg;
+		TraceCategory category;
+	};
+	struct TraceThread
+	{
+		struct OpenRange
+		{
+			range_id id;
+			const char* name;
+			uint64_t begin;
+		};
+
+		uint32_t tid = 0;
+		char name[32] = {};
+		std::atomic<uint32_t> generation{ 0 }; // capture that the records belong to
+		std::unique_ptr<TraceRecord[]> records;
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<bool> writing{ false }; // a record is being written
+		OpenRange openRanges[TRACE_MAX_DEPTH];
+		uint32_t depth = 0;
+	};
+	namespace internal
+	{
+		std::atomic<bool> traceCapturing{ false };
+	}
+	using internal::traceCapturing;
+	static std::atomic<uint32_t> traceGeneration{ 0 };
+	static std::mutex traceLock; // thread registration and capture state
+	static std::vector<std::unique_ptr<TraceThread>> traceThreads;
+	static thread_local TraceThread* tls_traceThread = nullptr;
+	static thread_local char tls_traceThreadName[32] = {};
+	static std::string traceFileName;
+	static uint32_t traceFrameCount = 0;
+	static std::vector<uint64_t> traceFrames; // frame boundaries, [0] is the start of the capture
+	static std::chrono::steady_clock::time_point traceStartTime;
+
+	// rdtsc where available (a few ns), converted to time with the wall clock measured over the whole capture
+	static inline uint64_t traceTicks()
+	{
+#if defined(_M_X64) || defined(__x86_64__)
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	static TraceThread* getTraceThread()
+	{
+		TraceThread* thread = tls_traceThread;
+		if (thread == nullptr)
+		{
+			std::lock_guard<std::mutex> guard(traceLock);
+			thread = traceThreads.emplace_back(std::make_unique<TraceThread>()).get();
+			thread->tid = (uint32_t)traceThreads.size();
+			if (tls_traceThreadName[0] != 0)
+			{
+				memcpy(thread->name, tls_traceThreadName, sizeof(thread->name));
+			}
+			else
+			{
+				snprintf(thread->name, sizeof(thread->name), "Thread %u", thread->tid);
+			}
+			thread->records.reset(new TraceRecord[TRACE_RING_SIZE]);
+			tls_traceThread = thread;
+		}
+		return thread;
+	}
+
+	static inline void writeTraceRecord(TraceThread* thread, const char* name, TraceCategory category, uint64_t begin, uint64_t end, uint32_t arg)
+	{
+		thread->writing.store(true);
+		if (!traceCapturing.load())
+		{
+			// the capture ended after the caller's check, its rings may be read already
+			thread->writing.store(false, std::memory_order_release);
+			return;
+		}
+		const uint32_t generation = traceGeneration.load(std::memory_order_relaxed);
+		if (thread->generation.load(std::memory_order_relaxed) != generation)
+		{
+			thread->generation.store(generation, std::memory_order_relaxed);
+			thread->head.store(0, std::memory_order_relaxed);
+		}
+		const uint64_t head = thread->head.load(std::memory_order_relaxed);
+		TraceRecord& record = thread->records[head & (TRACE_RING_SIZE - 1)];
+		record.name = name;
+		record.begin = begin;
+		record.end = end;
+		record.arg = arg;
+		record.category = category;
+		thread->head.store(head + 1, std::memory_order_release);
+		thread->writing.store(false, std::memory_order_release);
+	}
+
+	static inline void recordTrace(const char* name, TraceCategory category, uint64_t begin, uint64_t end, uint32_t arg)
+	{
+		writeTraceRecord(getTraceThread(), name, category, begin, end, arg);
+	}
+
+	static inline void traceRangeBegin(range_id id, const char* name)
+	{
+		TraceThread* thread = getTraceThread();
+		if (thread->depth < TRACE_MAX_DEPTH)
+		{
+			thread->openRanges[thread->depth++] = { id, name, traceTicks() };
+		}
+	}
+
+	static inline void traceRangeEnd(range_id id)
+	{
+		TraceThread* thread = tls_traceThread;
+		if (thread == nullptr || thread->depth == 0 || thread->openRanges[thread->depth - 1].id != id)
+			return;
+		const TraceThread::OpenRange& range = thread->openRanges[--thread->depth];
+		if (traceCapturing.load(std::memory_order_relaxed))
+		{
+			// the thread is already known here, no need for a second lookup
+			writeTraceRecord(thread, range.name, TraceCategory::Range, range.begin, traceTicks(), 0);
+		}
+	}
+
 	void BeginFrame()
 	{
 		if (ENABLED_REQUEST != ENABLED)
@@ -196,6 +342,8 @@ namespace vz::profiler
 	}
 	void EndFrame(CommandList* cmd)
 	{
+		MarkTraceFrame();
+
 		if (!ENABLED || !initialized)
 			return;
 
@@ -229,8 +377,18 @@ namespace vz::profiler
 
 	range_id BeginRangeCPU(const char* name)
 	{
+		const bool tracing = traceCapturing.load(std::memory_order_relaxed);
 		if (!ENABLED || !initialized)
+		{
+			if (tracing)
+			{
+				// only has to match the EndRange, the name pointer is unique enough and cheaper than hashing
+				range_id id = (range_id)name;
+				traceRangeBegin(id, name);
+				return id;
+			}
 			return 0;
+		}
 
 #if PERFORMANCEAPI_ENABLED
 		if (superluminal_handle)
@@ -260,8 +418,38 @@ namespace vz::profiler
 
 		lock.unlock();
 
+		if (tracing)
+		{
+			traceRangeBegin(id, name);
+		}
+
 		return id;
 	}
+	void AddRangeCPU(const char* name, float time)
+	{
+		if (!ENABLED || !initialized)
+			return;
+
+		if (beginRetreived.load())
+		{
+			BeginFrame();
+		}
+
+		range_id id = helper::string_hash(name);
+
+		lock.lock();
+
+		size_t differentiator = 0;
+		while (ranges[id].in_use)
+		{
+			helper::hash_combine(id, differentiator++);
+		}
+		ranges[id].in_use = true;
+		ranges[id].name = name;
+		ranges[id].time = time;
+
+		lock.unlock();
+	}
 	range_id BeginRangeGPU(const char* name, CommandList* cmd)
 	{
 		if (!ENABLED || !initialized)
@@ -291,6 +479,8 @@ namespace vz::profiler
 	}
 	void EndRange(range_id id)
 	{
+		traceRangeEnd(id);
+
 		if (!ENABLED || !initialized)
 			return;
 
@@ -495,4 +685,197 @@ namespace vz::profiler
 		ranges.clear();
 		initialized = false;
 	}
+
+	static void appendJsonString(std::string& out, const char* text)
+	{
+		out += '"';
+		for (const char* c = text ? text : ""; *c != 0; ++c)
+		{
+			switch (*c)
+			{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			default:
+				if ((unsigned char)*c < 0x20)
+				{
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+					out += escaped;
+				}
+				else
+				{
+					out += *c;
+				}
+				break;
+			}
+		}
+		out += '"';
+	}
+
+	// Converts the rings of the finished capture into a Chrome trace JSON file, traceLock must be held
+	static void writeTrace(uint64_t endTicks, std::chrono::steady_clock::time_point endTime)
+	{
+		const uint64_t start_ticks = traceFrames.front();
+		const double elapsed_us = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - traceStartTime).count() * 1e-3;
+		const double us_per_tick = endTicks > start_ticks ? elapsed_us / double(endTicks - start_ticks) : 0.0;
+		auto to_us = [&](uint64_t ticks) { return ticks > start_ticks ? double(ticks - start_ticks) * us_per_tick : 0.0; };
+
+		std::string json;
+		json.reserve(1024 * 1024);
+		char line[256];
+		json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"vzEngine\"}},\n";
+		json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Frames\"}}";
+
+		for (size_t i = 1; i < traceFrames.size(); ++i)
+		{
+			const double begin = to_us(traceFrames[i - 1]);
+			snprintf(line, sizeof(line), ",\n{\"name\":\"Frame %zu\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+				i - 1, begin, to_us(traceFrames[i]) - begin);
+			json += line;
+		}
+
+		const uint32_t generation = traceGeneration.load();
+		uint64_t overwritten = 0;
+		for (const std::unique_ptr<TraceThread>& thread : traceThreads)
+		{
+			if (thread->generation.load(std::memory_order_relaxed) != generation)
+				continue;
+			json += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+			json += std::to_string(thread->tid);
+			json += ",\"args\":{\"name\":";
+			appendJsonString(json, thread->name);
+			json += "}}";
+
+			const uint64_t head = thread->head.load(std::memory_order_acquire);
+			const uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+			overwritten += first;
+			for (uint64_t i = first; i < head; ++i)
+			{
+				const TraceRecord& record = thread->records[i & (TRACE_RING_SIZE - 1)];
+				if (record.end < start_ticks || record.begin > endTicks)
+					continue;
+				const double begin = to_us(record.begin);
+				json += ",\n{\"name\":";
+				appendJsonString(json, record.name);
+				switch (record.category)
+				{
+				case TraceCategory::Steal:
+					snprintf(line, sizeof(line), ",\"cat\":\"steal\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"victim\":%u}}",
+						thread->tid, begin, record.arg);
+					break;
+				case TraceCategory::Job:
+					snprintf(line, sizeof(line), ",\"cat\":\"job\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"group\":%u}}",
+						thread->tid, begin, to_us(record.end) - begin, record.arg);
+					break;
+				case TraceCategory::Dispatch:
+					snprintf(line, sizeof(line), ",\"cat\":\"dispatch\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"groups\":%u}}",
+						thread->tid, begin, to_us(record.end) - begin, record.arg);
+					break;
+				case TraceCategory::Wait:
+					snprintf(line, sizeof(line), ",\"cat\":\"wait\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						thread->tid, begin, to_us(record.end) - begin);
+					break;
+				case TraceCategory::Range:
+				default:
+					snprintf(line, sizeof(line), ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+						thread->tid, begin, to_us(record.end) - begin);
+					break;
+				}
+				json += line;
+			}
+		}
+		json += "\n]}\n";
+
+		if (overwritten > 0)
+		{
+			vzlog_warning("[profiler] %llu trace events were overwritten, the oldest part of the capture is missing", (unsigned long long)overwritten);
+		}
+		if (helper::FileWrite(traceFileName, (const uint8_t*)json.data(), json.size()))
+		{
+			vzlog("[profiler] Trace of %zu frames written to %s", traceFrames.size() - 1, traceFileName.c_str());
+		}
+		else
+		{
+			vzlog_error("[profiler] Failed to write trace file: %s", traceFileName.c_str());
+		}
+	}
+
+	bool BeginTraceCapture(const char* fileName, uint32_t frameCount)
+	{
+		std::lock_guard<std::mutex> guard(traceLock);
+		if (traceCapturing.load() || fileName == nullptr)
+			return false;
+		traceFileName = fileName;
+		traceFrameCount = std::max(frameCount, 1u);
+		traceGeneration.fetch_add(1);
+		traceStartTime = std::chrono::steady_clock::now();
+		traceFrames.assign(1, traceTicks());
+		traceCapturing.store(true);
+		return true;
+	}
+
+	void EndTraceCapture()
+	{
+		const uint64_t end_ticks = traceTicks();
+		const std::chrono::steady_clock::time_point end_time = std::chrono::steady_clock::now();
+		std::lock_guard<std::mutex> guard(traceLock);
+		if (!traceCapturing.exchange(false))
+			return;
+		// writers that saw the capture running finish their record, later ones see it stopped
+		for (const std::unique_ptr<TraceThread>& thread : traceThreads)
+		{
+			while (thread->writing.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+		}
+		writeTrace(end_ticks, end_time);
+	}
+
+	bool IsTraceCapturing()
+	{
+		return traceCapturing.load(std::memory_order_relaxed);
+	}
+
+	void MarkTraceFrame()
+	{
+		if (!traceCapturing.load(std::memory_order_relaxed))
+			return;
+		bool finished = false;
+		{
+			std::lock_guard<std::mutex> guard(traceLock);
+			if (!traceCapturing.load())
+				return;
+			traceFrames.push_back(traceTicks());
+			finished = traceFrames.size() > traceFrameCount;
+		}
+		if (finished)
+		{
+			EndTraceCapture();
+		}
+	}
+
+	void SetTraceThreadName(const char* name)
+	{
+		strncpy(tls_traceThreadName, name, sizeof(tls_traceThreadName) - 1);
+		if (tls_traceThread != nullptr)
+		{
+			std::lock_guard<std::mutex> guard(traceLock);
+			memcpy(tls_traceThread->name, tls_traceThreadName, sizeof(tls_traceThreadName));
+		}
+	}
+
+	uint64_t TraceTimestamp()
+	{
+		return traceTicks();
+	}
+
+	void TraceEvent(const char* name, TraceCategory category, uint64_t begin, uint64_t end, uint32_t arg)
+	{
+		if (traceCapturing.load(std::memory_order_relaxed))
+		{
+			recordTrace(name, category, begin, end, arg);
+		}
+	}
 }
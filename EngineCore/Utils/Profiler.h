@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <atomic>
 
 #ifndef UTIL_EXPORT
 #ifdef _WIN32
@@ -40,6 +41,10 @@ namespace vz::profiler
 	// End a profiling range
 	UTIL_EXPORT void EndRange(range_id id);
 
+	// Add a CPU range that was measured elsewhere (e.g. a node on the critical path of a jobsystem::TaskGraph)
+	//	time is in milliseconds
+	UTIL_EXPORT void AddRangeCPU(const char* name, float time);
+
 	// helper using RAII to avoid having to manually call BeginRangeCPU/EndRange at beginning/end
 	struct ScopedRangeCPU
 	{
@@ -64,5 +69,45 @@ namespace vz::profiler
 	UTIL_EXPORT void SetEnabled(bool value);
 
 	UTIL_EXPORT bool IsEnabled();
+
+	// Timeline capture
+	//	Every thread records its events (CPU ranges, jobsystem dispatch/execute/steal/wait) into its own ring buffer,
+	//	after frameCount frames the timeline is written as a Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+	//	Independent of SetEnabled() and of the graphics device, so it also works headless.
+	//	Frames are counted by the engine's profiler frame, or by MarkTraceFrame() for custom/headless loops.
+	UTIL_EXPORT bool BeginTraceCapture(const char* fileName, uint32_t frameCount);
+
+	// Stops a running capture and writes the file with the frames recorded so far
+	UTIL_EXPORT void EndTraceCapture();
+
+	UTIL_EXPORT bool IsTraceCapturing();
+
+	namespace internal
+	{
+		// Set while a timeline capture runs, not exported (modules outside the engine use IsTraceCapturing())
+		extern std::atomic<bool> traceCapturing;
+	}
+	// Capture check for the engine's own hot paths (jobsystem hooks): a single relaxed load and branch when not capturing
+	inline bool IsTraceCapturingInline() { return internal::traceCapturing.load(std::memory_order_relaxed); }
+
+	UTIL_EXPORT void MarkTraceFrame();
+
+	// Name of the calling thread in the timeline (copied, at most 31 characters)
+	UTIL_EXPORT void SetTraceThreadName(const char* name);
+
+	enum class TraceCategory : uint8_t
+	{
+		Range,		// BeginRangeCPU/EndRange
+		Job,		// execution of a job group, arg: group ID
+		Dispatch,	// submission of a dispatch, arg: group count
+		Steal,		// instant, a job taken from another thread's queue, arg: victim queue
+		Wait,		// jobsystem::Wait, arg: 0
+	};
+
+	// Low level event recording
+	//	name must outlive the capture (string literal, __FUNCTION__, TaskGraph node name, ...)
+	//	timestamps are TraceTimestamp() ticks
+	UTIL_EXPORT uint64_t TraceTimestamp();
+	UTIL_EXPORT void TraceEvent(const char* name, TraceCategory category, uint64_t begin, uint64_t end, uint32_t arg = 0);
 };
 
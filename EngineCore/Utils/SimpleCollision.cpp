@@ -218,11 +218,13 @@ namespace vz::GJKcollision
 
 	// -----------------------------------------------------------------------------
 	// Convex vs BVH (returns first triangle index, or -1)
+	//	if hitTris is given, the traversal continues and collects every hit triangle
 	// -----------------------------------------------------------------------------
 	bool GJK_ConvexVsBVH(const ConvexShape& convexA, // yellow (local space)
 		const Primitive& meshB,         // salmon
 		CXMMATRIX AtoB,          // world→B
-		int& hitTri)
+		int& hitTri,
+		std::vector<int>* hitTris = nullptr)
 	{
 		using namespace DirectX;
 		hitTri = -1;
@@ -300,7 +302,13 @@ namespace vz::GJKcollision
 					TriShape tri(p0, p1, p2);
 					if (GJK_Intersect(convexA_inB, tri, /*maxIter=*/10))
 					{
-						hitTri = int(t); return true;
+						if (hitTris == nullptr)
+						{
+							hitTri = int(t); return true;
+						}
+						if (hitTri < 0)
+							hitTri = int(t);
+						hitTris->push_back(int(t));
 					}
 				}
 			}
@@ -310,12 +318,18 @@ namespace vz::GJKcollision
 				stack[sp++] = node.left + 1;
 			}
 		}
-		return false;
+		return hitTri >= 0;
 	}
 }
 
 namespace vz::bvhcollision
 {
+	struct TriPair
+	{
+		int tri1;
+		int tri2;
+	};
+
 	//-------------------------------------
 	// Triangle-Triangle Intersection Test Function
 	//-------------------------------------
@@ -664,6 +678,7 @@ namespace vz::bvhcollision
 
 	//-------------------------------------
 	// When both nodes are leaves => Perform triangle-triangle intersection test
+	//	if triPairs is given, every intersecting triangle pair is appended instead of returning on the first one
 	//-------------------------------------
 	bool IntersectLeafLeaf(
 		const Primitive& mesh1,
@@ -671,9 +686,11 @@ namespace vz::bvhcollision
 		const geometrics::BVH::Node& node1, const geometrics::BVH::Node& node2,
 		const XMMATRIX& T,
 		int& intersectTriMesh1,
-		int& intersectTriMesh2
+		int& intersectTriMesh2,
+		std::vector<TriPair>* triPairs = nullptr
 	)
 	{
+		bool found = false;
 		const XMFLOAT3* positions1 = mesh1.GetVtxPositions().data();
 		const XMFLOAT3* positions2 = mesh2.GetVtxPositions().data();
 		const uint32_t* indices1 = mesh1.GetIdxPrimives().data();
@@ -710,20 +727,30 @@ namespace vz::bvhcollision
 				{
 					intersectTriMesh1 = triIndex1; 
 					intersectTriMesh2 = triIndex2; 
-					return true; // Return true immediately if any intersection is found
+					if (triPairs == nullptr)
+					{
+						return true; // Return true immediately if any intersection is found
+					}
+					triPairs->push_back({ (int)triIndex1, (int)triIndex2 });
+					found = true;
 				}
 			}
 		}
 
-		return false; // No intersection
+		return found;
 	}
 
+	//	rootA/rootB: node pair to start from (root–root by default)
+	//	triPairs: if given, collects every intersecting triangle pair instead of stopping at the first one
 	bool IntersectBVH_LoopStack(
 		const Primitive& meshA,
 		const Primitive& meshB,
 		CXMMATRIX        AtoB,                 // meshA → meshB
 		int& triIdxA,
-		int& triIdxB)
+		int& triIdxB,
+		std::vector<TriPair>* triPairs = nullptr,
+		const uint32_t rootA = 0,
+		const uint32_t rootB = 0)
 	{
 		const auto& bvhA = meshA.GetBVH();
 		const auto& bvhB = meshB.GetBVH();
@@ -731,7 +758,8 @@ namespace vz::bvhcollision
 		struct Pair { uint32_t a, b; };
 		std::vector<Pair> stack;
 		stack.reserve(256);
-		stack.push_back({ 0, 0 });               // root–root
+		stack.push_back({ rootA, rootB });
+		bool found = false;
 
 		uint64_t cntAABB = 0;
 		uint64_t cntTriTri = 0;
@@ -756,8 +784,12 @@ namespace vz::bvhcollision
 			{
 				++cntTriTri;
 				if (IntersectLeafLeaf(meshA, meshB, nodeA, nodeB,
-					AtoB, triIdxA, triIdxB))
-					return true;
+					AtoB, triIdxA, triIdxB, triPairs))
+				{
+					if (triPairs == nullptr)
+						return true;
+					found = true;
+				}
 				continue;
 			}
 
@@ -779,7 +811,65 @@ namespace vz::bvhcollision
 			}
 		}
 
-		return false;
+		return found;
+	}
+
+	//-------------------------------------
+	// Splits the root–root BVH traversal into independent node pairs (breadth first, same split rule as IntersectBVH_LoopStack)
+	//	pairs whose AABBs do not overlap are dropped, so the traversals of the seeds cover the same triangle pairs
+	//	no seeds are returned if either BVH is not valid (e.g., POINTS parts have no BVH)
+	//-------------------------------------
+	static void SplitBVHTraversal(
+		const Primitive& meshA,
+		const Primitive& meshB,
+		CXMMATRIX AtoB,
+		const size_t targetCount,
+		std::vector<std::pair<uint32_t, uint32_t>>& seeds)
+	{
+		const auto& bvhA = meshA.GetBVH();
+		const auto& bvhB = meshB.GetBVH();
+
+		seeds.clear();
+		if (!meshA.HasValidBVH() || !meshB.HasValidBVH())
+		{
+			return;
+		}
+		seeds.push_back({ 0, 0 });
+		std::vector<std::pair<uint32_t, uint32_t>> next;
+		bool split_any = true;
+		while (split_any && seeds.size() < targetCount)
+		{
+			split_any = false;
+			next.clear();
+			for (const auto& [ia, ib] : seeds)
+			{
+				const auto& nodeA = bvhA.nodes[ia];
+				const auto& nodeB = bvhB.nodes[ib];
+				if (!nodeA.aabb.transform(AtoB).intersects(nodeB.aabb))
+					continue;
+				if (nodeA.isLeaf() && nodeB.isLeaf())
+				{
+					next.push_back({ ia, ib });
+					continue;
+				}
+				const bool splitA =
+					!nodeA.isLeaf() &&
+					(nodeB.isLeaf() ||
+						nodeA.aabb.getArea() > nodeB.aabb.getArea());
+				if (splitA)
+				{
+					next.push_back({ nodeA.left, ib });
+					next.push_back({ nodeA.left + 1, ib });
+				}
+				else
+				{
+					next.push_back({ ia, nodeB.left });
+					next.push_back({ ia, nodeB.left + 1 });
+				}
+				split_any = true;
+			}
+			seeds.swap(next);
+		}
 	}
 
 
@@ -849,6 +939,82 @@ namespace vz::bvhcollision
 		return false;
 	}
 
+	//-------------------------------------
+	// BVH of a geometry must be up-to-date for the narrow phase
+	//	if not, its BVH build is kicked off asynchronously and false is returned
+	//-------------------------------------
+	static bool PrepareBVH(GeometryComponent* geometry, const Entity geometryEntity)
+	{
+		if (geometry->HasBVH() && !geometry->IsDirtyBVH())
+		{
+			return true;
+		}
+		//vzlog_warning("Scene update is required for BVH of geometry (%d)", geometryEntity);
+		if (!geometry->IsBusyForBVH())
+		{
+			vzlog_warning("preparing BVH... (%llu)", geometryEntity);
+			static jobsystem::context ctx; // Must be declared static to prevent context overflow, which could lead to thread access violations
+			jobsystem::Execute(ctx, [geometryEntity](jobsystem::JobArgs) {
+				GeometryComponent* geometry = compfactory::GetGeometryComponent(geometryEntity);
+				geometry->UpdateBVH(true);
+				});
+		}
+		return false;
+	}
+
+	//-------------------------------------
+	// Narrow phase between two primitives (parts)
+	//	T: prim1's object space -> prim2's object space, T_inv: the inverse
+	//	triIndex1/2: the first hit triangle of each side, the convex side of a convex-vs-mesh pair reports -1
+	//	triPairs: if given, every contact is collected (the convex side of a convex-vs-mesh pair reports -1 as its triangle)
+	//	a mesh side without a valid BVH (e.g., POINTS parts) never collides
+	//-------------------------------------
+	static bool CollidePrimitives(const Primitive& prim1, const Primitive& prim2, CXMMATRIX T, CXMMATRIX T_inv,
+		int& triIndex1, int& triIndex2, std::vector<TriPair>* triPairs = nullptr)
+	{
+		using namespace GJKcollision;
+		const int is_convex_1 = (int)prim1.IsConvexShape();
+		const int is_convex_2 = (int)prim2.IsConvexShape();
+		if ((!is_convex_1 && !prim1.HasValidBVH()) || (!is_convex_2 && !prim2.HasValidBVH()))
+		{
+			return false;
+		}
+		switch (is_convex_1 + is_convex_2)
+		{
+		case 1:
+		{
+			const Primitive& prim_convex = is_convex_1 ? prim1 : prim2;
+			const Primitive& prim_mesh = is_convex_1 ? prim2 : prim1;
+			ConvexShape convex_shape;
+			convex_shape.n = prim_convex.GetNumVertices();
+			convex_shape.v = (const XMFLOAT3*)prim_convex.GetVtxPositions().data();
+			int tri_idx;
+			std::vector<int> hit_tris;
+			if (!GJK_ConvexVsBVH(convex_shape, prim_mesh, is_convex_1 ? T : T_inv, tri_idx, triPairs ? &hit_tris : nullptr))
+			{
+				return false;
+			}
+			// the mesh side reports its first hit triangle, the convex side has no triangle
+			triIndex1 = is_convex_1 ? -1 : tri_idx;
+			triIndex2 = is_convex_1 ? tri_idx : -1;
+			if (triPairs)
+			{
+				for (int tri : hit_tris)
+				{
+					triPairs->push_back(is_convex_1 ? TriPair{ -1, tri } : TriPair{ tri, -1 });
+				}
+			}
+			return true;
+		}
+		case 2:
+			//GJKcollision::GJK_Intersect()
+			return false;
+		default: // 0
+			return IntersectBVH_LoopStack(prim1, prim2, T, triIndex1, triIndex2, triPairs);
+			//return IntersectBVH_Recursive(prim1, prim2, T, /*root1=*/0, /*root2=*/0, triIndex1, triIndex2);
+		}
+	}
+
 	bool CollisionPairwiseCheck(const Entity geometryEntity1, const Entity transformEntity1, const Entity geometryEntity2, const Entity transformEntity2,
 		int& partIndex1, int& triIndex1, int& partIndex2, int& triIndex2)
 	{
@@ -872,42 +1038,9 @@ namespace vz::bvhcollision
 			return false;
 		}
 
-		size_t count_has_bvh = 0;
-		if (!geometry1->HasBVH() || geometry1->IsDirtyBVH())
-		{
-			//vzlog_warning("Scene update is required for BVH of geometry (%d)", geometryEntity1);
-			if (!geometry1->IsBusyForBVH())
-			{
-				vzlog_warning("preparing BVH... (%llu)", geometryEntity1);
-				static jobsystem::context ctx; // Must be declared static to prevent context overflow, which could lead to thread access violations
-				jobsystem::Execute(ctx, [geometryEntity1](jobsystem::JobArgs args) {
-					GeometryComponent* geometry1 = compfactory::GetGeometryComponent(geometryEntity1);
-					geometry1->UpdateBVH(true);
-					});
-			}
-		}
-		else
-		{
-			count_has_bvh++;
-		}
-
-		if (!geometry2->HasBVH() || geometry2->IsDirtyBVH())
-		{
-			if (!geometry1->IsBusyForBVH())
-			{
-				vzlog_warning("preparing BVH... (%llu)", geometryEntity2);
-				static jobsystem::context ctx; // Must be declared static to prevent context overflow, which could lead to thread access violations
-				jobsystem::Execute(ctx, [geometryEntity2](jobsystem::JobArgs args) {
-					GeometryComponent* geometry2 = compfactory::GetGeometryComponent(geometryEntity2);
-					geometry2->UpdateBVH(true);
-					});
-			}
-		}
-		else
-		{
-			count_has_bvh++;
-		}
-		if (count_has_bvh < 2)
+		const bool bvh_ready1 = PrepareBVH(geometry1, geometryEntity1);
+		const bool bvh_ready2 = PrepareBVH(geometry2, geometryEntity2);
+		if (!(bvh_ready1 && bvh_ready2))
 		{
 			return false;
 		}
@@ -925,66 +1058,212 @@ namespace vz::bvhcollision
 		partIndex1 = partIndex2 = -1;
 		triIndex1 = triIndex2 = -1;
 
-		using namespace GJKcollision;
-		for (size_t i = 0; i < n1; ++i)
+		for (size_t i = 0; i < n1 && !is_collision; ++i)
 		{
-			const Primitive& prim1 = primitives1[i];
-			int is_convex_1 = (int)prim1.IsConvexShape();
-
 			for (size_t j = 0; j < n2; ++j)
 			{
-				const Primitive& prim2 = primitives2[j];
-				int is_convex_2 = (int)prim2.IsConvexShape();
-				switch (is_convex_1 + is_convex_2)
+				if (CollidePrimitives(primitives1[i], primitives2[j], T, T_inv, triIndex1, triIndex2))
 				{
-				case 1:
-					if (is_convex_1)
-					{
-						ConvexShape convex_shape;
-						convex_shape.n = prim1.GetNumVertices();
-						convex_shape.v = (const XMFLOAT3*)prim1.GetVtxPositions().data();
-						int tri_idx;
-						if (GJK_ConvexVsBVH(convex_shape, prim2, T, tri_idx))
-						{ 
-							partIndex1 = i;
-							partIndex2 = j;
-							i = n1; j = n2;
-							is_collision = true;
-						}
-					}
-					else
+					partIndex1 = (int)i;
+					partIndex2 = (int)j;
+					is_collision = true;
+					break;
+				}
+			}
+		}
+		profiler::EndRange(range);
+		return is_collision;
+	}
+
+	bool CollisionBatchCheck(const std::vector<CollisionObject>& objects1, const std::vector<CollisionObject>& objects2,
+		const CollisionQuery query, std::vector<CollisionContact>& contacts)
+	{
+		contacts.clear();
+		if (objects1.empty() || objects2.empty())
+		{
+			return false;
+		}
+
+		auto range = profiler::BeginRangeCPU("Collision Detection (Batch)");
+
+		// Resolve the components, world matrices and world AABBs of both sets:
+		struct ObjectState
+		{
+			GeometryComponent* geometry = nullptr;
+			XMFLOAT4X4 world;
+			XMFLOAT4X4 worldInv;
+			geometrics::AABB aabbWorld;
+		};
+		auto resolve = [](const std::vector<CollisionObject>& objects, std::vector<ObjectState>& states) {
+			states.resize(objects.size());
+			for (size_t i = 0, n = objects.size(); i < n; ++i)
+			{
+				const CollisionObject& object = objects[i];
+				ObjectState& state = states[i];
+				TransformComponent* transform = compfactory::GetTransformComponent(object.transformEntity);
+				GeometryComponent* geometry = compfactory::GetGeometryComponent(object.geometryEntity);
+				if (!(transform && geometry))
+				{
+					vzlog_error("Invalid Component! (object %d)", (int)i);
+					continue;
+				}
+				if (geometry->GetPrimitives().empty())
+				{
+					vzlog_error("Invalid Geometry! (having no Primitive)");
+					continue;
+				}
+				if (!PrepareBVH(geometry, object.geometryEntity))
+				{
+					continue;
+				}
+				state.geometry = geometry;
+				state.world = transform->GetWorldMatrix();
+				XMStoreFloat4x4(&state.worldInv, XMMatrixInverse(nullptr, XMLoadFloat4x4(&state.world)));
+				state.aabbWorld = geometry->GetAABB().transform(state.world);
+			}
+			};
+		std::vector<ObjectState> states1, states2;
+		resolve(objects1, states1);
+		resolve(objects2, states2);
+
+		// Broad phase: world AABB overlap of the object pairs, then object-space AABB overlap of their parts
+		struct ObjectPair
+		{
+			uint32_t object1;
+			uint32_t object2;
+			XMFLOAT4X4 T;		// os1 to os2
+			XMFLOAT4X4 T_inv;	// os2 to os1
+		};
+		struct NarrowTask
+		{
+			uint32_t pairIndex;
+			uint32_t part1;
+			uint32_t part2;
+			uint32_t rootA = 0; // BVH node pair the traversal starts from
+			uint32_t rootB = 0;
+			bool hit = false;
+			int triIndex1 = -1;
+			int triIndex2 = -1;
+			std::vector<TriPair> triPairs;
+		};
+		std::vector<ObjectPair> pairs;
+		std::vector<NarrowTask> tasks;
+		std::vector<std::pair<uint32_t, uint32_t>> seeds;
+		const size_t split_target = (size_t)jobsystem::GetThreadCount() * 4;
+
+		for (uint32_t i = 0, n1 = (uint32_t)states1.size(); i < n1; ++i)
+		{
+			const ObjectState& state1 = states1[i];
+			if (state1.geometry == nullptr)
+				continue;
+			for (uint32_t j = 0, n2 = (uint32_t)states2.size(); j < n2; ++j)
+			{
+				const ObjectState& state2 = states2[j];
+				if (state2.geometry == nullptr)
+					continue;
+				if (objects1[i].geometryEntity == objects2[j].geometryEntity && objects1[i].transformEntity == objects2[j].transformEntity)
+					continue; // the same object
+				if (!state1.aabbWorld.intersects(state2.aabbWorld))
+					continue;
+
+				const XMMATRIX m1os2ws = XMLoadFloat4x4(&state1.world);
+				const XMMATRIX m2os2ws = XMLoadFloat4x4(&state2.world);
+				const XMMATRIX T = XMMatrixMultiply(m1os2ws, XMLoadFloat4x4(&state2.worldInv));
+				const XMMATRIX T_inv = XMMatrixMultiply(m2os2ws, XMLoadFloat4x4(&state1.worldInv));
+
+				const uint32_t pair_index = (uint32_t)pairs.size();
+				ObjectPair& pair = pairs.emplace_back();
+				pair.object1 = i;
+				pair.object2 = j;
+				XMStoreFloat4x4(&pair.T, T);
+				XMStoreFloat4x4(&pair.T_inv, T_inv);
+
+				const std::vector<Primitive>& primitives1 = state1.geometry->GetPrimitives();
+				const std::vector<Primitive>& primitives2 = state2.geometry->GetPrimitives();
+				// parts without a valid BVH (e.g., POINTS) can't be tested, unless they are convex shapes
+				for (uint32_t part1 = 0, np1 = (uint32_t)primitives1.size(); part1 < np1; ++part1)
+				{
+					const Primitive& prim1 = primitives1[part1];
+					if (!prim1.IsConvexShape() && !prim1.HasValidBVH())
+						continue;
+					const geometrics::AABB aabb1_in_2 = prim1.GetAABB().transform(T);
+					for (uint32_t part2 = 0, np2 = (uint32_t)primitives2.size(); part2 < np2; ++part2)
 					{
-						ConvexShape convex_shape;
-						convex_shape.n = prim2.GetNumVertices();
-						convex_shape.v = (const XMFLOAT3*)prim2.GetVtxPositions().data();
-						int tri_idx;
-						if (GJK_ConvexVsBVH(convex_shape, prim1, T_inv, tri_idx))
+						const Primitive& prim2 = primitives2[part2];
+						if (!prim2.IsConvexShape() && !prim2.HasValidBVH())
+							continue;
+						if (!aabb1_in_2.intersects(prim2.GetAABB()))
+							continue;
+
+						// All contacts of two meshes: split the BVH traversal, so that a single large part pair still spreads over the threads
+						if (query == CollisionQuery::ALL_CONTACTS && !prim1.IsConvexShape() && !prim2.IsConvexShape())
 						{
-							partIndex1 = i;
-							partIndex2 = j;
-							i = n1; j = n2;
-							is_collision = true;
+							SplitBVHTraversal(prim1, prim2, T, split_target, seeds);
+							for (const auto& [rootA, rootB] : seeds)
+							{
+								NarrowTask& task = tasks.emplace_back();
+								task.pairIndex = pair_index;
+								task.part1 = part1;
+								task.part2 = part2;
+								task.rootA = rootA;
+								task.rootB = rootB;
+							}
+							continue;
 						}
+						NarrowTask& task = tasks.emplace_back();
+						task.pairIndex = pair_index;
+						task.part1 = part1;
+						task.part2 = part2;
 					}
-					break;
-				case 2:
-					//GJKcollision::GJK_Intersect()
-					break;
-				default: // 0
-					if (IntersectBVH_LoopStack(primitives1[i], primitives2[j], T, triIndex1, triIndex2))
-						//if (IntersectBVH_Recursive(primitives1[i], primitives2[j], T, /*root1=*/0, /*root2=*/0, triIndex1, triIndex2))
-					{
-						partIndex1 = i;
-						partIndex2 = j;
-						is_collision = true;
-						i = n1; j = n2;
-						//break;
-					}
-					break;
 				}
 			}
 		}
+
+		// Narrow phase:
+		const bool all_contacts = query == CollisionQuery::ALL_CONTACTS;
+		jobsystem::context ctx;
+		jobsystem::Dispatch(ctx, (uint32_t)tasks.size(), 1, [&](jobsystem::JobArgs args) {
+			NarrowTask& task = tasks[args.jobIndex];
+			const ObjectPair& pair = pairs[task.pairIndex];
+			const Primitive& prim1 = states1[pair.object1].geometry->GetPrimitives()[task.part1];
+			const Primitive& prim2 = states2[pair.object2].geometry->GetPrimitives()[task.part2];
+			const XMMATRIX T = XMLoadFloat4x4(&pair.T);
+			const XMMATRIX T_inv = XMLoadFloat4x4(&pair.T_inv);
+			std::vector<TriPair>* tri_pairs = all_contacts ? &task.triPairs : nullptr;
+			if (task.rootA != 0 || task.rootB != 0)
+			{
+				task.hit = IntersectBVH_LoopStack(prim1, prim2, T, task.triIndex1, task.triIndex2, tri_pairs, task.rootA, task.rootB);
+			}
+			else
+			{
+				task.hit = CollidePrimitives(prim1, prim2, T, T_inv, task.triIndex1, task.triIndex2, tri_pairs);
+			}
+			});
+		jobsystem::Wait(ctx);
+
+		// Gather the contacts in task order (deterministic regardless of the job scheduling):
+		//	FIRST_HIT keeps the first hit part pair of each object pair, same as CollisionPairwiseCheck
+		uint32_t last_hit_pair = ~0u;
+		for (const NarrowTask& task : tasks)
+		{
+			if (!task.hit)
+				continue;
+			const ObjectPair& pair = pairs[task.pairIndex];
+			if (!all_contacts)
+			{
+				if (task.pairIndex == last_hit_pair)
+					continue;
+				last_hit_pair = task.pairIndex;
+				contacts.push_back({ pair.object1, pair.object2, (int)task.part1, task.triIndex1, (int)task.part2, task.triIndex2 });
+				continue;
+			}
+			for (const TriPair& tri_pair : task.triPairs)
+			{
+				contacts.push_back({ pair.object1, pair.object2, (int)task.part1, tri_pair.tri1, (int)task.part2, tri_pair.tri2 });
+			}
+		}
+
 		profiler::EndRange(range);
-		return is_collision;
+		return !contacts.empty();
 	}
 }
\ No newline at end of file
@@ -7,5 +7,31 @@ namespace vz::bvhcollision
 {
 	bool CollisionPairwiseCheck(const Entity geometryEntity1, const Entity transformEntity1, const Entity geometryEntity2, const Entity transformEntity2,
 		int& partIndex1, int& triIndex1, int& partIndex2, int& triIndex2);
+
+	struct CollisionObject
+	{
+		Entity geometryEntity = 0;
+		Entity transformEntity = 0;
+	};
+	struct CollisionContact
+	{
+		uint32_t objectIndex1; // index into objects1
+		uint32_t objectIndex2; // index into objects2
+		int partIndex1;
+		int triIndex1; // -1 for a convex part
+		int partIndex2;
+		int triIndex2; // -1 for a convex part
+	};
+	enum class CollisionQuery
+	{
+		FIRST_HIT,		// one contact per colliding object pair
+		ALL_CONTACTS,	// every intersecting triangle pair
+	};
+	// Checks every object of objects1 against every object of objects2 (e.g., an implant against anatomy meshes)
+	//	a broad phase over world AABBs selects the candidate pairs, the narrow phase runs in parallel on the jobsystem
+	//	objects whose BVH is not ready yet are skipped (their BVH build is requested, as in CollisionPairwiseCheck)
+	//	returns true if any contact is found
+	bool CollisionBatchCheck(const std::vector<CollisionObject>& objects1, const std::vector<CollisionObject>& objects2,
+		const CollisionQuery query, std::vector<CollisionContact>& contacts);
 }
 
@@ -1,13 +1,20 @@
 #include "AssetIO.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
+#include "tiny_obj_loader.h" // MTL material libraries
 
 #include "Utils/vzMath.h"
 #include "Utils/Helpers.h"
 #include "Utils/Backlog.h"
+#include "Utils/JobSystem.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
 
 using namespace std;
 using namespace vz;
@@ -70,31 +77,941 @@ private:
 
 // Transform the data from OBJ space to engine-space:
 static const bool transform_to_LH = false;
+// todo: option param would be better
+static const bool flipCulling = false;
 
-Entity ImportModel_OBJ(const std::string& fileName)
+// Native OBJ parser (replaces tinyobj::LoadObj, tinyobj is only used for the MTL material libraries):
+//	1. the memory mapped file is split into line aligned chunks
+//	2. each chunk counts its attributes and triangles and collects its usemtl/mtllib/g/o statements (parallel)
+//	3. the statements are resolved in file order, giving every run of triangles its shape, part and place (serial)
+//	4. each chunk parses its attributes and faces directly into their final place (parallel)
+//	5. polygons are triangulated and the corners of each part are deduplicated into its primitive (parallel)
+//	Shapes, groups and materials follow tinyobj::LoadObj with triangulation.
+static const size_t OBJ_CHUNK_SIZE = 4ull << 20;
+static const size_t OBJ_DEDUP_BUCKET_SIZE = 1ull << 20; // corners per bucket of the parallel vertex dedup
+
+// Face corner with resolved 0-based attribute indices, -1 if absent (or out of bounds)
+//	two corners of a part become one vertex only if all indices match
+struct ObjCorner
 {
-	std::string directory = helper::GetDirectoryFromPath(fileName);
-	std::string name = helper::GetFileNameFromPath(fileName);
+	int v;
+	int vt;
+	int vn;
 
-	tinyobj::attrib_t obj_attrib;
-	std::vector<tinyobj::shape_t> obj_shapes;
-	std::vector<tinyobj::material_t> obj_materials;
-	std::string obj_errors;
+	inline bool operator==(const ObjCorner& other) const
+	{
+		return v == other.v && vt == other.vt && vn == other.vn;
+	}
+	inline uint64_t hash() const
+	{
+		uint64_t h = ((uint64_t)(uint32_t)v << 32 | (uint32_t)vt) * 0x9E3779B97F4A7C15ull;
+		h ^= (uint64_t)(uint32_t)vn + 0xBF58476D1CE4E5B9ull + (h << 6) + (h >> 2);
+		h ^= h >> 31;
+		h *= 0x94D049BB133111EBull;
+		return h ^ (h >> 29);
+	}
+};
 
-	vector<uint8_t> filedata;
-	bool success = helper::FileRead(fileName, filedata);
+enum class ObjLine : uint8_t
+{
+	OTHER,
+	POSITION,	// v
+	TEXCOORD,	// vt
+	NORMAL,		// vn
+	FACE,		// f
+	USEMTL,
+	MTLLIB,
+	GROUP,		// g
+	OBJECT,		// o
+};
 
-	if (success)
+// Triangles of a chunk following a statement (or the chunk begin)
+struct ObjRun
+{
+	ObjLine statement = ObjLine::OTHER;
+	std::string argument;
+	uint64_t num_triangles = 0;
+
+	// resolved in file order:
+	uint32_t shape_index = 0;
+	uint32_t part_index = 0;
+	uint64_t triangle_offset = 0;
+	ObjCorner* target = nullptr;
+};
+
+// Face with more than 3 corners, triangulated when all positions are known
+struct ObjPolygon
+{
+	size_t first_corner;
+	uint32_t num_corners;
+	ObjCorner* target;
+};
+
+struct ObjChunk
+{
+	const char* begin = nullptr;
+	const char* end = nullptr;
+	uint64_t num_positions = 0;
+	uint64_t num_texcoords = 0;
+	uint64_t num_normals = 0;
+	uint64_t base_position = 0;
+	uint64_t base_texcoord = 0;
+	uint64_t base_normal = 0;
+	std::vector<ObjRun> runs;
+	std::vector<ObjCorner> polygon_corners;
+	std::vector<ObjPolygon> polygons;
+	bool is_invalid_face = false;
+};
+
+struct ObjAttributes
+{
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT2> texcoords;
+	std::vector<XMFLOAT3> normals;
+	std::atomic<bool> is_out_of_bounds{ false };
+};
+
+// Triangles of one material in a shape
+struct ObjPart
+{
+	int material_index = 0;
+	uint64_t num_triangles = 0;
+	std::vector<ObjCorner> corners;
+	GeometryComponent::Primitive primitive;
+};
+
+struct ObjShape
+{
+	std::string name;
+	std::vector<ObjPart> parts;
+};
+
+static inline bool isObjSpace(const char c)
+{
+	return c == ' ' || c == '\t';
+}
+static inline const char* skipObjSpaces(const char* p, const char* end)
+{
+	while (p < end && isObjSpace(*p)) ++p;
+	return p;
+}
+
+// Returns the end of the line content (without the line break) and moves next_line to the following line
+static inline const char* findObjLineEnd(const char* p, const char* end, const char*& next_line)
+{
+	const char* eol = (const char*)memchr(p, '\n', end - p);
+	next_line = eol ? eol + 1 : end;
+	const char* line_end = eol ? eol : end;
+	const char* cr = (const char*)memchr(p, '\r', line_end - p); // like tinyobj, the content ends at '\r'
+	return cr ? cr : line_end;
+}
+
+static inline ObjLine classifyObjLine(const char*& p, const char* line_end)
+{
+	p = skipObjSpaces(p, line_end);
+	const size_t length = line_end - p;
+	if (length < 2)
 	{
-		membuf sbuf((char*)filedata.data(), (char*)filedata.data() + filedata.size());
-		std::istream in(&sbuf);
-		MaterialFileReader matFileReader(directory);
-		success = tinyobj::LoadObj(&obj_attrib, &obj_shapes, &obj_materials, &obj_errors, &in, &matFileReader, true);
+		return ObjLine::OTHER;
 	}
-	else
+	switch (p[0])
+	{
+	case 'v':
+		if (isObjSpace(p[1])) { p += 2; return ObjLine::POSITION; }
+		if (length > 2 && isObjSpace(p[2]))
+		{
+			if (p[1] == 't') { p += 3; return ObjLine::TEXCOORD; }
+			if (p[1] == 'n') { p += 3; return ObjLine::NORMAL; }
+		}
+		break;
+	case 'f':
+		if (isObjSpace(p[1])) { p += 2; return ObjLine::FACE; }
+		break;
+	case 'g':
+		if (isObjSpace(p[1])) { p += 1; return ObjLine::GROUP; }
+		break;
+	case 'o':
+		if (isObjSpace(p[1])) { p += 2; return ObjLine::OBJECT; }
+		break;
+	case 'u':
+		if (length > 6 && memcmp(p, "usemtl", 6) == 0 && isObjSpace(p[6])) { p += 7; return ObjLine::USEMTL; }
+		break;
+	case 'm':
+		if (length > 6 && memcmp(p, "mtllib", 6) == 0 && isObjSpace(p[6])) { p += 7; return ObjLine::MTLLIB; }
+		break;
+	default:
+		break;
+	}
+	return ObjLine::OTHER;
+}
+
+// from_chars based float parse of the next token, 0 for a missing or malformed value (like tinyobj)
+static inline float parseObjFloat(const char*& p, const char* line_end)
+{
+	p = skipObjSpaces(p, line_end);
+	const char* first = p < line_end && *p == '+' ? p + 1 : p;
+	float value = 0;
+	std::from_chars_result result = std::from_chars(first, line_end, value);
+	if (result.ec != std::errc())
+	{
+		value = 0;
+	}
+	p = std::max(p, result.ptr);
+	while (p < line_end && !isObjSpace(*p)) ++p;
+	return value;
+}
+
+// atoi-like parse of an index, stops at the first non-digit
+static inline int parseObjIndex(const char*& p, const char* line_end)
+{
+	bool negative = false;
+	if (p < line_end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+	int value = 0;
+	while (p < line_end && (unsigned)(*p - '0') < 10u)
+	{
+		value = value * 10 + (*p - '0');
+		++p;
+	}
+	return negative ? -value : value;
+}
+
+// Parses a v, v/vt, v//vn or v/vt/vn corner, counts are the attribute counts so far (for relative indices)
+//	returns false for a zero index, which is not allowed
+static inline bool parseObjCorner(const char*& p, const char* line_end, const uint64_t counts[3], ObjCorner& corner)
+{
+	auto fixIndex = [](const int index, const uint64_t count, int& result) {
+		if (index == 0)
+			return false;
+		result = index > 0 ? index - 1 : (int)((int64_t)count + index);
+		return true;
+		};
+	auto skipField = [&]() {
+		while (p < line_end && *p != '/' && !isObjSpace(*p)) ++p;
+		};
+
+	corner = { -1, -1, -1 };
+	if (!fixIndex(parseObjIndex(p, line_end), counts[0], corner.v))
+		return false;
+	skipField();
+	if (p >= line_end || *p != '/')
+		return true;
+	++p;
+	if (p < line_end && *p == '/')
+	{
+		++p;
+		if (!fixIndex(parseObjIndex(p, line_end), counts[2], corner.vn))
+			return false;
+		skipField();
+		return true;
+	}
+	if (!fixIndex(parseObjIndex(p, line_end), counts[1], corner.vt))
+		return false;
+	skipField();
+	if (p >= line_end || *p != '/')
+		return true;
+	++p;
+	if (!fixIndex(parseObjIndex(p, line_end), counts[2], corner.vn))
+		return false;
+	skipField();
+	return true;
+}
+
+// Step 2: counts the attributes and triangles of the chunk and collects its statements
+static void scanObjChunk(ObjChunk& chunk)
+{
+	chunk.runs.emplace_back();
+	const char* next_line = chunk.begin;
+	while (next_line < chunk.end)
+	{
+		const char* p = next_line;
+		const char* line_end = findObjLineEnd(p, chunk.end, next_line);
+		const ObjLine line = classifyObjLine(p, line_end);
+		switch (line)
+		{
+		case ObjLine::POSITION: chunk.num_positions++; break;
+		case ObjLine::TEXCOORD: chunk.num_texcoords++; break;
+		case ObjLine::NORMAL: chunk.num_normals++; break;
+		case ObjLine::FACE:
+		{
+			uint32_t num_corners = 0;
+			p = skipObjSpaces(p, line_end);
+			while (p < line_end)
+			{
+				num_corners++;
+				while (p < line_end && !isObjSpace(*p)) ++p;
+				p = skipObjSpaces(p, line_end);
+			}
+			if (num_corners >= 3)
+			{
+				chunk.runs.back().num_triangles += num_corners - 2;
+			}
+			break;
+		}
+		case ObjLine::USEMTL:
+		case ObjLine::MTLLIB:
+		case ObjLine::GROUP:
+		case ObjLine::OBJECT:
+			chunk.runs.emplace_back();
+			chunk.runs.back().statement = line;
+			chunk.runs.back().argument.assign(p, line_end);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// Step 3: resolves the statements in file order, like tinyobj::LoadObj does line by line
+static void resolveObjRuns(std::vector<ObjChunk>& chunks, const std::string& directory,
+	std::vector<tinyobj::material_t>& materials, std::vector<ObjShape>& shapes, std::string& errors)
+{
+	MaterialFileReader matFileReader(directory);
+	std::map<std::string, int> material_map;
+	int material = -1;
+
+	shapes.emplace_back();
+	for (ObjChunk& chunk : chunks)
+	{
+		for (ObjRun& run : chunk.runs)
+		{
+			switch (run.statement)
+			{
+			case ObjLine::USEMTL:
+			{
+				auto it = material_map.find(run.argument);
+				material = it != material_map.end() ? it->second : -1;
+				break;
+			}
+			case ObjLine::MTLLIB:
+			{
+				std::vector<std::string> filenames;
+				tinyobj::SplitString(run.argument, ' ', filenames);
+				if (filenames.empty())
+				{
+					errors += "WARN: Looks like empty filename for mtllib. Use default material. \n";
+					break;
+				}
+				bool found = false;
+				for (const std::string& filename : filenames)
+				{
+					std::string err_mtl;
+					found = matFileReader(filename, &materials, &material_map, &err_mtl);
+					errors += err_mtl;
+					if (found)
+						break;
+				}
+				if (!found)
+				{
+					errors += "WARN: Failed to load material file(s). Use default material.\n";
+				}
+				break;
+			}
+			case ObjLine::GROUP:
+			case ObjLine::OBJECT:
+			{
+				// a shape without faces is replaced (its name is never used)
+				if (!shapes.back().parts.empty())
+				{
+					shapes.emplace_back();
+				}
+				std::string& name = shapes.back().name;
+				name.clear();
+				if (run.statement == ObjLine::OBJECT)
+				{
+					name = run.argument;
+					break;
+				}
+				// multiple group names are concatenated with a space
+				const char* p = run.argument.c_str();
+				const char* end = p + run.argument.size();
+				while ((p = skipObjSpaces(p, end)) < end)
+				{
+					const char* name_end = p;
+					while (name_end < end && !isObjSpace(*name_end)) ++name_end;
+					if (!name.empty())
+						name += ' ';
+					name.append(p, name_end);
+					p = name_end;
+				}
+				if (name.empty())
+				{
+					errors += "WARN: Empty group name.\n";
+				}
+				break;
+			}
+			default:
+				break;
+			}
+
+			if (run.num_triangles == 0)
+			{
+				continue;
+			}
+			ObjShape& shape = shapes.back();
+			const int material_index = std::max(0, material); // this indexes the material library
+			size_t part_index = 0;
+			while (part_index < shape.parts.size() && shape.parts[part_index].material_index != material_index)
+			{
+				part_index++;
+			}
+			if (part_index == shape.parts.size())
+			{
+				shape.parts.emplace_back();
+				shape.parts.back().material_index = material_index;
+			}
+			ObjPart& part = shape.parts[part_index];
+			run.shape_index = (uint32_t)(shapes.size() - 1);
+			run.part_index = (uint32_t)part_index;
+			run.triangle_offset = part.num_triangles;
+			part.num_triangles += run.num_triangles;
+		}
+	}
+	if (shapes.back().parts.empty())
 	{
-		obj_errors = "Failed to read file: " + fileName;
+		shapes.pop_back();
 	}
+}
+
+// Step 4: parses the attributes and faces of the chunk into their final place
+static void parseObjChunk(ObjChunk& chunk, ObjAttributes& attributes)
+{
+	const uint64_t totals[3] = { attributes.positions.size(), attributes.texcoords.size(), attributes.normals.size() };
+	uint64_t counts[3] = { chunk.base_position, chunk.base_texcoord, chunk.base_normal };
+	size_t run_index = 0;
+	ObjCorner* target = chunk.runs[0].target;
+	std::vector<ObjCorner> polygon;
+
+	const char* next_line = chunk.begin;
+	while (next_line < chunk.end)
+	{
+		const char* p = next_line;
+		const char* line_end = findObjLineEnd(p, chunk.end, next_line);
+		switch (classifyObjLine(p, line_end))
+		{
+		case ObjLine::POSITION:
+		{
+			XMFLOAT3& position = attributes.positions[counts[0]++];
+			position.x = parseObjFloat(p, line_end);
+			position.y = parseObjFloat(p, line_end);
+			position.z = parseObjFloat(p, line_end);
+			break;
+		}
+		case ObjLine::TEXCOORD:
+		{
+			XMFLOAT2& texcoord = attributes.texcoords[counts[1]++];
+			texcoord.x = parseObjFloat(p, line_end);
+			texcoord.y = parseObjFloat(p, line_end);
+			break;
+		}
+		case ObjLine::NORMAL:
+		{
+			XMFLOAT3& normal = attributes.normals[counts[2]++];
+			normal.x = parseObjFloat(p, line_end);
+			normal.y = parseObjFloat(p, line_end);
+			normal.z = parseObjFloat(p, line_end);
+			break;
+		}
+		case ObjLine::FACE:
+		{
+			polygon.clear();
+			p = skipObjSpaces(p, line_end);
+			while (p < line_end)
+			{
+				ObjCorner corner;
+				if (!parseObjCorner(p, line_end, counts, corner))
+				{
+					chunk.is_invalid_face = true;
+					return;
+				}
+				bool is_out_of_bounds = false;
+				int* indices[3] = { &corner.v, &corner.vt, &corner.vn };
+				for (int i = 0; i < 3; ++i)
+				{
+					if (*indices[i] < -1 || (*indices[i] >= 0 && (uint64_t)*indices[i] >= totals[i]))
+					{
+						*indices[i] = -1;
+						is_out_of_bounds = true;
+					}
+				}
+				if (is_out_of_bounds)
+				{
+					attributes.is_out_of_bounds.store(true, std::memory_order_relaxed);
+				}
+				polygon.push_back(corner);
+				while (p < line_end && !isObjSpace(*p)) ++p;
+				p = skipObjSpaces(p, line_end);
+			}
+			const uint32_t num_corners = (uint32_t)polygon.size();
+			if (num_corners < 3)
+			{
+				break;
+			}
+			if (num_corners == 3)
+			{
+				std::memcpy(target, polygon.data(), sizeof(ObjCorner) * 3);
+			}
+			else
+			{
+				chunk.polygons.push_back({ chunk.polygon_corners.size(), num_corners, target });
+				chunk.polygon_corners.insert(chunk.polygon_corners.end(), polygon.begin(), polygon.end());
+			}
+			target += (num_corners - 2) * 3;
+			break;
+		}
+		case ObjLine::USEMTL:
+		case ObjLine::MTLLIB:
+		case ObjLine::GROUP:
+		case ObjLine::OBJECT:
+			target = chunk.runs[++run_index].target;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// Ear clipping of a polygon as done by tinyobj's triangulation, always writes (num_corners - 2) triangles:
+//	whatever is left when the ear search gives up is fan triangulated (tinyobj drops it)
+static void triangulateObjPolygon(const ObjCorner* polygon, const uint32_t num_corners,
+	const std::vector<XMFLOAT3>& positions, std::vector<ObjCorner>& remaining, ObjCorner* target)
+{
+	auto getCoord = [&positions](const int v, const size_t axis, float& coord) {
+		if (v < 0)
+			return false;
+		const XMFLOAT3& position = positions[v];
+		coord = axis == 0 ? position.x : (axis == 1 ? position.y : position.z);
+		return true;
+		};
+	auto emit = [&target](const ObjCorner& c0, const ObjCorner& c1, const ObjCorner& c2) {
+		target[0] = c0;
+		target[1] = c1;
+		target[2] = c2;
+		target += 3;
+		};
+
+	// find the two axes to work in
+	size_t axes[2] = { 1, 2 };
+	for (uint32_t k = 0; k < num_corners; ++k)
+	{
+		const int vi[3] = { polygon[k].v, polygon[(k + 1) % num_corners].v, polygon[(k + 2) % num_corners].v };
+		if (vi[0] < 0 || vi[1] < 0 || vi[2] < 0)
+		{
+			continue;
+		}
+		const XMFLOAT3& p0 = positions[vi[0]];
+		const XMFLOAT3& p1 = positions[vi[1]];
+		const XMFLOAT3& p2 = positions[vi[2]];
+		const float e0x = p1.x - p0.x, e0y = p1.y - p0.y, e0z = p1.z - p0.z;
+		const float e1x = p2.x - p1.x, e1y = p2.y - p1.y, e1z = p2.z - p1.z;
+		const float cx = std::fabs(e0y * e1z - e0z * e1y);
+		const float cy = std::fabs(e0z * e1x - e0x * e1z);
+		const float cz = std::fabs(e0x * e1y - e0y * e1x);
+		const float epsilon = std::numeric_limits<float>::epsilon();
+		if (cx > epsilon || cy > epsilon || cz > epsilon)
+		{
+			if (!(cx > cy && cx > cz))
+			{
+				axes[0] = 0;
+				if (cz > cx && cz > cy)
+					axes[1] = 1;
+			}
+			break;
+		}
+	}
+
+	float area = 0;
+	for (uint32_t k = 0; k < num_corners; ++k)
+	{
+		float v0x, v0y, v1x, v1y;
+		if (!getCoord(polygon[k].v, axes[0], v0x) || !getCoord(polygon[k].v, axes[1], v0y)
+			|| !getCoord(polygon[(k + 1) % num_corners].v, axes[0], v1x) || !getCoord(polygon[(k + 1) % num_corners].v, axes[1], v1y))
+		{
+			continue;
+		}
+		area += (v0x * v1y - v0y * v1x) * 0.5f;
+	}
+
+	remaining.assign(polygon, polygon + num_corners);
+	int max_rounds = 10; // arbitrary max loop count to protect against unexpected errors
+	size_t guess_vert = 0;
+	ObjCorner ind[3];
+	float vx[3];
+	float vy[3];
+	while (remaining.size() > 3 && max_rounds > 0)
+	{
+		const size_t npolys = remaining.size();
+		if (guess_vert >= npolys)
+		{
+			max_rounds -= 1;
+			guess_vert -= npolys;
+		}
+		for (size_t k = 0; k < 3; k++)
+		{
+			ind[k] = remaining[(guess_vert + k) % npolys];
+			if (!getCoord(ind[k].v, axes[0], vx[k]) || !getCoord(ind[k].v, axes[1], vy[k]))
+			{
+				vx[k] = 0;
+				vy[k] = 0;
+			}
+		}
+		const float e0x = vx[1] - vx[0];
+		const float e0y = vy[1] - vy[0];
+		const float e1x = vx[2] - vx[1];
+		const float e1y = vy[2] - vy[1];
+		const float cross = e0x * e1y - e0y * e1x;
+		// if an internal angle
+		if (cross * area < 0)
+		{
+			guess_vert += 1;
+			continue;
+		}
+
+		// check all other verts in case they are inside this triangle
+		bool overlap = false;
+		for (size_t other_vert = 3; other_vert < npolys; ++other_vert)
+		{
+			float tx, ty;
+			const int ovi = remaining[(guess_vert + other_vert) % npolys].v;
+			if (!getCoord(ovi, axes[0], tx) || !getCoord(ovi, axes[1], ty))
+			{
+				continue;
+			}
+			if (tinyobj::pnpoly(3, vx, vy, tx, ty))
+			{
+				overlap = true;
+				break;
+			}
+		}
+		if (overlap)
+		{
+			guess_vert += 1;
+			continue;
+		}
+
+		// this triangle is an ear
+		emit(ind[0], ind[1], ind[2]);
+		remaining.erase(remaining.begin() + (guess_vert + 1) % npolys);
+	}
+
+	for (size_t k = 1; k + 1 < remaining.size(); ++k)
+	{
+		emit(remaining[0], remaining[k], remaining[k + 1]);
+	}
+}
+
+// Unique vertices of a set of corners: open-addressing (linear probing) table of ids into a dense key array,
+//	sized from the corner count so it never rehashes
+struct ObjVertexTable
+{
+	std::vector<uint32_t> slots;
+	uint64_t mask = 0;
+	std::vector<ObjCorner> keys;
+
+	void Reset(const size_t max_keys)
+	{
+		const uint64_t size = math::GetNextPowerOfTwo((uint64_t)(max_keys + max_keys / 2 + 1));
+		slots.assign(size, ~0u);
+		mask = size - 1;
+		keys.clear();
+	}
+	inline uint32_t Insert(const ObjCorner& key, const uint64_t hash)
+	{
+		uint64_t slot = hash & mask;
+		while (slots[slot] != ~0u)
+		{
+			if (keys[slots[slot]] == key)
+				return slots[slot];
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = (uint32_t)keys.size();
+		keys.push_back(key);
+		return slots[slot];
+	}
+};
+
+static inline void writeObjVertex(const ObjAttributes& attributes, const ObjCorner& key, XMFLOAT3& position, XMFLOAT3& normal, XMFLOAT2& uv)
+{
+	position = key.v >= 0 ? attributes.positions[key.v] : XMFLOAT3(0, 0, 0);
+	normal = key.vn >= 0 ? attributes.normals[key.vn] : XMFLOAT3(0, 0, 0);
+	uv = key.vt >= 0 ? XMFLOAT2(attributes.texcoords[key.vt].x, 1 - attributes.texcoords[key.vt].y) : XMFLOAT2(0, 0);
+	if (transform_to_LH)
+	{
+		position.z *= -1;
+		normal.z *= -1;
+	}
+}
+
+// Step 5: deduplicates the corners of a part into the vertices and indices of its triangle primitive
+//	large parts are split into buckets by the top hash bits, which are deduplicated in parallel
+static void buildObjPrimitive(const ObjAttributes& attributes, ObjPart& part)
+{
+	std::vector<ObjCorner>& corners = part.corners;
+	GeometryComponent::Primitive& primitive = part.primitive;
+	primitive.SetPrimitiveType(GeometryComponent::PrimitiveType::TRIANGLES);
+	if (flipCulling)
+	{
+		for (size_t i = 0; i + 2 < corners.size(); i += 3)
+		{
+			std::swap(corners[i + 1], corners[i + 2]);
+		}
+	}
+
+	std::vector<XMFLOAT3>& vertex_positions = primitive.GetMutableVtxPositions();
+	std::vector<XMFLOAT3>& vertex_normals = primitive.GetMutableVtxNormals();
+	std::vector<XMFLOAT2>& vertex_uvSet0 = primitive.GetMutableVtxUVSet0();
+	std::vector<uint32_t>& indices = primitive.GetMutableIdxPrimives();
+
+	const uint32_t num_corners = (uint32_t)corners.size();
+	indices.resize(num_corners);
+
+	auto writeVertices = [&](const std::vector<ObjCorner>& keys, const size_t first_vertex) {
+		for (size_t i = 0, n = keys.size(); i < n; ++i)
+		{
+			writeObjVertex(attributes, keys[i], vertex_positions[first_vertex + i], vertex_normals[first_vertex + i], vertex_uvSet0[first_vertex + i]);
+		}
+		};
+
+	const uint32_t bucket_bits = std::min(8u, (uint32_t)std::log2(std::max(1.0, (double)num_corners / OBJ_DEDUP_BUCKET_SIZE)));
+	if (bucket_bits == 0)
+	{
+		ObjVertexTable table;
+		table.Reset(num_corners);
+		for (uint32_t i = 0; i < num_corners; ++i)
+		{
+			indices[i] = table.Insert(corners[i], corners[i].hash());
+		}
+		vertex_positions.resize(table.keys.size());
+		vertex_normals.resize(table.keys.size());
+		vertex_uvSet0.resize(table.keys.size());
+		writeVertices(table.keys, 0);
+		return;
+	}
+
+	const uint32_t num_buckets = 1u << bucket_bits;
+	auto getBucket = [bucket_bits](const uint64_t hash) { return (uint32_t)(hash >> (64 - bucket_bits)); };
+
+	// counting sort of the corners by bucket
+	const uint32_t block_size = 64 * 1024;
+	const uint32_t num_blocks = (num_corners + block_size - 1) / block_size;
+	std::vector<uint32_t> block_offsets((size_t)num_blocks * num_buckets, 0u);
+	jobsystem::context ctx;
+	jobsystem::Dispatch(ctx, num_blocks, 1, [&](jobsystem::JobArgs args) {
+		uint32_t* counts = &block_offsets[(size_t)args.jobIndex * num_buckets];
+		for (uint32_t i = args.jobIndex * block_size, n = std::min(num_corners, i + block_size); i < n; ++i)
+		{
+			counts[getBucket(corners[i].hash())]++;
+		}
+		});
+	jobsystem::Wait(ctx);
+
+	std::vector<uint32_t> bucket_offsets(num_buckets + 1, 0u);
+	for (uint32_t bucket = 0, offset = 0; bucket < num_buckets; ++bucket)
+	{
+		bucket_offsets[bucket] = offset;
+		for (uint32_t block = 0; block < num_blocks; ++block)
+		{
+			uint32_t count = block_offsets[(size_t)block * num_buckets + bucket];
+			block_offsets[(size_t)block * num_buckets + bucket] = offset;
+			offset += count;
+		}
+		bucket_offsets[bucket + 1] = offset;
+	}
+
+	std::vector<uint32_t> sorted_corners(num_corners);
+	jobsystem::Dispatch(ctx, num_blocks, 1, [&](jobsystem::JobArgs args) {
+		uint32_t* offsets = &block_offsets[(size_t)args.jobIndex * num_buckets];
+		for (uint32_t i = args.jobIndex * block_size, n = std::min(num_corners, i + block_size); i < n; ++i)
+		{
+			sorted_corners[offsets[getBucket(corners[i].hash())]++] = i;
+		}
+		});
+	jobsystem::Wait(ctx);
+
+	// bucket local dedup, then the buckets' vertices are placed one after another
+	std::vector<std::vector<ObjCorner>> bucket_keys(num_buckets);
+	jobsystem::Dispatch(ctx, num_buckets, 1, [&](jobsystem::JobArgs args) {
+		const uint32_t bucket = args.jobIndex;
+		ObjVertexTable table;
+		table.Reset(bucket_offsets[bucket + 1] - bucket_offsets[bucket]);
+		for (uint32_t i = bucket_offsets[bucket]; i < bucket_offsets[bucket + 1]; ++i)
+		{
+			const uint32_t corner = sorted_corners[i];
+			indices[corner] = table.Insert(corners[corner], corners[corner].hash());
+		}
+		bucket_keys[bucket] = std::move(table.keys);
+		});
+	jobsystem::Wait(ctx);
+
+	std::vector<uint32_t> bucket_first_vertex(num_buckets + 1, 0u);
+	for (uint32_t bucket = 0; bucket < num_buckets; ++bucket)
+	{
+		bucket_first_vertex[bucket + 1] = bucket_first_vertex[bucket] + (uint32_t)bucket_keys[bucket].size();
+	}
+	const size_t num_vertices = bucket_first_vertex[num_buckets];
+	vertex_positions.resize(num_vertices);
+	vertex_normals.resize(num_vertices);
+	vertex_uvSet0.resize(num_vertices);
+
+	jobsystem::Dispatch(ctx, num_buckets, 1, [&](jobsystem::JobArgs args) {
+		const uint32_t bucket = args.jobIndex;
+		const uint32_t first_vertex = bucket_first_vertex[bucket];
+		writeVertices(bucket_keys[bucket], first_vertex);
+		for (uint32_t i = bucket_offsets[bucket]; i < bucket_offsets[bucket + 1]; ++i)
+		{
+			indices[sorted_corners[i]] += first_vertex;
+		}
+		std::vector<ObjCorner>().swap(bucket_keys[bucket]);
+		});
+	jobsystem::Wait(ctx);
+}
+
+// Reads the OBJ file (and its material libraries) into shapes whose parts hold finished triangle primitives
+static bool loadObj(const std::string& fileName, const std::string& directory,
+	std::vector<tinyobj::material_t>& materials, std::vector<ObjShape>& shapes, std::string& errors)
+{
+	size_t size = 0;
+	std::shared_ptr<const void> mapped = helper::FileMap(fileName, size);
+	std::vector<uint8_t> filedata;
+	const char* data = (const char*)mapped.get();
+	if (data == nullptr)
+	{
+		if (!helper::FileRead(fileName, filedata))
+		{
+			errors = "Failed to read file: " + fileName;
+			return false;
+		}
+		data = (const char*)filedata.data();
+		size = filedata.size();
+	}
+
+	// line aligned chunks
+	std::vector<ObjChunk> chunks;
+	for (const char* begin = data, *end = data + size; begin < end; )
+	{
+		ObjChunk& chunk = chunks.emplace_back();
+		chunk.begin = begin;
+		chunk.end = begin + std::min(OBJ_CHUNK_SIZE, (size_t)(end - begin));
+		if (chunk.end < end)
+		{
+			const char* eol = (const char*)memchr(chunk.end, '\n', end - chunk.end);
+			chunk.end = eol ? eol + 1 : end;
+		}
+		begin = chunk.end;
+	}
+	const uint32_t num_chunks = (uint32_t)chunks.size();
+
+	jobsystem::context ctx;
+	jobsystem::Dispatch(ctx, num_chunks, 1, [&](jobsystem::JobArgs args) {
+		scanObjChunk(chunks[args.jobIndex]);
+		});
+	jobsystem::Wait(ctx);
+
+	resolveObjRuns(chunks, directory, materials, shapes, errors);
+
+	ObjAttributes attributes;
+	uint64_t num_positions = 0, num_texcoords = 0, num_normals = 0;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.base_position = num_positions;
+		chunk.base_texcoord = num_texcoords;
+		chunk.base_normal = num_normals;
+		num_positions += chunk.num_positions;
+		num_texcoords += chunk.num_texcoords;
+		num_normals += chunk.num_normals;
+	}
+	attributes.positions.resize(num_positions);
+	attributes.texcoords.resize(num_texcoords);
+	attributes.normals.resize(num_normals);
+	for (ObjShape& shape : shapes)
+	{
+		for (ObjPart& part : shape.parts)
+		{
+			part.corners.resize(part.num_triangles * 3);
+		}
+	}
+	for (ObjChunk& chunk : chunks)
+	{
+		for (ObjRun& run : chunk.runs)
+		{
+			if (run.num_triangles > 0)
+			{
+				run.target = shapes[run.shape_index].parts[run.part_index].corners.data() + run.triangle_offset * 3;
+			}
+		}
+	}
+
+	jobsystem::Dispatch(ctx, num_chunks, 1, [&](jobsystem::JobArgs args) {
+		parseObjChunk(chunks[args.jobIndex], attributes);
+		});
+	jobsystem::Wait(ctx);
+
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (chunk.is_invalid_face)
+		{
+			errors += "Failed parse `f' line(e.g. zero value for face index).\n";
+			return false;
+		}
+	}
+	if (attributes.is_out_of_bounds.load())
+	{
+		errors += "WARN: Vertex, normal or texcoord indices out of bounds.\n";
+	}
+
+	jobsystem::Dispatch(ctx, num_chunks, 1, [&](jobsystem::JobArgs args) {
+		ObjChunk& chunk = chunks[args.jobIndex];
+		std::vector<ObjCorner> remaining;
+		for (const ObjPolygon& polygon : chunk.polygons)
+		{
+			triangulateObjPolygon(&chunk.polygon_corners[polygon.first_corner], polygon.num_corners, attributes.positions, remaining, polygon.target);
+		}
+		std::vector<ObjCorner>().swap(chunk.polygon_corners);
+		std::vector<ObjPolygon>().swap(chunk.polygons);
+		});
+	jobsystem::Wait(ctx);
+	chunks.clear();
+	mapped.reset();
+	std::vector<uint8_t>().swap(filedata);
+
+	// small parts are built in parallel, large ones one by one with a parallel dedup
+	std::vector<ObjPart*> small_parts;
+	std::vector<ObjPart*> large_parts;
+	for (ObjShape& shape : shapes)
+	{
+		for (ObjPart& part : shape.parts)
+		{
+			(part.corners.size() < OBJ_DEDUP_BUCKET_SIZE * 2 ? small_parts : large_parts).push_back(&part);
+		}
+	}
+	jobsystem::Dispatch(ctx, (uint32_t)small_parts.size(), 1, [&](jobsystem::JobArgs args) {
+		ObjPart& part = *small_parts[args.jobIndex];
+		buildObjPrimitive(attributes, part);
+		std::vector<ObjCorner>().swap(part.corners);
+		});
+	jobsystem::Wait(ctx);
+	for (ObjPart* part : large_parts)
+	{
+		buildObjPrimitive(attributes, *part);
+		std::vector<ObjCorner>().swap(part->corners);
+	}
+
+	return true;
+}
+
+Entity ImportModel_OBJ(const std::string& fileName)
+{
+	std::string directory = helper::GetDirectoryFromPath(fileName);
+	std::string name = helper::GetFileNameFromPath(fileName);
+
+	std::vector<ObjShape> obj_shapes;
+	std::vector<tinyobj::material_t> obj_materials;
+	std::string obj_errors;
+
+	bool success = loadObj(fileName, directory, obj_materials, obj_shapes, obj_errors);
 
 	if (!obj_errors.empty())
 	{
@@ -170,7 +1087,7 @@ Entity ImportModel_OBJ(const std::string& fileName)
 		}
 
 		// Load actors, meshes:
-		for (auto& shape : obj_shapes)
+		for (ObjShape& shape : obj_shapes)
 		{
 			Entity actor_entity = compfactory::MakeNodeStaticMeshActor(shape.name, root_entity);
 
@@ -181,101 +1098,13 @@ Entity ImportModel_OBJ(const std::string& fileName)
 
 			GeometryComponent& mesh = *compfactory::GetGeometryComponent(mesh_entity);
 
-			unordered_map<int, int> registered_materialIndices = {};
-			unordered_map<size_t, uint32_t> unique_vertices = {};
-
-			GeometryComponent::Primitive* mutable_primitive = nullptr;
-			std::vector<XMFLOAT3>* vertex_positions = nullptr;
-			std::vector<XMFLOAT3>* vertex_normals = nullptr;
-			std::vector<XMFLOAT2>* vertex_uvSet0 = nullptr;
-			std::vector<uint32_t>* indices = nullptr;
-			for (size_t i = 0; i < shape.mesh.indices.size(); i += 3)
+			for (size_t part_index = 0, num_parts = shape.parts.size(); part_index < num_parts; ++part_index)
 			{
-				tinyobj::index_t reordered_indices[] = {
-					shape.mesh.indices[i + 0],
-					shape.mesh.indices[i + 1],
-					shape.mesh.indices[i + 2],
-				};
-
-				// todo: option param would be better
-				bool flipCulling = false;
-				if (flipCulling)
-				{
-					reordered_indices[1] = shape.mesh.indices[i + 2];
-					reordered_indices[2] = shape.mesh.indices[i + 1];
-				}
-
-				for (auto& index : reordered_indices)
-				{
-					XMFLOAT3 pos = XMFLOAT3(
-						obj_attrib.vertices[index.vertex_index * 3 + 0],
-						obj_attrib.vertices[index.vertex_index * 3 + 1],
-						obj_attrib.vertices[index.vertex_index * 3 + 2]
-					);
-
-					XMFLOAT3 nor = XMFLOAT3(0, 0, 0);
-					if (!obj_attrib.normals.empty())
-					{
-						nor = XMFLOAT3(
-							obj_attrib.normals[index.normal_index * 3 + 0],
-							obj_attrib.normals[index.normal_index * 3 + 1],
-							obj_attrib.normals[index.normal_index * 3 + 2]
-						);
-					}
-
-					XMFLOAT2 tex = XMFLOAT2(0, 0);
-					if (index.texcoord_index >= 0 && !obj_attrib.texcoords.empty())
-					{
-						tex = XMFLOAT2(
-							obj_attrib.texcoords[index.texcoord_index * 2 + 0],
-							1 - obj_attrib.texcoords[index.texcoord_index * 2 + 1]
-						);
-					}
-
-					int material_index = std::max(0, shape.mesh.material_ids[i / 3]); // this indexes the material library
-					if (registered_materialIndices.count(material_index) == 0)
-					//if (!registered_materialIndices.contains(material_index))	// c++ 20
-					{
-						size_t part_index = mesh.GetNumParts();
-						registered_materialIndices[material_index] = (int)part_index;
-						GeometryComponent::Primitive empty_primitive;
-						mesh.CopyPrimitiveFrom(empty_primitive, part_index);
-						renderable.SetMaterial(materials[material_index], part_index);
-						//mesh.subsets.back().indexOffset = (uint32_t)mesh.indices.size();
-						mutable_primitive = mesh.GetMutablePrimitive(part_index);
-						mutable_primitive->SetPrimitiveType(GeometryComponent::PrimitiveType::TRIANGLES);
-
-						vertex_positions = &mutable_primitive->GetMutableVtxPositions();
-						vertex_normals = &mutable_primitive->GetMutableVtxNormals();
-						vertex_uvSet0 = &mutable_primitive->GetMutableVtxUVSet0();
-						indices = &mutable_primitive->GetMutableIdxPrimives();
-					}
-					assert(mutable_primitive);
-
-					if (transform_to_LH)
-					{
-						pos.z *= -1;
-						nor.z *= -1;
-					}
-
-					// eliminate duplicate vertices by means of hashing:
-					size_t vertex_hash = 0;
-					helper::hash_combine(vertex_hash, index.vertex_index);
-					helper::hash_combine(vertex_hash, index.normal_index);
-					helper::hash_combine(vertex_hash, index.texcoord_index);
-					helper::hash_combine(vertex_hash, material_index);
-
-					if (unique_vertices.count(vertex_hash) == 0)
-					//if (!unique_vertices.contains(vertex_hash)) c++ 20
-					{
-						unique_vertices[vertex_hash] = (uint32_t)vertex_positions->size();
-						vertex_positions->push_back(pos);
-						vertex_normals->push_back(nor);
-						vertex_uvSet0->push_back(tex);
-					}
-					indices->push_back(unique_vertices[vertex_hash]);
-				}
+				ObjPart& part = shape.parts[part_index];
+				mesh.MovePrimitiveFrom(std::move(part.primitive), part_index);
+				renderable.SetMaterial(materials[(size_t)part.material_index < materials.size() ? part.material_index : 0], part_index);
 			}
+			shape.parts.clear();
 			mesh.UpdateRenderData();
 		}
 
@@ -1,55 +1,914 @@
 #include "AssetIO.h"
 #include "Utils/Backlog.h"
 #include "Utils/Helpers.h"
-#include <cmath>
-#include <fstream>
-#include <iostream>
-#include <vector>
+#include "Utils/JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <cstring>
+#include <string>
+#include <vector>
 
 using namespace vz;
+using Primitive = GeometryComponent::Primitive;
+
+// rows decoded by one job, binary elements with lists keep one byte offset per block
+static constexpr size_t PLY_BLOCK_ROWS = 64 * 1024;
+// ascii bodies are split into line aligned chunks of about this size
+static constexpr size_t PLY_CHUNK_SIZE = 4 * 1024 * 1024;
+
+enum class PlyFormat
+{
+	ASCII,
+	BINARY_LITTLE_ENDIAN,
+	BINARY_BIG_ENDIAN,
+};
+
+enum class PlyType : uint8_t
+{
+	NONE,
+	INT8,
+	UINT8,
+	INT16,
+	UINT16,
+	INT32,
+	UINT32,
+	FLOAT32,
+	FLOAT64,
+};
+
+// What a property feeds, the vertex semantics index PlyVertexValues
+enum PlySemantic : uint8_t
+{
+	PLY_X, PLY_Y, PLY_Z,
+	PLY_NX, PLY_NY, PLY_NZ,
+	PLY_RED, PLY_GREEN, PLY_BLUE, PLY_ALPHA,
+	PLY_U, PLY_V,
+	PLY_SEMANTIC_COUNT,
+
+	PLY_IGNORED = PLY_SEMANTIC_COUNT,
+	PLY_FACE_INDICES,
+};
+
+struct PlyProperty
+{
+	std::string name;
+	PlyType type = PlyType::NONE;		// value type, item type for a list
+	PlyType countType = PlyType::NONE;	// NONE for a scalar property
+	uint8_t semantic = PLY_IGNORED;
+	float scale = 1.f;					// color values are scaled to 0..255
+
+	inline bool IsList() const { return countType != PlyType::NONE; }
+};
+
+struct PlyElement
+{
+	std::string name;
+	size_t count = 0;
+	std::vector<PlyProperty> properties;
+	size_t stride = 0;	// binary row size in bytes, 0 if the element has lists
+	size_t begin = 0;	// binary body range of the element
+	size_t end = 0;
+	std::vector<size_t> blockOffsets;	// binary element with lists: offset of every PLY_BLOCK_ROWS-th row
+};
+
+struct PlyHeader
+{
+	PlyFormat format = PlyFormat::ASCII;
+	std::vector<PlyElement> elements;
+	size_t bodyOffset = 0;
+	int vertexElement = -1;
+	int faceElement = -1;
+};
+
+struct PlyVertexOutput
+{
+	XMFLOAT3* positions = nullptr;
+	XMFLOAT3* normals = nullptr;
+	uint32_t* colors = nullptr;
+	XMFLOAT2* uvs = nullptr;
+};
+
+struct PlyVertexValues
+{
+	float v[PLY_SEMANTIC_COUNT];
+
+	inline void Reset()
+	{
+		std::fill(v, v + PLY_SEMANTIC_COUNT, 0.f);
+		v[PLY_ALPHA] = 255.f;
+	}
+};
+
+static inline size_t plyTypeSize(const PlyType type)
+{
+	switch (type)
+	{
+	case PlyType::INT8:
+	case PlyType::UINT8: return 1;
+	case PlyType::INT16:
+	case PlyType::UINT16: return 2;
+	case PlyType::INT32:
+	case PlyType::UINT32:
+	case PlyType::FLOAT32: return 4;
+	case PlyType::FLOAT64: return 8;
+	default: return 0;
+	}
+}
+
+static PlyType parsePlyType(const std::string& name)
+{
+	if (name == "char" || name == "int8") return PlyType::INT8;
+	if (name == "uchar" || name == "uint8") return PlyType::UINT8;
+	if (name == "short" || name == "int16") return PlyType::INT16;
+	if (name == "ushort" || name == "uint16") return PlyType::UINT16;
+	if (name == "int" || name == "int32") return PlyType::INT32;
+	if (name == "uint" || name == "uint32") return PlyType::UINT32;
+	if (name == "float" || name == "float32") return PlyType::FLOAT32;
+	if (name == "double" || name == "float64") return PlyType::FLOAT64;
+	return PlyType::NONE;
+}
+
+static uint8_t plyVertexSemantic(const std::string& name)
+{
+	if (name == "x") return PLY_X;
+	if (name == "y") return PLY_Y;
+	if (name == "z") return PLY_Z;
+	if (name == "nx" || name == "normal_x") return PLY_NX;
+	if (name == "ny" || name == "normal_y") return PLY_NY;
+	if (name == "nz" || name == "normal_z") return PLY_NZ;
+	if (name == "red" || name == "diffuse_red") return PLY_RED;
+	if (name == "green" || name == "diffuse_green") return PLY_GREEN;
+	if (name == "blue" || name == "diffuse_blue") return PLY_BLUE;
+	if (name == "alpha" || name == "diffuse_alpha") return PLY_ALPHA;
+	if (name == "u" || name == "s" || name == "texture_u" || name == "texture_s") return PLY_U;
+	if (name == "v" || name == "t" || name == "texture_v" || name == "texture_t") return PLY_V;
+	return PLY_IGNORED;
+}
+
+static void splitPlyLine(const char* begin, const char* end, std::vector<std::string>& tokens)
+{
+	tokens.clear();
+	const char* p = begin;
+	while (p < end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+		const char* token = p;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+		if (p > token)
+		{
+			tokens.emplace_back(token, p);
+		}
+	}
+}
+
+static bool parsePlyHeader(const char* data, const size_t size, PlyHeader& header, std::string& error)
+{
+	std::vector<std::string> tokens;
+	size_t offset = 0;
+	bool magic = false;
+	bool has_format = false;
+	while (offset < size)
+	{
+		const char* line = data + offset;
+		const char* eol = (const char*)memchr(line, '\n', size - offset);
+		const char* line_end = eol ? eol : data + size;
+		offset = eol ? (size_t)(eol - data) + 1 : size;
+		splitPlyLine(line, line_end, tokens);
+
+		if (!magic)
+		{
+			if (tokens.size() != 1 || tokens[0] != "ply")
+			{
+				error = "not a PLY file";
+				return false;
+			}
+			magic = true;
+			continue;
+		}
+		if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info")
+		{
+			continue;
+		}
+		if (tokens[0] == "end_header")
+		{
+			if (!has_format)
+			{
+				error = "missing format line";
+				return false;
+			}
+			header.bodyOffset = offset;
+			return true;
+		}
+		if (tokens[0] == "format")
+		{
+			if (tokens.size() < 2)
+			{
+				error = "invalid format line";
+				return false;
+			}
+			if (tokens[1] == "ascii") header.format = PlyFormat::ASCII;
+			else if (tokens[1] == "binary_little_endian") header.format = PlyFormat::BINARY_LITTLE_ENDIAN;
+			else if (tokens[1] == "binary_big_endian") header.format = PlyFormat::BINARY_BIG_ENDIAN;
+			else
+			{
+				error = "unknown format: " + tokens[1];
+				return false;
+			}
+			has_format = true;
+		}
+		else if (tokens[0] == "element")
+		{
+			if (tokens.size() < 3)
+			{
+				error = "invalid element line";
+				return false;
+			}
+			PlyElement& element = header.elements.emplace_back();
+			element.name = tokens[1];
+			const char* count_end = tokens[2].data() + tokens[2].size();
+			if (std::from_chars(tokens[2].data(), count_end, element.count).ptr != count_end)
+			{
+				error = "invalid element count: " + tokens[2];
+				return false;
+			}
+		}
+		else if (tokens[0] == "property")
+		{
+			if (header.elements.empty())
+			{
+				error = "property before any element";
+				return false;
+			}
+			PlyProperty property;
+			if (tokens.size() >= 5 && tokens[1] == "list")
+			{
+				property.countType = parsePlyType(tokens[2]);
+				property.type = parsePlyType(tokens[3]);
+				property.name = tokens[4];
+				if (property.countType == PlyType::NONE || property.type == PlyType::NONE)
+				{
+					error = "invalid list property: " + property.name;
+					return false;
+				}
+			}
+			else if (tokens.size() >= 3)
+			{
+				property.type = parsePlyType(tokens[1]);
+				property.name = tokens[2];
+				if (property.type == PlyType::NONE)
+				{
+					error = "unknown property type: " + tokens[1];
+					return false;
+				}
+			}
+			else
+			{
+				error = "invalid property line";
+				return false;
+			}
+			header.elements.back().properties.push_back(std::move(property));
+		}
+		else
+		{
+			error = "unknown header line: " + tokens[0];
+			return false;
+		}
+	}
+	error = "missing end_header";
+	return false;
+}
+
+// Float colors are stored as 0..1, integer colors as 0..max of their type
+static inline float plyColorScale(const PlyType type)
+{
+	switch (type)
+	{
+	case PlyType::INT8: return 255.f / 127.f;
+	case PlyType::INT16: return 255.f / 32767.f;
+	case PlyType::UINT16: return 255.f / 65535.f;
+	case PlyType::INT32: return float(255.0 / 2147483647.0);
+	case PlyType::UINT32: return float(255.0 / 4294967295.0);
+	case PlyType::FLOAT32:
+	case PlyType::FLOAT64: return 255.f;
+	case PlyType::UINT8:
+	default: return 1.f;
+	}
+}
+
+// Binds vertex and face properties to what they feed
+static void bindPlySemantics(PlyHeader& header)
+{
+	for (size_t element_index = 0, n = header.elements.size(); element_index < n; ++element_index)
+	{
+		PlyElement& element = header.elements[element_index];
+		if (element.name == "vertex" && header.vertexElement < 0)
+		{
+			header.vertexElement = (int)element_index;
+			for (PlyProperty& property : element.properties)
+			{
+				if (property.IsList())
+					continue;
+				property.semantic = plyVertexSemantic(property.name);
+				if (property.semantic >= PLY_RED && property.semantic <= PLY_ALPHA)
+				{
+					property.scale = plyColorScale(property.type);
+				}
+			}
+		}
+		else if (element.name == "face" && header.faceElement < 0)
+		{
+			header.faceElement = (int)element_index;
+			for (PlyProperty& property : element.properties)
+			{
+				if (property.IsList() && (property.name == "vertex_indices" || property.name == "vertex_index"))
+				{
+					property.semantic = PLY_FACE_INDICES;
+					break;
+				}
+			}
+		}
+	}
+}
+
+static inline uint32_t packPlyColor(const float* v)
+{
+	auto to_byte = [](const float x) { return (uint32_t)(std::min(std::max(x, 0.f), 255.f) + 0.5f); };
+	return to_byte(v[PLY_RED]) | (to_byte(v[PLY_GREEN]) << 8) | (to_byte(v[PLY_BLUE]) << 16) | (to_byte(v[PLY_ALPHA]) << 24);
+}
+
+static inline void storePlyVertex(const PlyVertexOutput& out, const size_t index, const PlyVertexValues& values)
+{
+	const float* v = values.v;
+	out.positions[index] = XMFLOAT3(v[PLY_X], v[PLY_Y], v[PLY_Z]);
+	if (out.normals)
+	{
+		out.normals[index] = XMFLOAT3(v[PLY_NX], v[PLY_NY], v[PLY_NZ]);
+	}
+	if (out.colors)
+	{
+		out.colors[index] = packPlyColor(v);
+	}
+	if (out.uvs)
+	{
+		out.uvs[index] = XMFLOAT2(v[PLY_U], v[PLY_V]);
+	}
+}
+
+// Fan triangulates one face into indices, an out of range corner drops the whole face
+static inline bool emitPlyFace(const int64_t* corners, const size_t num_corners, const size_t num_vertices, std::vector<uint32_t>& indices)
+{
+	for (size_t i = 0; i < num_corners; ++i)
+	{
+		if (corners[i] < 0 || (uint64_t)corners[i] >= num_vertices)
+			return false;
+	}
+	for (size_t i = 2; i < num_corners; ++i)
+	{
+		indices.push_back((uint32_t)corners[0]);
+		indices.push_back((uint32_t)corners[i - 1]);
+		indices.push_back((uint32_t)corners[i]);
+	}
+	return true;
+}
+
+// Binary values, the host is assumed to be little endian (x64 / arm64)
+template <typename T, bool SWAP>
+static inline T loadPly(const uint8_t* p)
+{
+	T value;
+	if constexpr (SWAP)
+	{
+		uint8_t bytes[sizeof(T)];
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			bytes[i] = p[sizeof(T) - 1 - i];
+		}
+		memcpy(&value, bytes, sizeof(T));
+	}
+	else
+	{
+		memcpy(&value, p, sizeof(T));
+	}
+	return value;
+}
+
+template <bool SWAP>
+static inline double readPlyValue(const uint8_t* p, const PlyType type)
+{
+	switch (type)
+	{
+	case PlyType::INT8: return (double)*(const int8_t*)p;
+	case PlyType::UINT8: return (double)*p;
+	case PlyType::INT16: return (double)loadPly<int16_t, SWAP>(p);
+	case PlyType::UINT16: return (double)loadPly<uint16_t, SWAP>(p);
+	case PlyType::INT32: return (double)loadPly<int32_t, SWAP>(p);
+	case PlyType::UINT32: return (double)loadPly<uint32_t, SWAP>(p);
+	case PlyType::FLOAT32: return (double)loadPly<float, SWAP>(p);
+	case PlyType::FLOAT64: return loadPly<double, SWAP>(p);
+	default: return 0;
+	}
+}
+
+// Serial walk over the rows of a binary element with lists:
+//	validates every row against the body and records the offset of each block
+template <bool SWAP>
+static bool scanPlyBinaryRows(const uint8_t* data, const size_t size, PlyElement& element)
+{
+	size_t offset = element.begin;
+	element.blockOffsets.clear();
+	element.blockOffsets.reserve((element.count + PLY_BLOCK_ROWS - 1) / PLY_BLOCK_ROWS);
+	for (size_t row = 0; row < element.count; ++row)
+	{
+		if (row % PLY_BLOCK_ROWS == 0)
+		{
+			element.blockOffsets.push_back(offset);
+		}
+		for (const PlyProperty& property : element.properties)
+		{
+			if (!property.IsList())
+			{
+				offset += plyTypeSize(property.type);
+				continue;
+			}
+			const size_t count_size = plyTypeSize(property.countType);
+			if (offset + count_size > size)
+				return false;
+			const double count = readPlyValue<SWAP>(data + offset, property.countType);
+			if (count < 0)
+				return false;
+			offset += count_size + (size_t)count * plyTypeSize(property.type);
+		}
+		if (offset > size)
+			return false;
+	}
+	element.end = offset;
+	return true;
+}
+
+template <bool SWAP>
+static void decodePlyBinaryVertices(const uint8_t* data, const PlyElement& element, const PlyVertexOutput& out)
+{
+	const uint32_t num_blocks = (uint32_t)((element.count + PLY_BLOCK_ROWS - 1) / PLY_BLOCK_ROWS);
+	jobsystem::context ctx;
+	jobsystem::Dispatch(ctx, num_blocks, 1, [&](jobsystem::JobArgs args) {
+		const size_t row_begin = (size_t)args.jobIndex * PLY_BLOCK_ROWS;
+		const size_t row_end = std::min(row_begin + PLY_BLOCK_ROWS, element.count);
+		const uint8_t* p = data + (element.stride > 0 ? element.begin + row_begin * element.stride : element.blockOffsets[args.jobIndex]);
+		PlyVertexValues values;
+		for (size_t row = row_begin; row < row_end; ++row)
+		{
+			values.Reset();
+			for (const PlyProperty& property : element.properties)
+			{
+				if (property.IsList())
+				{
+					const size_t count = (size_t)readPlyValue<SWAP>(p, property.countType);
+					p += plyTypeSize(property.countType) + count * plyTypeSize(property.type);
+					continue;
+				}
+				if (property.semantic < PLY_SEMANTIC_COUNT)
+				{
+					values.v[property.semantic] = (float)readPlyValue<SWAP>(p, property.type) * property.scale;
+				}
+				p += plyTypeSize(property.type);
+			}
+			storePlyVertex(out, row, values);
+		}
+		});
+	jobsystem::Wait(ctx);
+}
+
+template <bool SWAP>
+static void decodePlyBinaryFaces(const uint8_t* data, const PlyElement& element, const size_t num_vertices,
+	std::vector<std::vector<uint32_t>>& block_indices, std::atomic<size_t>& invalid_faces)
+{
+	const uint32_t num_blocks = (uint32_t)((element.count + PLY_BLOCK_ROWS - 1) / PLY_BLOCK_ROWS);
+	block_indices.resize(num_blocks);
+	jobsystem::context ctx;
+	jobsystem::Dispatch(ctx, num_blocks, 1, [&](jobsystem::JobArgs args) {
+		const size_t row_begin = (size_t)args.jobIndex * PLY_BLOCK_ROWS;
+		const size_t row_end = std::min(row_begin + PLY_BLOCK_ROWS, element.count);
+		const uint8_t* p = data + (element.stride > 0 ? element.begin + row_begin * element.stride : element.blockOffsets[args.jobIndex]);
+		std::vector<uint32_t>& indices = block_indices[args.jobIndex];
+		indices.reserve((row_end - row_begin) * 3);
+		std::vector<int64_t> corners;
+		size_t invalid = 0;
+		for (size_t row = row_begin; row < row_end; ++row)
+		{
+			for (const PlyProperty& property : element.properties)
+			{
+				if (!property.IsList())
+				{
+					p += plyTypeSize(property.type);
+					continue;
+				}
+				const size_t count = (size_t)readPlyValue<SWAP>(p, property.countType);
+				p += plyTypeSize(property.countType);
+				const size_t item_size = plyTypeSize(property.type);
+				if (property.semantic == PLY_FACE_INDICES)
+				{
+					corners.resize(count);
+					for (size_t i = 0; i < count; ++i)
+					{
+						corners[i] = (int64_t)readPlyValue<SWAP>(p + i * item_size, property.type);
+					}
+					if (!emitPlyFace(corners.data(), count, num_vertices, indices))
+					{
+						invalid++;
+					}
+				}
+				p += count * item_size;
+			}
+		}
+		invalid_faces.fetch_add(invalid, std::memory_order_relaxed);
+		});
+	jobsystem::Wait(ctx);
+}
+
+// Lays out the binary body: element ranges, and block offsets for elements with lists
+template <bool SWAP>
+static bool layoutPlyBinary(const uint8_t* data, const size_t size, PlyHeader& header, std::string& error)
+{
+	size_t offset = header.bodyOffset;
+	for (PlyElement& element : header.elements)
+	{
+		element.begin = offset;
+		element.stride = 0;
+		bool has_list = false;
+		for (const PlyProperty& property : element.properties)
+		{
+			has_list |= property.IsList();
+			element.stride += plyTypeSize(property.type);
+		}
+		if (has_list)
+		{
+			element.stride = 0;
+			if (!scanPlyBinaryRows<SWAP>(data, size, element))
+			{
+				error = "truncated or corrupted element: " + element.name;
+				return false;
+			}
+		}
+		else
+		{
+			if (element.stride > 0 && element.count > (size - offset) / element.stride)
+			{
+				error = "truncated element: " + element.name;
+				return false;
+			}
+			element.end = offset + element.count * element.stride;
+		}
+		offset = element.end;
+	}
+	return true;
+}
+
+static inline const char* skipPlySpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+	return p;
+}
+
+// from_chars based parse of the next ascii token, false for a missing or malformed value
+static inline bool parsePlyNumber(const char*& p, const char* end, double& value)
+{
+	p = skipPlySpaces(p, end);
+	const char* first = p < end && *p == '+' ? p + 1 : p;
+	std::from_chars_result result = std::from_chars(first, end, value);
+	const bool valid = result.ec == std::errc();
+	p = std::max(p, result.ptr);
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+	return valid;
+}
+
+static inline bool isPlyBlankLine(const char* p, const char* end)
+{
+	return skipPlySpaces(p, end) == end;
+}
+
+struct PlyAsciiChunk
+{
+	const char* begin = nullptr;
+	const char* end = nullptr;
+	size_t numRows = 0;
+	size_t firstRow = 0;
+	std::vector<uint32_t> indices;
+};
+
+static bool decodePlyAscii(const char* data, const size_t size, const PlyHeader& header, const PlyVertexOutput& out,
+	const size_t num_vertices, std::vector<std::vector<uint32_t>>& chunk_indices, std::atomic<size_t>& invalid_faces, std::string& error)
+{
+	// row range of every element, ascii rows are one per non-blank line
+	std::vector<size_t> element_first_row(header.elements.size() + 1, 0);
+	for (size_t i = 0, n = header.elements.size(); i < n; ++i)
+	{
+		element_first_row[i + 1] = element_first_row[i] + header.elements[i].count;
+	}
+	const size_t num_rows = element_first_row.back();
+
+	std::vector<PlyAsciiChunk> chunks;
+	for (const char* begin = data + header.bodyOffset, *end = data + size; begin < end; )
+	{
+		PlyAsciiChunk& chunk = chunks.emplace_back();
+		chunk.begin = begin;
+		chunk.end = begin + std::min(PLY_CHUNK_SIZE, (size_t)(end - begin));
+		if (chunk.end < end)
+		{
+			const char* eol = (const char*)memchr(chunk.end, '\n', end - chunk.end);
+			chunk.end = eol ? eol + 1 : end;
+		}
+		begin = chunk.end;
+	}
+	const uint32_t num_chunks = (uint32_t)chunks.size();
+
+	jobsystem::context ctx;
+	jobsystem::Dispatch(ctx, num_chunks, 1, [&](jobsystem::JobArgs args) {
+		PlyAsciiChunk& chunk = chunks[args.jobIndex];
+		for (const char* line = chunk.begin; line < chunk.end; )
+		{
+			const char* eol = (const char*)memchr(line, '\n', chunk.end - line);
+			const char* line_end = eol ? eol : chunk.end;
+			if (!isPlyBlankLine(line, line_end))
+			{
+				chunk.numRows++;
+			}
+			line = line_end + 1;
+		}
+		});
+	jobsystem::Wait(ctx);
+
+	size_t total_rows = 0;
+	for (PlyAsciiChunk& chunk : chunks)
+	{
+		chunk.firstRow = total_rows;
+		total_rows += chunk.numRows;
+	}
+	if (total_rows < num_rows)
+	{
+		error = "truncated ascii body, " + std::to_string(total_rows) + " of " + std::to_string(num_rows) + " rows";
+		return false;
+	}
+
+	std::atomic<size_t> invalid_values{ 0 };
+	jobsystem::Dispatch(ctx, num_chunks, 1, [&](jobsystem::JobArgs args) {
+		PlyAsciiChunk& chunk = chunks[args.jobIndex];
+		if (chunk.firstRow >= num_rows)
+			return;
+		size_t element_index = std::upper_bound(element_first_row.begin(), element_first_row.end(), chunk.firstRow) - element_first_row.begin() - 1;
+		size_t row = chunk.firstRow;
+		PlyVertexValues values;
+		std::vector<int64_t> corners;
+		size_t invalid = 0;
+		size_t invalid_face = 0;
+		for (const char* line = chunk.begin; line < chunk.end && row < num_rows; )
+		{
+			const char* eol = (const char*)memchr(line, '\n', chunk.end - line);
+			const char* line_end = eol ? eol : chunk.end;
+			const char* p = line;
+			line = line_end + 1;
+			if (isPlyBlankLine(p, line_end))
+				continue;
+			while (row >= element_first_row[element_index + 1]) ++element_index;
+			const PlyElement& element = header.elements[element_index];
+			const bool is_vertex = (int)element_index == header.vertexElement;
+			const bool is_face = (int)element_index == header.faceElement;
+			if (!is_vertex && !is_face)
+			{
+				row++;
+				continue;
+			}
+
+			values.Reset();
+			for (const PlyProperty& property : element.properties)
+			{
+				double value = 0;
+				if (!property.IsList())
+				{
+					invalid += !parsePlyNumber(p, line_end, value);
+					if (property.semantic < PLY_SEMANTIC_COUNT)
+					{
+						values.v[property.semantic] = (float)value * property.scale;
+					}
+					continue;
+				}
+				invalid += !parsePlyNumber(p, line_end, value);
+				const size_t count = value > 0 ? (size_t)value : 0;
+				if (property.semantic == PLY_FACE_INDICES)
+				{
+					corners.resize(count);
+					for (size_t i = 0; i < count; ++i)
+					{
+						invalid += !parsePlyNumber(p, line_end, value);
+						corners[i] = (int64_t)value;
+					}
+					if (!emitPlyFace(corners.data(), count, num_vertices, chunk.indices))
+					{
+						invalid_face++;
+					}
+				}
+				else
+				{
+					for (size_t i = 0; i < count; ++i)
+					{
+						invalid += !parsePlyNumber(p, line_end, value);
+					}
+				}
+			}
+			if (is_vertex)
+			{
+				storePlyVertex(out, row - element_first_row[element_index], values);
+			}
+			row++;
+		}
+		invalid_values.fetch_add(invalid, std::memory_order_relaxed);
+		invalid_faces.fetch_add(invalid_face, std::memory_order_relaxed);
+		});
+	jobsystem::Wait(ctx);
+
+	if (invalid_values.load() > 0)
+	{
+		backlog::post("PLY: " + std::to_string(invalid_values.load()) + " malformed ascii values were read as 0", backlog::LogLevel::Warn);
+	}
+
+	chunk_indices.resize(num_chunks);
+	for (uint32_t i = 0; i < num_chunks; ++i)
+	{
+		chunk_indices[i] = std::move(chunks[i].indices);
+	}
+	return true;
+}
+
+// Concatenates the per block triangle lists in parallel
+static void gatherPlyIndices(std::vector<std::vector<uint32_t>>& block_indices, std::vector<uint32_t>& indices)
+{
+	std::vector<size_t> block_offsets(block_indices.size() + 1, 0);
+	for (size_t i = 0, n = block_indices.size(); i < n; ++i)
+	{
+		block_offsets[i + 1] = block_offsets[i] + block_indices[i].size();
+	}
+	indices.resize(block_offsets.back());
+	jobsystem::context ctx;
+	jobsystem::Dispatch(ctx, (uint32_t)block_indices.size(), 1, [&](jobsystem::JobArgs args) {
+		std::vector<uint32_t>& block = block_indices[args.jobIndex];
+		if (!block.empty())
+		{
+			memcpy(indices.data() + block_offsets[args.jobIndex], block.data(), block.size() * sizeof(uint32_t));
+		}
+		std::vector<uint32_t>().swap(block);
+		});
+	jobsystem::Wait(ctx);
+}
+
+// Decodes a PLY file in memory into the primitive's vertex attributes and triangle indices (empty for a point cloud)
+static bool loadPly(const uint8_t* data, const size_t size, Primitive& primitive, std::string& error)
+{
+	PlyHeader header;
+	if (!parsePlyHeader((const char*)data, size, header, error))
+	{
+		error = "Invalid PLY header (" + error + ")";
+		return false;
+	}
+	bindPlySemantics(header);
+	if (header.vertexElement < 0 || header.elements[header.vertexElement].count == 0)
+	{
+		error = "PLY file has NO vertex";
+		return false;
+	}
+
+	const PlyElement& vertex_element = header.elements[header.vertexElement];
+	const size_t num_vertices = vertex_element.count;
+	bool has_semantic[PLY_SEMANTIC_COUNT] = {};
+	for (const PlyProperty& property : vertex_element.properties)
+	{
+		if (property.semantic < PLY_SEMANTIC_COUNT)
+		{
+			has_semantic[property.semantic] = true;
+		}
+	}
+	const bool has_faces = header.faceElement >= 0 && header.elements[header.faceElement].count > 0;
+	if (has_faces && num_vertices > (size_t)UINT32_MAX)
+	{
+		error = "PLY mesh has too many vertices for 32-bit indices";
+		return false;
+	}
+
+	std::vector<XMFLOAT3>& positions = primitive.GetMutableVtxPositions();
+	std::vector<XMFLOAT3>& normals = primitive.GetMutableVtxNormals();
+	std::vector<uint32_t>& colors = primitive.GetMutableVtxColors();
+	std::vector<XMFLOAT2>& uvs = primitive.GetMutableVtxUVSet0();
+	std::vector<uint32_t>& indices = primitive.GetMutableIdxPrimives();
+
+	PlyVertexOutput out;
+	positions.resize(num_vertices);
+	out.positions = positions.data();
+	if (has_semantic[PLY_NX] || has_semantic[PLY_NY] || has_semantic[PLY_NZ])
+	{
+		normals.resize(num_vertices);
+		out.normals = normals.data();
+	}
+	if (has_semantic[PLY_RED] || has_semantic[PLY_GREEN] || has_semantic[PLY_BLUE])
+	{
+		colors.resize(num_vertices);
+		out.colors = colors.data();
+	}
+	if (has_faces && (has_semantic[PLY_U] || has_semantic[PLY_V]))
+	{
+		uvs.resize(num_vertices);
+		out.uvs = uvs.data();
+	}
+
+	std::vector<std::vector<uint32_t>> block_indices;
+	std::atomic<size_t> invalid_faces{ 0 };
+	if (header.format == PlyFormat::ASCII)
+	{
+		if (!decodePlyAscii((const char*)data, size, header, out, num_vertices, block_indices, invalid_faces, error))
+			return false;
+	}
+	else
+	{
+		const bool swap = header.format == PlyFormat::BINARY_BIG_ENDIAN;
+		if (!(swap ? layoutPlyBinary<true>(data, size, header, error) : layoutPlyBinary<false>(data, size, header, error)))
+			return false;
+		if (swap)
+			decodePlyBinaryVertices<true>(data, header.elements[header.vertexElement], out);
+		else
+			decodePlyBinaryVertices<false>(data, header.elements[header.vertexElement], out);
+		if (has_faces)
+		{
+			if (swap)
+				decodePlyBinaryFaces<true>(data, header.elements[header.faceElement], num_vertices, block_indices, invalid_faces);
+			else
+				decodePlyBinaryFaces<false>(data, header.elements[header.faceElement], num_vertices, block_indices, invalid_faces);
+		}
+	}
+	if (invalid_faces.load() > 0)
+	{
+		backlog::post("PLY: " + std::to_string(invalid_faces.load()) + " faces with out of range vertex indices were skipped", backlog::LogLevel::Warn);
+	}
+
+	if (has_faces)
+	{
+		gatherPlyIndices(block_indices, indices);
+	}
+	if (indices.empty())
+	{
+		std::vector<XMFLOAT2>().swap(uvs);
+	}
+	return true;
+}
+
 bool ImportModel_PLY(const std::string& fileName, const Entity geometryEntity)
 {
-    vz::GeometryComponent* geometry = compfactory::GetGeometryComponent(geometryEntity);
-    if (geometry == nullptr)
-    {
-        vzlog_error("Invalid Entity(%llu)!", geometryEntity);
-        return false;
-    }
-    std::ifstream file(fileName, std::ios::binary);
-    if (!file.is_open())
-    {
-        backlog::post("Error opening PLY file: " + fileName, backlog::LogLevel::Error);
-        return false;
-    }
-
-    std::string line;
-    bool headerEnded = false;
-    int vertexCount = 0;
-
-    // 1. Read PLY header
-    while (std::getline(file, line))
-    {
-        if (line.find("element vertex") != std::string::npos)
-        {
-            vertexCount = std::stoi(line.substr(line.find_last_of(" ") + 1));
-            std::cerr << "vertexCount : " << vertexCount << std::endl;
-        }
-        else if (line == "end_header")
-        {
-            headerEnded = true;
-            break;
-        }
-    }
-
-    if (!headerEnded || vertexCount == 0)
-    {
-        backlog::post("Error: Invalid PLY header.", backlog::LogLevel::Error);
-        return false;
-    }
-
-    // TODO: new implementation
-    //  * previous trash code was deleted
-
-    return true;
+	vz::GeometryComponent* geometry = compfactory::GetGeometryComponent(geometryEntity);
+	if (geometry == nullptr)
+	{
+		vzlog_error("Invalid Entity(%llu)!", geometryEntity);
+		return false;
+	}
+
+	size_t size = 0;
+	std::shared_ptr<const void> mapped = helper::FileMap(fileName, size);
+	std::vector<uint8_t> filedata;
+	const uint8_t* data = (const uint8_t*)mapped.get();
+	if (data == nullptr)
+	{
+		if (!helper::FileRead(fileName, filedata))
+		{
+			backlog::post("Error opening PLY file: " + fileName, backlog::LogLevel::Error);
+			return false;
+		}
+		data = filedata.data();
+		size = filedata.size();
+	}
+
+	std::vector<Primitive> parts(1);
+	Primitive& primitive = parts[0];
+	std::string error;
+	if (!loadPly(data, size, primitive, error))
+	{
+		backlog::post("Error: " + error + ": " + fileName, backlog::LogLevel::Error);
+		return false;
+	}
+
+	if (primitive.GetNumIndices() > 0)
+	{
+		primitive.SetPrimitiveType(GeometryComponent::PrimitiveType::TRIANGLES);
+		if (primitive.GetVtxNormals().empty())
+		{
+			primitive.ComputeNormals(GeometryComponent::NormalComputeMethod::COMPUTE_NORMALS_SMOOTH_FAST);
+		}
+	}
+	else
+	{
+		// point cloud (or a mesh whose faces were all dropped)
+		primitive.SetPrimitiveType(GeometryComponent::PrimitiveType::POINTS);
+	}
+	primitive.ComputeAABB();
+
+	geometry->MovePrimitivesFrom(std::move(parts));
+	geometry->UpdateRenderData();
+
+	return true;
 }
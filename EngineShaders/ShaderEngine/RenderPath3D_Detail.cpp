@@ -1,5 +1,6 @@
 ﻿#include "RenderPath3D_Detail.h"
 #include "TextureHelper.h"
+#include "Utils/Allocator.h"
 
 namespace fsr2
 {
@@ -192,6 +193,142 @@ namespace vz::renderer
 
 
 
+	}
+
+	// RenderQueue sorting:
+	//	LSD radix sort with 8-bit digits over the 128-bit RenderBatch sort key
+	//	digits that are the same for all batches (e.g., unused high bits of the indices, an unused high word) are skipped
+	static constexpr uint32_t RADIX_DIGIT_COUNT = 16; // 128-bit key
+	static constexpr size_t RADIX_MIN_COUNT = 256; // below this, the comparison sort is cheaper than the passes
+	static constexpr size_t RADIX_PARALLEL_THRESHOLD = 16384; // batch count above which histograms and scatters run as jobs
+	static constexpr size_t RADIX_PARALLEL_MIN_CHUNK = 8192;
+
+	static inline uint32_t radixDigit(const RenderQueue::SortEntry& entry, const uint32_t digit)
+	{
+		const uint64_t word = digit < 8 ? entry.low : entry.high;
+		return uint32_t(word >> ((digit & 7u) * 8u)) & 0xFFu;
+	}
+
+	void RenderQueue::sort(bool transparent)
+	{
+		const size_t count = batches.size();
+		if (count < 2)
+			return;
+		if (count < RADIX_MIN_COUNT)
+		{
+			if (transparent)
+				std::stable_sort(batches.begin(), batches.end(), std::greater<RenderBatch>());
+			else
+				std::stable_sort(batches.begin(), batches.end(), std::less<RenderBatch>());
+			return;
+		}
+
+		uint32_t chunk_count = 1;
+		if (count >= RADIX_PARALLEL_THRESHOLD)
+		{
+			chunk_count = (uint32_t)std::min<size_t>(jobsystem::GetThreadCount(), count / RADIX_PARALLEL_MIN_CHUNK);
+			chunk_count = std::max(chunk_count, 1u);
+		}
+		const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+		sortEntries.resize(count);
+		sortEntriesTemp.resize(count);
+		sortHistograms.resize(chunk_count * 256);
+
+		// Transparent batches sort descending, which is the ascending order of the inverted keys:
+		const uint64_t invert = transparent ? ~0ull : 0ull;
+		auto getKey = [transparent](const RenderBatch& batch, uint64_t& low, uint64_t& high) {
+			if (transparent)
+				batch.GetTransparentSortKey(low, high);
+			else
+				batch.GetSortKey(low, high);
+			};
+		uint64_t diff_low = 0, diff_high = 0;
+		{
+			uint64_t first_low = 0, first_high = 0;
+			getKey(batches[0], first_low, first_high);
+			for (size_t i = 0; i < count; ++i)
+			{
+				SortEntry& entry = sortEntries[i];
+				getKey(batches[i], entry.low, entry.high);
+				diff_low |= entry.low ^ first_low;
+				diff_high |= entry.high ^ first_high;
+				entry.low ^= invert;
+				entry.high ^= invert;
+				entry.index = (uint32_t)i;
+			}
+		}
+
+		SortEntry* src = sortEntries.data();
+		SortEntry* dst = sortEntriesTemp.data();
+		for (uint32_t digit = 0; digit < RADIX_DIGIT_COUNT; ++digit)
+		{
+			const uint64_t diff = digit < 8 ? diff_low : diff_high;
+			if (((diff >> ((digit & 7u) * 8u)) & 0xFFu) == 0)
+				continue; // all batches share this digit
+
+			auto histogram = [&](uint32_t chunk) {
+				uint32_t* hist = sortHistograms.data() + chunk * 256;
+				std::fill(hist, hist + 256, 0u);
+				const size_t begin = chunk * chunk_size;
+				const size_t end = std::min(begin + chunk_size, count);
+				for (size_t i = begin; i < end; ++i)
+				{
+					hist[radixDigit(src[i], digit)]++;
+				}
+				};
+			auto scatter = [&](uint32_t chunk) {
+				uint32_t* offsets = sortHistograms.data() + chunk * 256;
+				const size_t begin = chunk * chunk_size;
+				const size_t end = std::min(begin + chunk_size, count);
+				for (size_t i = begin; i < end; ++i)
+				{
+					dst[offsets[radixDigit(src[i], digit)]++] = src[i];
+				}
+				};
+
+			jobsystem::context ctx;
+			if (chunk_count > 1)
+			{
+				jobsystem::Dispatch(ctx, chunk_count, 1, [&](jobsystem::JobArgs args) { histogram(args.jobIndex); });
+				jobsystem::Wait(ctx);
+			}
+			else
+			{
+				histogram(0);
+			}
+
+			// Exclusive prefix sum in (digit value, chunk) order turns the counts into stable scatter offsets:
+			uint32_t offset = 0;
+			for (uint32_t value = 0; value < 256; ++value)
+			{
+				for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+				{
+					uint32_t& slot = sortHistograms[chunk * 256 + value];
+					const uint32_t slot_count = slot;
+					slot = offset;
+					offset += slot_count;
+				}
+			}
+
+			if (chunk_count > 1)
+			{
+				jobsystem::Dispatch(ctx, chunk_count, 1, [&](jobsystem::JobArgs args) { scatter(args.jobIndex); });
+				jobsystem::Wait(ctx);
+			}
+			else
+			{
+				scatter(0);
+			}
+			std::swap(src, dst);
+		}
+
+		batchesSorted.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			batchesSorted[i] = batches[src[i].index];
+		}
+		std::swap(batches, batchesSorted);
 	}
 }
 
@@ -209,12 +346,12 @@ namespace vz::renderer
 
 		assert(vis.camera != nullptr); // User must provide a camera!
 
-		// The parallel frustum culling is first performed in shared memory, 
+		// The parallel frustum culling is performed per group of boxes with the SoA batch kernel (Frustum::CullBoxes),
 		//	then each group writes out it's local list to global memory
-		//	The shared memory approach reduces atomics and helps the list to remain
+		//	The group-local approach reduces atomics and helps the list to remain
 		//	more coherent (less randomly organized compared to original order)
 		static constexpr uint32_t groupSize = 64u;
-		static const size_t sharedmemory_size = (groupSize + 1) * sizeof(uint32_t); // list + counter per group
+		static_assert(groupSize % AABBSoA::SIMD_WIDTH == 0);
 
 		// Initialize visible indices:
 		vis.Clear();
@@ -233,53 +370,54 @@ namespace vz::renderer
 		{
 			// Cull lights:
 			const uint32_t light_loop = (uint32_t)scene_Gdetails->lightComponents.size();
+			const uint32_t light_groups = (light_loop + groupSize - 1) / groupSize;
 			vis.visibleLights.resize(light_loop);
 			vis.visibleLightShadowRects.clear();
 			vis.visibleLightShadowRects.resize(light_loop);
-			jobsystem::Dispatch(ctx, light_loop, groupSize, [&](jobsystem::JobArgs args) {
+			jobsystem::Dispatch(ctx, light_groups, 1, [&](jobsystem::JobArgs args) {
+
+				const uint32_t group_begin = args.jobIndex * groupSize;
+				const uint32_t group_end = std::min(group_begin + groupSize, light_loop);
 
-				const GLightComponent& light = *scene_Gdetails->lightComponents[args.jobIndex];
-				assert(!light.IsDirty());
-				assert(light.lightIndex == args.jobIndex);
+				// Frustum and layer culling of the whole group:
+				uint32_t group_list[groupSize];
+				const uint32_t culled_count = vis.frustum.CullBoxes(scene_Gdetails->soaLights, group_begin, group_end, vis.layerMask, group_list);
 
-				// Setup stream compaction:
-				uint32_t& group_count = *(uint32_t*)args.sharedmemory;
-				uint32_t* group_list = (uint32_t*)args.sharedmemory + 1;
-				if (args.isFirstJobInGroup)
+				uint32_t group_count = 0;
+				for (uint32_t i = 0; i < culled_count; ++i)
 				{
-					group_count = 0; // first thread initializes local counter
-				}
+					const uint32_t light_index = group_list[i];
+					const GLightComponent& light = *scene_Gdetails->lightComponents[light_index];
+					assert(!light.IsDirty());
+					assert(light.lightIndex == light_index);
 
-				const AABB& aabb = scene_Gdetails->aabbLights[args.jobIndex];
+					if (light.IsInactive())
+						continue;
 
-				if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
-				{
-					if (!light.IsInactive())
+					// Local stream compaction (in place, the list only shrinks):
+					//	(also compute light distance for shadow priority sorting)
+					group_list[group_count] = light_index;
+					group_count++;
+					//if (light.IsVolumetricsEnabled())
+					//{
+					//	vis.volumetricLightRequest.store(true);
+					//}
+
+					if (vis.flags & Visibility::ALLOW_OCCLUSION_CULLING)
 					{
-						// Local stream compaction:
-						//	(also compute light distance for shadow priority sorting)
-						group_list[group_count] = args.jobIndex;
-						group_count++;
-						//if (light.IsVolumetricsEnabled())
-						//{
-						//	vis.volumetricLightRequest.store(true);
-						//}
-
-						if (vis.flags & Visibility::ALLOW_OCCLUSION_CULLING)
+						if (!light.IsStatic() && light.GetType() != LightComponent::LightType::DIRECTIONAL || light.occlusionquery < 0)
 						{
-							if (!light.IsStatic() && light.GetType() != LightComponent::LightType::DIRECTIONAL || light.occlusionquery < 0)
+							const AABB& aabb = scene_Gdetails->aabbLights[light_index];
+							if (!aabb.intersects(vis.camera->GetWorldEye()))
 							{
-								if (!aabb.intersects(vis.camera->GetWorldEye()))
-								{
-									light.occlusionquery = scene_Gdetails->queryAllocator.fetch_add(1); // allocate new occlusion query from heap
-								}
+								light.occlusionquery = scene_Gdetails->queryAllocator.fetch_add(1); // allocate new occlusion query from heap
 							}
 						}
 					}
 				}
 
 				// Global stream compaction:
-				if (args.isLastJobInGroup && group_count > 0)
+				if (group_count > 0)
 				{
 					uint32_t prev_count = vis.counterLight.fetch_add(group_count);
 					for (uint32_t i = 0; i < group_count; ++i)
@@ -288,41 +426,34 @@ namespace vz::renderer
 					}
 				}
 
-				}, sharedmemory_size);
+				});
 		}
 
 		if (vis.flags & Visibility::ALLOW_RENDERABLES)
 		{
 			// Cull objects:
 			const uint32_t renderable_loop = (uint32_t)scene_Gdetails->renderableComponents.size();
+			const uint32_t renderable_groups = (renderable_loop + groupSize - 1) / groupSize;
 
 			const Scene* scene = scene_Gdetails->GetScene();
 			vis.visibleRenderables_Mesh.resize(scene->GetRenderableMeshCount());
 			vis.visibleRenderables_Volume.resize(scene->GetRenderableVolumeCount());
 			vis.visibleRenderables_GSplat.resize(scene->GetRenderableGSplatCount());
 
-			jobsystem::Dispatch(ctx, renderable_loop, groupSize, [&](jobsystem::JobArgs args) {
+			jobsystem::Dispatch(ctx, renderable_groups, 1, [&](jobsystem::JobArgs args) {
 
-				uint32_t renderable_index = args.jobIndex;
-				const GRenderableComponent& renderable = *scene_Gdetails->renderableComponents[renderable_index];
-				assert(renderable.renderableIndex == args.jobIndex);
-				switch (renderable.GetRenderableType())
-				{
-				case RenderableType::MESH_RENDERABLE:
-				case RenderableType::VOLUME_RENDERABLE:
-				case RenderableType::GSPLAT_RENDERABLE:
-					break;
-				case RenderableType::SPRITE_RENDERABLE:
-				case RenderableType::SPRITEFONT_RENDERABLE:
-					return;
-				default: 
-					vzlog_assert(0, "Non-renderable Type! ShaderEngine's Scene Update"); return;
-				}
+				const uint32_t group_begin = args.jobIndex * groupSize;
+				const uint32_t group_end = std::min(group_begin + groupSize, renderable_loop);
 
-				const AABB& aabb = scene_Gdetails->aabbRenderables[args.jobIndex];
+				// Frustum and layer culling of the whole group:
+				uint32_t group_list[groupSize];
+				const uint32_t culled_count = vis.frustum.CullBoxes(scene_Gdetails->soaRenderables, group_begin, group_end, vis.layerMask, group_list);
 
-				if ((aabb.layerMask & vis.layerMask) && vis.frustum.CheckBoxFast(aabb))
+				for (uint32_t i = 0; i < culled_count; ++i)
 				{
+					const uint32_t renderable_index = group_list[i];
+					const GRenderableComponent& renderable = *scene_Gdetails->renderableComponents[renderable_index];
+					assert(renderable.renderableIndex == renderable_index);
 					switch (renderable.GetRenderableType())
 					{
 					case RenderableType::MESH_RENDERABLE:
@@ -334,9 +465,12 @@ namespace vz::renderer
 					case RenderableType::GSPLAT_RENDERABLE:
 						vis.visibleRenderables_GSplat[vis.counterRenderableGSplat.fetch_add(1)] = renderable_index;
 						break;
+					case RenderableType::SPRITE_RENDERABLE:
+					case RenderableType::SPRITEFONT_RENDERABLE:
+						continue;
 					default:
-						vzlog_assert(0, "MUST BE RENDERABLE!");
-						return;
+						vzlog_assert(0, "Non-renderable Type! ShaderEngine's Scene Update");
+						continue;
 					}
 
 					GSceneDetails::OcclusionResult& occlusion_result = scene_Gdetails->occlusionResultsObjects[renderable_index];
@@ -348,6 +482,7 @@ namespace vz::renderer
 						assert(renderable.IsRenderable());
 						if (occlusion_result.occlusionQueries[scene_Gdetails->queryheapIdx] < 0)
 						{
+							const AABB& aabb = scene_Gdetails->aabbRenderables[renderable_index];
 							if (aabb.intersects(vis.camera->GetWorldEye()))
 							{
 								// camera is inside the instance, mark it as visible in this frame:
@@ -1522,7 +1657,8 @@ namespace vz::renderer
 	//	so, the internal parameters must not be declared outside the function (e.g., member parameter)
 	void GRenderPath3DDetails::BindCameraCB(const CameraComponent& camera, const CameraComponent& cameraPrevious, const CameraComponent& cameraReflection, CommandList cmd)
 	{
-		CameraCB* cameraCB = new CameraCB();
+		// the constants only live until they are copied into the dynamic constant buffer, so they come from the calling thread's frame arena
+		CameraCB* cameraCB = new (allocator::frame_allocate(sizeof(CameraCB), alignof(CameraCB))) CameraCB();
 		cameraCB->Init();
 		ShaderCamera& shadercam = cameraCB->cameras[0];
 
@@ -1715,7 +1851,8 @@ namespace vz::renderer
 		//shadercam.texture_reprojected_depth_index = camera.texture_reprojected_depth_index;
 
 		device->BindDynamicConstantBuffer(*cameraCB, CBSLOT_RENDERER_CAMERA, cmd);
-		delete cameraCB;
+		cameraCB->~CameraCB();
+		allocator::frame_deallocate(cameraCB, alignof(CameraCB));
 	}
 
 	void GRenderPath3DDetails::UpdateRenderData(const Visibility& vis, const FrameCB& frameCB, CommandList cmd)
@@ -330,63 +330,44 @@ namespace vz::renderer
 			return renderableIndex;
 		}
 
+		// Opaque sort key (low to high priority):
+		//	low:  distance(32) | materialIndex(32)
+		//	high: unused (0)
+		//	distance is stored as raw float bits, which keep their order since distance >= 0
+		constexpr void GetSortKey(uint64_t& low, uint64_t& high) const
+		{
+			low = (uint64_t)distance | ((uint64_t)materialIndex << 32);
+			high = 0;
+		}
+		// Transparent sort key (low to high priority):
+		//	low:  materialIndex(32) | partIndex(8) | meshIndex(24)
+		//	high: distance(32)
+		constexpr void GetTransparentSortKey(uint64_t& low, uint64_t& high) const
+		{
+			low = (uint64_t)materialIndex | ((uint64_t)((partIndex & 0xFF) | ((uint32_t)geometryIndex << 8)) << 32);
+			high = (uint64_t)distance;
+		}
+
 		// opaque sorting
-		//	Priority is set to mesh index to have more instancing
-		//	distance is second priority (front to back Z-buffering)
+		//	batches of a material stay together, front to back within a material (Z-buffering)
 		constexpr bool operator<(const RenderBatch& other) const
 		{
-			struct SortKey
-			{
-				uint64_t low;
-				uint64_t high;
-				constexpr bool operator<(const SortKey& o) const
-				{
-					if (high != o.high) return high < o.high;
-					return low < o.low;
-				}
-			};
-
-			// Layout (low to high priority):                                             
-			// low:  distance(32) | materialIndex(32)                   
-			// high: partIndex(8) | meshIndex(24) | sort_bits(32)                                        
-			SortKey a = {};
-			a.low = (uint64_t)distance | ((uint64_t)materialIndex << 32);
-			a.high = (uint64_t)((partIndex & 0xFF) | ((uint32_t)geometryIndex << 8)) | ((uint64_t)sort_bits << 32);
-
-			SortKey b = {};
-			b.low = (uint64_t)other.distance | ((uint64_t)other.materialIndex << 32);
-			b.high = (uint64_t)((partIndex & 0xFF) | ((uint32_t)geometryIndex << 8)) | ((uint64_t)sort_bits << 32);
-
-			return a < b;
+			uint64_t a_low = 0, a_high = 0, b_low = 0, b_high = 0;
+			GetSortKey(a_low, a_high);
+			other.GetSortKey(b_low, b_high);
+			if (a_high != b_high) return a_high < b_high;
+			return a_low < b_low;
 		}
 		// transparent sorting
 		//	Priority is distance for correct alpha blending (back to front rendering)
-		//	mesh index is second priority for instancing
+		//	mesh, part and material are the next priorities, so batches at the same distance can still be instanced
 		constexpr bool operator>(const RenderBatch& other) const
 		{
-			struct SortKey
-			{
-				uint64_t low;
-				uint64_t high;
-				constexpr bool operator>(const SortKey& o) const
-				{
-					if (high != o.high) return high > o.high;
-					return low > o.low;
-				}
-			};
-
-			// Layout (low to high priority):                                             
-			// low:  distance(32) | materialIndex(32)                   
-			// high: partIndex(8) | meshIndex(24) | sort_bits(32)                                        
-			SortKey a = {};
-			a.low = (uint64_t)distance | ((uint64_t)materialIndex << 32);
-			a.high = (uint64_t)((partIndex & 0xFF) | ((uint32_t)geometryIndex << 8)) | ((uint64_t)sort_bits << 32);
-
-			SortKey b = {};
-			b.low = (uint64_t)other.distance | ((uint64_t)other.materialIndex << 32);
-			b.high = (uint64_t)((partIndex & 0xFF) | ((uint32_t)geometryIndex << 8)) | ((uint64_t)sort_bits << 32);
-
-			return a > b;
+			uint64_t a_low = 0, a_high = 0, b_low = 0, b_high = 0;
+			GetTransparentSortKey(a_low, a_high);
+			other.GetTransparentSortKey(b_low, b_high);
+			if (a_high != b_high) return a_high > b_high;
+			return a_low > b_low;
 		}
 	};
 
@@ -394,6 +375,18 @@ namespace vz::renderer
 	{
 		std::vector<RenderBatch> batches;
 
+		// Radix sort scratch buffers, reused across frames (the render queues are thread_local)
+		struct SortEntry
+		{
+			uint64_t low;
+			uint64_t high;
+			uint32_t index; // into batches
+		};
+		std::vector<SortEntry> sortEntries;
+		std::vector<SortEntry> sortEntriesTemp;
+		std::vector<uint32_t> sortHistograms;
+		std::vector<RenderBatch> batchesSorted;
+
 		inline void init()
 		{
 			batches.clear();
@@ -406,13 +399,16 @@ namespace vz::renderer
 		{
 			batches.push_back(batch);
 		}
+		// Stable LSD radix sort of batches
+		//	opaque: ascending RenderBatch::GetSortKey(), transparent: descending RenderBatch::GetTransparentSortKey()
+		void sort(bool transparent);
 		inline void sort_transparent()
 		{
-			std::sort(batches.begin(), batches.end(), std::greater<RenderBatch>());
+			sort(true); // same order as std::greater<RenderBatch>
 		}
 		inline void sort_opaque()
 		{
-			std::sort(batches.begin(), batches.end(), std::less<RenderBatch>());
+			sort(false); // same order as std::less<RenderBatch>
 		}
 		inline bool empty() const
 		{
@@ -475,6 +475,7 @@ namespace vz
 	{
 		size_t num_renderables = renderableComponents.size();
 		occlusionResultsObjects.resize(num_renderables);
+		soaRenderables.Resize(num_renderables);
 
 		// GPUs
 		jobsystem::Dispatch(ctx, (uint32_t)num_renderables, SMALL_SUBTASK_GROUPSIZE, [&](jobsystem::JobArgs args) {
@@ -519,6 +520,7 @@ namespace vz
 
 			geometrics::AABB& aabb = aabbRenderables[renderable.renderableIndex];
 			aabb.layerMask = layermask;
+			soaRenderables.Set(renderable.renderableIndex, aabb);
 
 			renderable.renderFlags = 0u;
 
@@ -907,6 +909,7 @@ namespace vz
 		aabbRenderables = scene_->GetRenderableAABBs();
 		aabbLights = scene_->GetLightAABBs();
 		aabbProbes = scene_->GetProbeAABBs();
+		soaLights.Build(aabbLights.data(), aabbLights.size());
 
 		deltaTime = dt;
 		jobsystem::context ctx;
@@ -1615,6 +1618,9 @@ namespace vz
 		materialArraySize = 0;
 		instanceResLookupSize = 0;
 
+		soaRenderables.Clear();
+		soaLights.Clear();
+
 		TLAS = {};
 		sceneBVH = {};
 
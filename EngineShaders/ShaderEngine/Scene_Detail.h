@@ -44,6 +44,9 @@ namespace vz::renderer
 		std::vector<geometrics::AABB> aabbRenderables;
 		std::vector<geometrics::AABB> aabbLights;
 		std::vector<geometrics::AABB> aabbProbes;
+		// SoA mirrors of aabbRenderables and aabbLights (incl. final layer masks) for Frustum::CullBoxes
+		geometrics::AABBSoA soaRenderables;
+		geometrics::AABBSoA soaLights;
 
 		std::vector<XMFLOAT4X4> matrixRenderables;
 		std::vector<XMFLOAT4X4> matrixRenderablesPrev;
@@ -0,0 +1,1045 @@
+// Engine-level timing driver
+//	runs CPU-side engine paths on synthetic data and prints their timings
+//	usage: Benchmark001.exe [section ...] (no argument runs every section)
+#include "vzm2/VzEngineAPIs.h"
+
+#include "vzmcore/GComponents.h"
+#include "vzmcore/utils/Allocator.h"
+#include "vzmcore/utils/Geometrics.h"
+#include "vzmcore/utils/GeometryGenerator.h"
+#include "vzmcore/utils/Helpers.h"
+#include "vzmcore/utils/JobSystem.h"
+#include "vzmcore/utils/Profiler.h"
+#include "vzmcore/utils/Random.h"
+#include "vzmcore/utils/Timer.h"
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace vz;
+
+// allocator: pooled make_shared alloc/free throughput vs the spinlocked pool it replaced and std::make_shared
+namespace bench_allocator
+{
+	struct Payload
+	{
+		float data[12];
+	};
+
+	// The pooled allocator before the per-thread magazines: every allocate and reclaim takes the spinlock
+	template<typename T, size_t block_size = 256>
+	struct SpinlockBlockAllocator final : public allocator::SharedBlockAllocator
+	{
+		const uint8_t allocator_id = allocator::register_shared_block_allocator(this);
+
+		struct alignas(std::max(size_t(256), alignof(T))) RawStruct
+		{
+			uint8_t data[sizeof(T)];
+			std::atomic<uint32_t> refcount;
+			std::atomic<uint32_t> refcount_weak;
+		};
+
+		std::vector<std::unique_ptr<RawStruct[]>> blocks;
+		std::vector<RawStruct*> free_list;
+		SpinLock locker;
+
+		inline allocator::shared_ptr<T> allocate()
+		{
+			locker.lock();
+			if (free_list.empty())
+			{
+				RawStruct* ptr = blocks.emplace_back(new RawStruct[block_size]).get();
+				for (size_t i = 0; i < block_size; ++i)
+				{
+					free_list.push_back(ptr + i);
+				}
+			}
+			RawStruct* ptr = free_list.back();
+			free_list.pop_back();
+			locker.unlock();
+
+			new (ptr) T();
+			init_refcount(ptr);
+			allocator::shared_ptr<T> allocation;
+			allocation.handle = reinterpret_cast<uint64_t>(ptr) | uint64_t(allocator_id);
+			return allocation;
+		}
+		void reclaim(void* ptr)
+		{
+			std::scoped_lock lck(locker);
+			free_list.push_back((RawStruct*)ptr);
+		}
+
+		void init_refcount(void* ptr) override
+		{
+			static_cast<RawStruct*>(ptr)->refcount.store(1, std::memory_order_relaxed);
+			static_cast<RawStruct*>(ptr)->refcount_weak.store(1, std::memory_order_relaxed);
+		}
+		uint32_t get_refcount(void* ptr) override
+		{
+			return static_cast<RawStruct*>(ptr)->refcount.load(std::memory_order_acquire);
+		}
+		uint32_t inc_refcount(void* ptr) override
+		{
+			return static_cast<RawStruct*>(ptr)->refcount.fetch_add(1, std::memory_order_relaxed);
+		}
+		uint32_t dec_refcount(void* ptr) override
+		{
+			uint32_t old = static_cast<RawStruct*>(ptr)->refcount.fetch_sub(1, std::memory_order_acq_rel);
+			if (old == 1)
+			{
+				static_cast<T*>(ptr)->~T();
+				dec_refcount_weak(ptr);
+			}
+			return old;
+		}
+		uint32_t get_refcount_weak(void* ptr) override
+		{
+			return static_cast<RawStruct*>(ptr)->refcount_weak.load(std::memory_order_acquire);
+		}
+		uint32_t inc_refcount_weak(void* ptr) override
+		{
+			return static_cast<RawStruct*>(ptr)->refcount_weak.fetch_add(1, std::memory_order_relaxed);
+		}
+		uint32_t dec_refcount_weak(void* ptr) override
+		{
+			uint32_t old = static_cast<RawStruct*>(ptr)->refcount_weak.fetch_sub(1, std::memory_order_acq_rel);
+			if (old == 1)
+			{
+				reclaim(ptr);
+			}
+			return old;
+		}
+		bool try_inc_refcount(void* ptr) override
+		{
+			auto& ref = static_cast<RawStruct*>(ptr)->refcount;
+			uint32_t expected = ref.load(std::memory_order_acquire);
+			do {
+				if (expected == 0) {
+					return false;
+				}
+			} while (!ref.compare_exchange_weak(expected, expected + 1, std::memory_order_acq_rel, std::memory_order_acquire));
+			return true;
+		}
+	};
+	static SpinlockBlockAllocator<Payload>* spinlock_allocator = new SpinlockBlockAllocator<Payload>; // never destroyed, like the engine's allocators
+
+	// every thread allocates a batch of objects and releases it again, rounds times
+	template<typename MAKE>
+	double measureMops(const uint32_t threadCount, MAKE make)
+	{
+		constexpr uint32_t rounds = 2000;
+		constexpr uint32_t batch = 256;
+
+		std::vector<std::thread> threads;
+		Timer timer;
+		for (uint32_t t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([make]() {
+				std::vector<decltype(make())> live;
+				live.reserve(batch);
+				for (uint32_t r = 0; r < rounds; ++r)
+				{
+					for (uint32_t i = 0; i < batch; ++i)
+					{
+						live.push_back(make());
+					}
+					live.clear();
+				}
+				});
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		const double seconds = timer.elapsed_seconds();
+		return double(threadCount) * rounds * batch / seconds * 1e-6;
+	}
+
+	void Run()
+	{
+		printf("threads | vz::allocator::make_shared (Mops/s) | spinlocked pool (Mops/s) | std::make_shared (Mops/s)\n");
+		for (uint32_t thread_count : { 1u, 2u, 4u, 8u, 16u, 32u })
+		{
+			double vz_mops = measureMops(thread_count, []() { return allocator::make_shared<Payload>(); });
+			double spinlock_mops = measureMops(thread_count, []() { return spinlock_allocator->allocate(); });
+			double std_mops = measureMops(thread_count, []() { return std::make_shared<Payload>(); });
+			printf("%7u | %35.1f | %24.1f | %25.1f\n", thread_count, vz_mops, spinlock_mops, std_mops);
+		}
+	}
+}
+
+// ecs: the scene's transform and hierarchy update passes over 100k node actors, flat and in chains of 100,
+//	timed as VzRenderer::Render of the scene minus the same render of an empty scene (the passes run in Scene::Update)
+namespace bench_ecs
+{
+	constexpr uint32_t count = 100000;
+	constexpr uint32_t chain_length = 100;
+	constexpr uint32_t frames = 100;
+
+	// ms per Render, the actors (if any) are moved before every frame, outside of the timed range
+	double measureRenderMs(vzm::VzRenderer* renderer, vzm::VzScene* scene, vzm::VzCamera* camera, const std::vector<vzm::VzActor*>& movedActors)
+	{
+		renderer->Render(scene, camera); // the first update builds the flattened hierarchy
+
+		double total_ms = 0;
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			for (vzm::VzActor* actor : movedActors)
+			{
+				actor->SetPosition({ float(frame), 0, 0 });
+			}
+			Timer timer;
+			renderer->Render(scene, camera);
+			total_ms += timer.elapsed_milliseconds();
+		}
+		return total_ms / frames;
+	}
+
+	void Run()
+	{
+		vzm::VzRenderer* renderer = vzm::NewRenderer("bench_ecs_renderer");
+		renderer->SetCanvas(64, 64, 96.f, nullptr);
+		renderer->EnableFrameLock(-1.f);
+		vzm::VzCamera* camera = vzm::NewCamera("bench_ecs_camera");
+
+		vzm::VzScene* empty_scene = vzm::NewScene("bench_ecs_empty");
+		const double empty_ms = measureRenderMs(renderer, empty_scene, camera, {});
+		vzm::RemoveComponent(empty_scene);
+
+		printf("%u transforms, ms per frame over the empty scene's %.3f ms (ns per transform):\n", count, empty_ms);
+		printf("layout         | static            | all moved\n");
+		for (const bool chained : { false, true })
+		{
+			vzm::VzScene* scene = vzm::NewScene("bench_ecs_scene");
+			std::vector<vzm::VzActor*> roots;
+			std::vector<vzm::VzActor*> actors(count);
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const bool is_root = !chained || i % chain_length == 0;
+				actors[i] = vzm::NewActorNode("bench_ecs_actor_" + std::to_string(i), is_root ? 0u : actors[i - 1]->GetVID());
+				actors[i]->SetPosition({ 0, 1.f, 0 });
+				if (is_root)
+				{
+					scene->AppendChild(actors[i]);
+					roots.push_back(actors[i]);
+				}
+			}
+
+			const double static_ms = measureRenderMs(renderer, scene, camera, {}) - empty_ms;
+			const double moved_ms = measureRenderMs(renderer, scene, camera, actors) - empty_ms;
+			printf("%-14s | %7.3f (%7.1f) | %7.3f (%7.1f)\n", chained ? "chains of 100" : "flat",
+				static_ms, static_ms * 1e6 / count, moved_ms, moved_ms * 1e6 / count);
+
+			for (vzm::VzActor* root : roots)
+			{
+				vzm::RemoveComponent(root, true);
+			}
+			vzm::RemoveComponent(scene);
+		}
+
+		vzm::RemoveComponent(camera);
+		vzm::RemoveComponent(renderer);
+	}
+}
+
+// profiler: cost of a CPU range (BeginRangeCPU + EndRange) while a timeline capture is running, the limit is 50 ns
+namespace bench_profiler
+{
+	double measureNs(const uint32_t count)
+	{
+		Timer timer;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			profiler::range_id id = profiler::BeginRangeCPU("bench_range");
+			profiler::EndRange(id);
+		}
+		return timer.elapsed_milliseconds() * 1e6 / count;
+	}
+
+	void Run()
+	{
+		constexpr uint32_t count = 1000000;
+		const double idle_ns = measureNs(count);
+		if (!profiler::BeginTraceCapture("benchmark001_trace.json", ~0u))
+		{
+			printf("capture could not be started\n");
+			return;
+		}
+		const double capture_ns = measureNs(count);
+		profiler::EndTraceCapture();
+		printf("not capturing: %.1f ns per range\ncapturing: %.1f ns per range\n", idle_ns, capture_ns);
+	}
+}
+
+// collision: one mesh against many (an implant against anatomy meshes), pairwise CollisionCheck calls vs one CollisionCheckBatch
+namespace bench_collision
+{
+	vzm::VzActorStaticMesh* makeSphereActor(const std::string& name, const float radius, const vfloat3& position)
+	{
+		vzm::VzGeometry* geometry = vzm::NewGeometry(name + "_geometry");
+		geogen::GenerateSphereGeometry(geometry->GetVID(), radius, 64u, 32u);
+		compfactory::GetGeometryComponent(geometry->GetVID())->UpdateBVH(true);
+		vzm::VzActorStaticMesh* actor = vzm::NewActorStaticMesh(name, geometry->GetVID());
+		actor->SetPosition(position);
+		actor->UpdateWorldMatrix();
+		return actor;
+	}
+
+	void Run()
+	{
+		constexpr uint32_t rounds = 20;
+
+		vzm::VzActorStaticMesh* implant = makeSphereActor("bench_implant", 1.f, { 0, 0, 0 });
+
+		printf("targets | pairwise (checks/s) | batch first hit (checks/s) | batch all contacts (checks/s) | contacts\n");
+		for (uint32_t target_count : { 16u, 64u, 256u })
+		{
+			// half of the targets touch the implant, the other half are apart from it
+			std::vector<ActorVID> targets(target_count);
+			for (uint32_t i = 0; i < target_count; ++i)
+			{
+				const float angle = 6.2831853f * float(i) / float(target_count);
+				const float distance = (i % 2 == 0) ? 1.1f : 3.f;
+				targets[i] = makeSphereActor("bench_target_" + std::to_string(i), 0.3f,
+					{ cosf(angle) * distance, sinf(angle) * distance, 0 })->GetVID();
+			}
+
+			uint32_t hit_count = 0;
+			Timer timer;
+			for (uint32_t r = 0; r < rounds; ++r)
+			{
+				for (ActorVID target : targets)
+				{
+					hit_count += implant->CollisionCheck(target) ? 1 : 0;
+				}
+			}
+			const double pairwise = double(rounds) * target_count / timer.elapsed_seconds();
+
+			timer.record();
+			for (uint32_t r = 0; r < rounds; ++r)
+			{
+				implant->CollisionCheckBatch(targets, false);
+			}
+			const double batch_first = double(rounds) * target_count / timer.elapsed_seconds();
+
+			std::vector<vzm::VIzCollision::Contact> contacts;
+			timer.record();
+			for (uint32_t r = 0; r < rounds; ++r)
+			{
+				contacts.clear();
+				implant->CollisionCheckBatch(targets, true, &contacts);
+			}
+			const double batch_all = double(rounds) * target_count / timer.elapsed_seconds();
+
+			printf("%7u | %19.0f | %26.0f | %29.0f | %8zu\n", target_count, pairwise, batch_first, batch_all, contacts.size());
+			if (hit_count != rounds * target_count / 2)
+			{
+				printf("unexpected pairwise hits: %u\n", hit_count);
+			}
+
+			for (ActorVID target : targets)
+			{
+				GeometryVID geometry = ((vzm::VzActorStaticMesh*)vzm::GetComponent(target))->GetGeometry();
+				vzm::RemoveComponent(target);
+				vzm::RemoveComponent(geometry);
+			}
+		}
+
+		GeometryVID geometry = implant->GetGeometry();
+		vzm::RemoveComponent(implant);
+		vzm::RemoveComponent(geometry);
+	}
+}
+
+// obj_import: vzm::LoadModelFile on a 10M-face OBJ (a tessellated grid written on first use), time and peak memory
+namespace bench_obj_import
+{
+	// side x side quads, two faces each, with positions, normals and uvs
+	bool writeGridObj(const std::string& fileName, const uint32_t side)
+	{
+		std::ofstream file(fileName, std::ios::binary);
+		if (!file.is_open())
+			return false;
+		char line[256];
+		auto writeLine = [&](const int length) { file.write(line, length); };
+		const uint32_t row = side + 1;
+		for (uint32_t y = 0; y < row; ++y)
+		{
+			for (uint32_t x = 0; x < row; ++x)
+			{
+				writeLine(snprintf(line, sizeof(line), "v %u %u 0\nvt %f %f\n", x, y, float(x) / side, float(y) / side));
+			}
+		}
+		file << "vn 0 0 1\ng grid\n";
+		for (uint32_t y = 0; y < side; ++y)
+		{
+			for (uint32_t x = 0; x < side; ++x)
+			{
+				const uint32_t i0 = y * row + x + 1; // obj indices are one-based
+				const uint32_t i1 = i0 + 1;
+				const uint32_t i2 = i0 + row;
+				const uint32_t i3 = i2 + 1;
+				writeLine(snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1\nf %u/%u/1 %u/%u/1 %u/%u/1\n", i0, i0, i1, i1, i3, i3, i0, i0, i3, i3, i2, i2));
+			}
+		}
+		file.close();
+		return !file.fail();
+	}
+
+	void Run()
+	{
+		constexpr uint32_t side = 2237; // 2 * 2237^2 ~ 10M faces
+		const std::string fileName = "benchmark001_grid.obj";
+		if (!helper::FileExists(fileName))
+		{
+			printf("writing %s...\n", fileName.c_str());
+			if (!writeGridObj(fileName, side))
+			{
+				printf("%s could not be written\n", fileName.c_str());
+				return;
+			}
+		}
+
+		const helper::MemoryUsage before = helper::GetMemoryUsage();
+		Timer timer;
+		vzm::VzActor* actor = vzm::LoadModelFile(fileName);
+		const double ms = timer.elapsed_milliseconds();
+		const helper::MemoryUsage after = helper::GetMemoryUsage();
+		if (actor == nullptr)
+		{
+			printf("%s could not be imported\n", fileName.c_str());
+			return;
+		}
+		// the peak is process wide, run this section alone for a clean number
+		printf("%u faces: %.1f ms, peak working set %s (%s before the import)\n", 2 * side * side, ms,
+			helper::GetMemorySizeText(after.process_physical_peak).c_str(), helper::GetMemorySizeText(before.process_physical).c_str());
+
+		vzm::RemoveComponent(actor, true);
+	}
+}
+
+// culling: Frustum::CullBoxes over an AABBSoA vs the per-box CheckBoxFast loop it replaced in the scene's culling pass
+namespace bench_culling
+{
+	void Run()
+	{
+		using namespace geometrics;
+		constexpr uint32_t rounds = 50;
+		constexpr uint32_t layerMask = ~0u;
+
+		const XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, -150, 1), XMVectorZero(), XMVectorSet(0, 1, 0, 0));
+		const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.f / 9.f, 0.1f, 1000.f);
+		Frustum frustum;
+		frustum.Create(view * projection);
+
+		printf("boxes   | CheckBoxFast loop (ms) | CullBoxes (ms) | speedup | visible\n");
+		for (uint32_t box_count : { 10000u, 100000u, 1000000u })
+		{
+			random::RNG rng(1);
+			std::vector<AABB> aabbs(box_count);
+			for (AABB& aabb : aabbs)
+			{
+				XMFLOAT3 center(rng.next_float(-200.f, 200.f), rng.next_float(-200.f, 200.f), rng.next_float(-200.f, 200.f));
+				aabb.createFromHalfWidth(center, XMFLOAT3(1, 1, 1));
+			}
+			AABBSoA soa;
+			soa.Build(aabbs.data(), aabbs.size());
+			std::vector<uint32_t> visible(box_count);
+
+			uint32_t loop_count = 0;
+			Timer timer;
+			for (uint32_t r = 0; r < rounds; ++r)
+			{
+				loop_count = 0;
+				for (uint32_t i = 0; i < box_count; ++i)
+				{
+					const AABB& aabb = aabbs[i];
+					if ((aabb.layerMask & layerMask) && frustum.CheckBoxFast(aabb))
+					{
+						visible[loop_count++] = i;
+					}
+				}
+			}
+			const double loop_ms = timer.elapsed_milliseconds() / rounds;
+
+			uint32_t batch_count = 0;
+			timer.record();
+			for (uint32_t r = 0; r < rounds; ++r)
+			{
+				batch_count = frustum.CullBoxes(soa, 0, box_count, layerMask, visible.data());
+			}
+			const double batch_ms = timer.elapsed_milliseconds() / rounds;
+
+			printf("%7u | %22.3f | %14.3f | %6.1fx | %u\n", box_count, loop_ms, batch_ms, loop_ms / batch_ms, batch_count);
+			if (loop_count != batch_count)
+			{
+				printf("visible counts differ: %u (loop) vs %u (CullBoxes)\n", loop_count, batch_count);
+			}
+		}
+	}
+}
+
+// jobsystem: Execute throughput of empty and 1 us jobs, for 1 to 64 worker threads (capped by the hardware),
+//	vs the same workers scheduling through mutex-guarded std::deque queues (the job system before the work-stealing deques)
+namespace bench_jobsystem
+{
+	// The scheduler before the work-stealing deques: one mutex-guarded std::deque per worker, jobs are pushed round-robin,
+	//	every job holds its own std::function copy, workers drain their own queue, then the others
+	struct MutexJobSystem
+	{
+		struct Job
+		{
+			std::function<void(jobsystem::JobArgs)> task;
+			std::atomic<long>* counter = nullptr;
+		};
+		struct JobQueue
+		{
+			std::deque<Job> queue;
+			std::mutex locker;
+
+			inline void push_back(const Job& item)
+			{
+				std::scoped_lock lock(locker);
+				queue.push_back(item);
+			}
+			inline bool pop_front(Job& item)
+			{
+				std::scoped_lock lock(locker);
+				if (queue.empty())
+				{
+					return false;
+				}
+				item = std::move(queue.front());
+				queue.pop_front();
+				return true;
+			}
+		};
+
+		uint32_t numThreads = 0;
+		std::unique_ptr<JobQueue[]> jobQueuePerThread;
+		std::vector<std::thread> threads;
+		std::atomic<uint32_t> nextQueue{ 0 };
+		bool alive = true; // guarded by wakeMutex
+		std::condition_variable wakeCondition;
+		std::mutex wakeMutex;
+
+		MutexJobSystem(uint32_t threadCount) : numThreads(threadCount), jobQueuePerThread(new JobQueue[threadCount])
+		{
+			for (uint32_t threadID = 0; threadID < numThreads; ++threadID)
+			{
+				threads.emplace_back([this, threadID]() {
+					while (true)
+					{
+						work(threadID);
+
+						std::unique_lock<std::mutex> lock(wakeMutex);
+						if (!alive)
+							break;
+						wakeCondition.wait(lock);
+					}
+					});
+			}
+		}
+		~MutexJobSystem()
+		{
+			{
+				std::scoped_lock lock(wakeMutex);
+				alive = false;
+			}
+			wakeCondition.notify_all();
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		inline void work(uint32_t startingQueue)
+		{
+			Job job;
+			for (uint32_t i = 0; i < numThreads; ++i)
+			{
+				JobQueue& job_queue = jobQueuePerThread[startingQueue % numThreads];
+				while (job_queue.pop_front(job))
+				{
+					jobsystem::JobArgs args = {};
+					args.isFirstJobInGroup = true;
+					args.isLastJobInGroup = true;
+					job.task(args);
+					job.counter->fetch_sub(1);
+				}
+				startingQueue++;
+			}
+		}
+		inline void execute(std::atomic<long>& counter, const std::function<void(jobsystem::JobArgs)>& task)
+		{
+			counter.fetch_add(1);
+			jobQueuePerThread[nextQueue.fetch_add(1) % numThreads].push_back({ task, &counter });
+			wakeCondition.notify_one();
+		}
+		inline void wait(const std::atomic<long>& counter)
+		{
+			wakeCondition.notify_all();
+			work(nextQueue.fetch_add(1) % numThreads);
+			while (counter.load() > 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+	};
+
+	constexpr uint32_t job_count = 200000;
+
+	// jobs are submitted one by one from the main thread, which then helps out in Wait()
+	template<typename JOB>
+	double measureMjobs(JOB job)
+	{
+		Timer timer;
+		jobsystem::context ctx;
+		for (uint32_t i = 0; i < job_count; ++i)
+		{
+			jobsystem::Execute(ctx, job);
+		}
+		jobsystem::Wait(ctx);
+		return job_count / timer.elapsed_seconds() * 1e-6;
+	}
+	template<typename JOB>
+	double measureMjobsMutex(MutexJobSystem& mutex_jobsystem, JOB job)
+	{
+		Timer timer;
+		std::atomic<long> counter{ 0 };
+		for (uint32_t i = 0; i < job_count; ++i)
+		{
+			mutex_jobsystem.execute(counter, job);
+		}
+		mutex_jobsystem.wait(counter);
+		return job_count / timer.elapsed_seconds() * 1e-6;
+	}
+
+	void Run()
+	{
+		// the job system is re-initialized per thread count, the engine's worker count is restored at the end
+		const uint32_t engine_thread_count = jobsystem::GetThreadCount();
+
+		auto empty_job = [](jobsystem::JobArgs args) {};
+		auto busy_job = [](jobsystem::JobArgs args) {
+			Timer timer;
+			while (timer.elapsed_seconds() < 1e-6) {}
+			};
+
+		printf("threads | workers | empty job, vz (Mjobs/s) | empty job, mutex deques (Mjobs/s) | 1 us job, vz (Mjobs/s) | 1 us job, mutex deques (Mjobs/s)\n");
+		for (uint32_t thread_count : { 1u, 2u, 4u, 8u, 16u, 32u, 64u })
+		{
+			jobsystem::Initialize(thread_count);
+			const uint32_t workers = jobsystem::GetThreadCount();
+			double empty_mjobs = measureMjobs(empty_job);
+			double busy_mjobs = measureMjobs(busy_job);
+
+			// the baseline gets the same number of workers, the engine's workers sleep meanwhile
+			double empty_mutex_mjobs = 0;
+			double busy_mutex_mjobs = 0;
+			{
+				MutexJobSystem mutex_jobsystem(workers);
+				empty_mutex_mjobs = measureMjobsMutex(mutex_jobsystem, empty_job);
+				busy_mutex_mjobs = measureMjobsMutex(mutex_jobsystem, busy_job);
+			}
+			printf("%7u | %7u | %23.2f | %33.2f | %22.2f | %32.2f\n", thread_count, workers, empty_mjobs, empty_mutex_mjobs, busy_mjobs, busy_mutex_mjobs);
+		}
+		jobsystem::Initialize(engine_thread_count);
+	}
+}
+
+// picking: VzRenderer::Picking rays per second against scenes of 1k/10k/100k small meshes (the scene's top-level BVH)
+namespace bench_picking
+{
+	void Run()
+	{
+		constexpr uint32_t canvas_size = 1024;
+		constexpr uint32_t ray_count = 10000;
+
+		vzm::VzRenderer* renderer = vzm::NewRenderer("bench_renderer");
+		renderer->SetCanvas(canvas_size, canvas_size, 96.f, nullptr);
+		vzm::VzCamera* camera = vzm::NewCamera("bench_camera");
+		vzm::VzGeometry* geometry = vzm::NewGeometry("bench_sphere");
+		geogen::GenerateSphereGeometry(geometry->GetVID(), 0.5f, 16u, 8u);
+		compfactory::GetGeometryComponent(geometry->GetVID())->UpdateBVH(true);
+		vzm::VzMaterial* material = vzm::NewMaterial("bench_material");
+
+		printf("renderables | rays/s | hits\n");
+		for (uint32_t actor_count : { 1000u, 10000u, 100000u })
+		{
+			// a cube grid of spheres (sharing one geometry) in front of the camera
+			vzm::VzScene* scene = vzm::NewScene("bench_scene");
+			const uint32_t side = (uint32_t)std::ceil(std::cbrt((double)actor_count));
+			const float extent = float(side) * 2.f;
+			std::vector<ActorVID> actors(actor_count);
+			for (uint32_t i = 0; i < actor_count; ++i)
+			{
+				vzm::VzActorStaticMesh* actor = vzm::NewActorStaticMesh("bench_actor_" + std::to_string(i), geometry->GetVID(), material->GetVID());
+				actor->SetPosition({ float(i % side) * 2.f - extent * 0.5f, float(i / side % side) * 2.f - extent * 0.5f, -float(i / (side * side)) * 2.f });
+				scene->AppendChild(actor);
+				actors[i] = actor->GetVID();
+			}
+			camera->SetWorldPose({ 0, 0, extent * 1.5f }, { 0, 0, -1 }, { 0, 1, 0 });
+			camera->SetPerspectiveProjection(0.1f, extent * 4.f, 45.f, 1.f);
+			renderer->Render(scene, camera); // updates the scene, including the picking BVH
+
+			random::RNG rng(1);
+			uint32_t hit_count = 0;
+			Timer timer;
+			for (uint32_t r = 0; r < ray_count; ++r)
+			{
+				vfloat2 pos = { rng.next_float(0.f, float(canvas_size)), rng.next_float(0.f, float(canvas_size)) };
+				vfloat3 position;
+				ActorVID vid = INVALID_VID;
+				hit_count += renderer->Picking(scene, camera, pos, vzm::ActorFilter::MESH_OPAQUE, 0.f, position, vid) ? 1 : 0;
+			}
+			const double rays_per_second = ray_count / timer.elapsed_seconds();
+			printf("%11u | %6.0f | %u\n", actor_count, rays_per_second, hit_count);
+
+			for (ActorVID actor : actors)
+			{
+				vzm::RemoveComponent(actor);
+			}
+			vzm::RemoveComponent(scene);
+		}
+
+		vzm::RemoveComponent(material);
+		vzm::RemoveComponent(geometry);
+		vzm::RemoveComponent(camera);
+		vzm::RemoveComponent(renderer);
+	}
+}
+
+// bvh_cache: load-to-first-pick latency of a ~1M-triangle mesh read from an archive stored with and without its cached CPU BVH
+namespace bench_bvh_cache
+{
+	constexpr uint32_t canvas_size = 512;
+
+	// ReadFile + Load into a new geometry, then render and pick the canvas center until the mesh is hit
+	//	without the cached BVH the scene builds it in the background, so the picks miss until that job is done
+	void measureFirstPick(const std::string& fileName, double& loadMs, double& firstPickMs, uint32_t& renderCount)
+	{
+		constexpr double timeout_seconds = 60.0;
+
+		vzm::VzRenderer* renderer = vzm::NewRenderer("bench_bvh_renderer");
+		renderer->SetCanvas(canvas_size, canvas_size, 96.f, nullptr);
+		renderer->EnableFrameLock(-1.f);
+		vzm::VzCamera* camera = vzm::NewCamera("bench_bvh_camera");
+		camera->SetWorldPose({ 0, 0, 3.f }, { 0, 0, -1 }, { 0, 1, 0 });
+		camera->SetPerspectiveProjection(0.1f, 10.f, 45.f, 1.f);
+		vzm::VzScene* scene = vzm::NewScene("bench_bvh_scene");
+		vzm::VzMaterial* material = vzm::NewMaterial("bench_bvh_material");
+
+		Timer timer;
+		vzm::VzArchive* archive = vzm::NewArchive("bench_bvh_archive");
+		archive->ReadFile(fileName);
+		vzm::VzGeometry* geometry = vzm::NewGeometry("bench_bvh_geometry");
+		archive->Load(geometry->GetVID());
+		vzm::VzActorStaticMesh* actor = vzm::NewActorStaticMesh("bench_bvh_actor", geometry->GetVID(), material->GetVID());
+		scene->AppendChild(actor);
+		loadMs = timer.elapsed_milliseconds();
+
+		renderCount = 0;
+		bool hit = false;
+		while (!hit && timer.elapsed_seconds() < timeout_seconds)
+		{
+			renderCount += renderer->Render(scene, camera) ? 1 : 0;
+			vfloat3 position;
+			ActorVID vid = INVALID_VID;
+			hit = renderer->Picking(scene, camera, { canvas_size * 0.5f, canvas_size * 0.5f }, vzm::ActorFilter::MESH_OPAQUE, 0.f, position, vid);
+		}
+		firstPickMs = hit ? timer.elapsed_milliseconds() : -1.0;
+
+		vzm::RemoveComponent(actor);
+		vzm::RemoveComponent(geometry);
+		vzm::RemoveComponent(archive);
+		vzm::RemoveComponent(material);
+		vzm::RemoveComponent(scene);
+		vzm::RemoveComponent(camera);
+		vzm::RemoveComponent(renderer);
+	}
+
+	void Run()
+	{
+		const std::string uncached_file = "bench_bvh_uncached.vzarc";
+		const std::string cached_file = "bench_bvh_cached.vzarc";
+
+		// the same mesh stored before and after building its BVH (GeometryComponent::Serialize writes it when valid)
+		vzm::VzGeometry* source = vzm::NewGeometry("bench_bvh_source");
+		geogen::GenerateSphereGeometry(source->GetVID(), 1.f, 1024u, 512u);
+		vzm::VzArchive* uncached = vzm::NewArchive("bench_bvh_uncached");
+		uncached->Store(source->GetVID());
+		uncached->SaveFile(uncached_file);
+		compfactory::GetGeometryComponent(source->GetVID())->UpdateBVH(true);
+		vzm::VzArchive* cached = vzm::NewArchive("bench_bvh_cached");
+		cached->Store(source->GetVID());
+		cached->SaveFile(cached_file);
+		vzm::RemoveComponent(uncached);
+		vzm::RemoveComponent(cached);
+		vzm::RemoveComponent(source);
+
+		printf("archive        | load (ms) | load to first pick (ms) | renders\n");
+		for (const std::string& file_name : { uncached_file, cached_file })
+		{
+			double load_ms = 0, first_pick_ms = 0;
+			uint32_t render_count = 0;
+			measureFirstPick(file_name, load_ms, first_pick_ms, render_count);
+			printf("%-14s | %9.1f | %23.1f | %7u\n", file_name == cached_file ? "cached BVH" : "no cached BVH", load_ms, first_pick_ms, render_count);
+		}
+	}
+}
+
+// normals: Primitive::ComputeNormals on sphere meshes of ~100k/1M/5M triangles (their uv seams give welded positions)
+namespace bench_normals
+{
+	using Primitive = GeometryComponent::Primitive;
+	using NormalComputeMethod = GeometryComponent::NormalComputeMethod;
+
+	// every mode runs on a fresh copy, COMPUTE_NORMALS_SMOOTH can change the vertex count
+	double measureMs(const Primitive& source, const NormalComputeMethod method)
+	{
+		Primitive primitive = source;
+		Timer timer;
+		primitive.ComputeNormals(method);
+		return timer.elapsed_milliseconds();
+	}
+
+	void Run()
+	{
+		printf("triangles | smooth (ms) | smooth fast (ms) | hard (ms)\n");
+		for (uint32_t width_segments : { 320u, 1000u, 2240u })
+		{
+			vzm::VzGeometry* geometry = vzm::NewGeometry("bench_normals_sphere");
+			geogen::GenerateSphereGeometry(geometry->GetVID(), 1.f, width_segments, width_segments / 2);
+			const Primitive& source = *compfactory::GetGeometryComponent(geometry->GetVID())->GetPrimitive(0);
+
+			const double smooth_ms = measureMs(source, NormalComputeMethod::COMPUTE_NORMALS_SMOOTH);
+			const double smooth_fast_ms = measureMs(source, NormalComputeMethod::COMPUTE_NORMALS_SMOOTH_FAST);
+			const double hard_ms = measureMs(source, NormalComputeMethod::COMPUTE_NORMALS_HARD);
+			printf("%9zu | %11.1f | %16.1f | %9.1f\n", source.GetIdxPrimives().size() / 3, smooth_ms, smooth_fast_ms, hard_ms);
+
+			vzm::RemoveComponent(geometry);
+		}
+	}
+}
+
+// minmax_blocks: GVolumeComponent::UpdateVolumeMinMaxBlocks throughput on 1/2/4 GB uint16 volumes, 8^3 voxel blocks
+// histogram: VolumeComponent::UpdateHistogram throughput on the same volumes
+namespace bench_volume
+{
+	struct VolumeExtent
+	{
+		uint32_t w, h, d;
+	};
+	static const VolumeExtent extents[] = { { 1024, 1024, 512 }, { 1024, 1024, 1024 }, { 2048, 1024, 1024 } };
+
+	// a 12-bit pattern that varies in every direction, so blocks have different ranges
+	//	returns nullptr when the volume cannot be loaded (e.g., the GPU texture is too large for the device)
+	GVolumeComponent* loadVolume(const vzm::VzVolume* volumeVz, const VolumeExtent& extent)
+	{
+		const size_t slice = (size_t)extent.w * extent.h;
+		std::vector<uint8_t> data(slice * extent.d * sizeof(uint16_t));
+		uint16_t* voxels = (uint16_t*)data.data();
+		jobsystem::context ctx;
+		jobsystem::Dispatch(ctx, extent.d, 1, [&](jobsystem::JobArgs args) {
+			const uint32_t z = args.jobIndex;
+			for (uint32_t y = 0; y < extent.h; ++y)
+			{
+				uint16_t* row = voxels + z * slice + (size_t)y * extent.w;
+				for (uint32_t x = 0; x < extent.w; ++x)
+				{
+					row[x] = uint16_t(((x ^ y) + z * 7u) & 0xFFFu);
+				}
+			}
+			});
+		jobsystem::Wait(ctx);
+
+		VolumeComponent* volume = compfactory::GetVolumeComponent(volumeVz->GetVID());
+		if (!volume->LoadVolume("bench_volume #dcm", data, extent.w, extent.h, extent.d, VolumeComponent::VolumeFormat::UINT16))
+			return nullptr;
+		return (GVolumeComponent*)volume;
+	}
+
+	void RunMinMaxBlocks()
+	{
+		printf("volume            | GB   | min/max blocks (ms) | GB/s\n");
+		for (const VolumeExtent& extent : extents)
+		{
+			vzm::VzVolume* volume_vz = vzm::NewVolume("bench_volume");
+			GVolumeComponent* volume = loadVolume(volume_vz, extent);
+			const double gigabytes = (double)extent.w * extent.h * extent.d * sizeof(uint16_t) / (1024.0 * 1024.0 * 1024.0);
+			if (volume == nullptr)
+			{
+				printf("%4ux%4ux%4u could not be loaded\n", extent.w, extent.h, extent.d);
+				vzm::RemoveComponent(volume_vz);
+				continue;
+			}
+
+			Timer timer;
+			volume->UpdateVolumeMinMaxBlocks({ 8, 8, 8 });
+			const double ms = timer.elapsed_milliseconds();
+			printf("%4ux%4ux%4u    | %4.1f | %19.1f | %4.2f\n", extent.w, extent.h, extent.d, gigabytes, ms, gigabytes / (ms * 1e-3));
+
+			vzm::RemoveComponent(volume_vz);
+		}
+	}
+
+	void RunHistogram()
+	{
+		printf("volume            | GB   | histogram (ms) | GB/s\n");
+		for (const VolumeExtent& extent : extents)
+		{
+			vzm::VzVolume* volume_vz = vzm::NewVolume("bench_volume");
+			GVolumeComponent* volume = loadVolume(volume_vz, extent);
+			const double gigabytes = (double)extent.w * extent.h * extent.d * sizeof(uint16_t) / (1024.0 * 1024.0 * 1024.0);
+			if (volume == nullptr)
+			{
+				printf("%4ux%4ux%4u could not be loaded\n", extent.w, extent.h, extent.d);
+				vzm::RemoveComponent(volume_vz);
+				continue;
+			}
+
+			Timer timer;
+			volume->UpdateHistogram(0.f, 4095.f, 256);
+			const double ms = timer.elapsed_milliseconds();
+			printf("%4ux%4ux%4u    | %4.1f | %14.1f | %4.2f\n", extent.w, extent.h, extent.d, gigabytes, ms, gigabytes / (ms * 1e-3));
+
+			vzm::RemoveComponent(volume_vz);
+		}
+	}
+}
+
+// animation: AnimationComponent::Update with 1k translation channels over 50k keys, forward playback and random seeks
+namespace bench_animation
+{
+	void Run()
+	{
+		constexpr uint32_t channel_count = 1000;
+		constexpr uint32_t key_count = 50000;
+		constexpr uint32_t frames = 600;
+		constexpr float key_interval = 1.f / 60.f;
+
+		// the channels share one keyframe data (50k keys at 60 Hz), the keyframe search state is per channel
+		std::vector<float> times(key_count);
+		std::vector<float> data(key_count * 3);
+		for (uint32_t i = 0; i < key_count; ++i)
+		{
+			times[i] = float(i) * key_interval;
+			data[i * 3 + 0] = sinf(times[i]);
+			data[i * 3 + 1] = cosf(times[i]);
+			data[i * 3 + 2] = 0.f;
+		}
+		vzm::VzKeyFrameData* keyframe = vzm::NewKeyFrame("bench_keyframe");
+		keyframe->SetKeyFrameTimes(times);
+		keyframe->SetKeyFrameData(data);
+
+		vzm::VzAnimation* animation = vzm::NewAnimation("bench_animation");
+		std::vector<ActorVID> targets(channel_count);
+		for (uint32_t i = 0; i < channel_count; ++i)
+		{
+			targets[i] = vzm::NewActorStaticMesh("bench_animation_target_" + std::to_string(i))->GetVID();
+
+			vzm::VzAnimation::Sampler sampler;
+			sampler.mode = vzm::VzAnimation::Sampler::Interpolation::LINEAR;
+			sampler.keyframeVID = keyframe->GetVID();
+			animation->AddSampler(sampler);
+
+			vzm::VzAnimation::Channel channel;
+			channel.path = vzm::VzAnimation::Channel::Path::TRANSLATION;
+			channel.samplerIndex = (int)i;
+			channel.targetVID = targets[i];
+			animation->AddChannel(channel);
+		}
+		animation->SetStartTime(0.f);
+		animation->SetEndTime(times.back());
+		animation->Play();
+
+		AnimationComponent* animation_comp = compfactory::GetAnimationComponent(animation->GetVID());
+		animation_comp->Update(key_interval); // resolves the channel targets
+
+		// forward playback from the middle of the clip
+		animation->SetTime(times.back() * 0.5f);
+		Timer timer;
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			animation_comp->Update(key_interval);
+		}
+		const double playback_us = timer.elapsed_milliseconds() * 1e3 / frames;
+
+		random::RNG rng(1);
+		timer.record();
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			animation->SetTime(rng.next_float(0.f, times.back()));
+			animation_comp->Update(key_interval);
+		}
+		const double seek_us = timer.elapsed_milliseconds() * 1e3 / frames;
+
+		printf("%u channels x %u keys\nplayback: %.1f us per update\nrandom seek: %.1f us per update\n", channel_count, key_count, playback_us, seek_us);
+
+		vzm::RemoveComponent(animation);
+		vzm::RemoveComponent(keyframe);
+		for (ActorVID target : targets)
+		{
+			vzm::RemoveComponent(target);
+		}
+	}
+}
+
+struct Section
+{
+	const char* name;
+	void (*run)();
+};
+static const Section sections[] = {
+	{ "allocator", bench_allocator::Run },
+	{ "ecs", bench_ecs::Run },
+	{ "profiler", bench_profiler::Run },
+	{ "collision", bench_collision::Run },
+	{ "obj_import", bench_obj_import::Run },
+	{ "culling", bench_culling::Run },
+	{ "jobsystem", bench_jobsystem::Run },
+	{ "picking", bench_picking::Run },
+	{ "bvh_cache", bench_bvh_cache::Run },
+	{ "normals", bench_normals::Run },
+	{ "minmax_blocks", bench_volume::RunMinMaxBlocks },
+	{ "histogram", bench_volume::RunHistogram },
+	{ "animation", bench_animation::Run },
+};
+
+int main(int argc, char* argv[])
+{
+	vzm::ParamMap<std::string> arguments;
+	if (!vzm::InitEngineLib(arguments))
+	{
+		printf("Failed to initialize engine library.\n");
+		return -1;
+	}
+
+	for (const Section& section : sections)
+	{
+		bool selected = argc <= 1;
+		for (int i = 1; i < argc; ++i)
+		{
+			selected |= strcmp(argv[i], section.name) == 0;
+		}
+		if (!selected)
+			continue;
+
+		printf("== %s ==\n", section.name);
+		section.run();
+		printf("\n");
+	}
+
+	vzm::DeinitEngineLib();
+	return 0;
+}